@@ -67,4 +67,8 @@
 # define MADV_DODUMP   17
 #endif
 
+#ifndef MADV_POPULATE_WRITE
+# define MADV_POPULATE_WRITE 23
+#endif
+
 #endif /* LAPI_MMAP_H__ */
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2016 Linux Test Project
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __LAPI_PIDFD_H__
+#define __LAPI_PIDFD_H__
+
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/*
+ * pidfd_open(2) is 434 in the unified syscall table; alpha, ia64 and the
+ * three mips ABIs add their own offsets.
+ */
+#ifndef __NR_pidfd_open
+# if defined(__alpha__)
+#  define __NR_pidfd_open	544
+# elif defined(__ia64__)
+#  define __NR_pidfd_open	1458
+# elif defined(__mips__) && _MIPS_SIM == _ABIO32
+#  define __NR_pidfd_open	4434
+# elif defined(__mips__) && _MIPS_SIM == _ABI64
+#  define __NR_pidfd_open	5434
+# elif defined(__mips__) && _MIPS_SIM == _ABIN32
+#  define __NR_pidfd_open	6434
+# else
+#  define __NR_pidfd_open	434
+# endif
+#endif
+
+static inline int ltp_pidfd_open(pid_t pid, unsigned int flags)
+{
+	return syscall(__NR_pidfd_open, pid, flags);
+}
+
+#endif /* __LAPI_PIDFD_H__ */
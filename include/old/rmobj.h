@@ -9,4 +9,11 @@
  */
 int rmobj( char *object , char **errmesg );
 
+/*
+ * rmobj_parallel() - Same as rmobj(), but the entries directly under a
+ *                    directory object are split between nworkers forked
+ *                    children.  nworkers < 2 means no children.
+ */
+int rmobj_parallel( char *object , int nworkers , char **errmesg );
+
 #endif
@@ -126,15 +126,40 @@ struct wlog_rec_disk {
     uint    w_extra2 	: 28;	    /* EXTRA BITS IN WORD 2 	    */
 };
 
+/*
+ * A run of records appended by one group commit.  Records written
+ * through a batched wlog_file are known by their offset in the stream of
+ * records this process appended (the logical offset) until they have
+ * been flushed, and the extents map those offsets to log file offsets.
+ */
+
+struct wlog_extent {
+    int		e_lbase;		/* logical offset of 1st record	*/
+    int		e_fbase;		/* log file offset of 1st record */
+    int		e_len;			/* bytes in the run		*/
+};
+
 /*
  * write log file datatype.  wlog_open() initializes this structure
  * which is then passed around to the various wlog_xxx routines.
+ *
+ * Everything after w_file is private to write_log.c.
  */
 
 struct wlog_file {
     int		w_afd;			/* append fd			*/
     int		w_rfd;			/* random-access fd		*/
     char	w_file[1024];		/* name of the write_log	*/
+
+    int		w_batch;		/* records per group commit	*/
+    int		w_nbuf;			/* records waiting in w_buf	*/
+    int		w_buflen;		/* bytes waiting in w_buf	*/
+    char	*w_buf;			/* records not yet written	*/
+    int		w_lbase;		/* logical offset of w_buf[0]	*/
+    int		w_next;			/* extents in w_ext		*/
+    int		w_maxext;		/* extents allocated		*/
+    struct wlog_extent *w_ext;		/* flushed runs, by e_lbase	*/
+    struct wlog_file *w_nextfile;	/* list of files flushed at exit */
 };
 
 /*
@@ -157,11 +182,15 @@ extern int	wlog_record_write(struct wlog_file *wfile,
 extern int	wlog_scan_backward(struct wlog_file *wfile, int nrecs,
 				   int (*func)(struct wlog_rec *rec),
 				   long data);
+extern int	wlog_set_batch(struct wlog_file *wfile, int nrecs);
+extern int	wlog_flush(struct wlog_file *wfile);
 #else
 int	wlog_open();
 int	wlog_close();
 int	wlog_record_write();
 int	wlog_scan_backward();
+int	wlog_set_batch();
+int	wlog_flush();
 #endif
 
 extern char	Wlog_Error_String[];
@@ -22,6 +22,68 @@ long tst_ncpus(void);
 long tst_ncpus_conf(void);
 long tst_ncpus_max(void);
 
+struct tst_cpu_info {
+	int cpu;	/* logical CPU number */
+	int package;	/* physical package index */
+	int core;	/* physical core index, unique across packages */
+	int llc;	/* last level cache domain index */
+	int node;	/* NUMA node id, 0 without NUMA */
+	int allowed;	/* in the affinity mask, i.e. allowed by cpuset */
+};
+
+/*
+ * Online CPUs as described by sysfs, built on first use and cached for the
+ * rest of the process. Package, core and LLC indexes are dense, i.e. from
+ * 0 to npackages - 1 etc. The distance matrix is nnodes x nnodes, indexed
+ * by the position of the node in node_ids.
+ */
+struct tst_cpu_topology {
+	int ncpus;
+	int nallowed;
+	int npackages;
+	int ncores;
+	int nllcs;
+	int nnodes;
+	struct tst_cpu_info *cpus;
+	int *node_ids;
+	int *distance;
+};
+
+const struct tst_cpu_topology *tst_cpu_topology(void);
+
+/*
+ * Returns the NUMA distance between two node ids, -1 if unknown.
+ */
+int tst_cpu_node_distance(int node1, int node2);
+
+/*
+ * Placement policies for tst_cpu_place().
+ *
+ * TST_CPU_SPREAD   - all allowed CPUs, one per core on each LLC in turn
+ *                    before any SMT sibling is used
+ * TST_CPU_PER_CORE - one CPU per physical core, spread across LLCs
+ * TST_CPU_PER_LLC  - one CPU per last level cache domain
+ * TST_CPU_PER_NODE - one CPU per NUMA node
+ */
+enum tst_cpu_place {
+	TST_CPU_SPREAD,
+	TST_CPU_PER_CORE,
+	TST_CPU_PER_LLC,
+	TST_CPU_PER_NODE,
+};
+
+/*
+ * Stores up to size allowed CPUs in the order given by the policy, so
+ * that the first n of them are the best place for n workers. Returns the
+ * number of CPUs stored.
+ */
+int tst_cpu_place(int policy, int *cpus, int size);
+
+/*
+ * Binds the calling thread to the cpu, returns sched_setaffinity() result.
+ */
+int tst_cpu_bind(int cpu);
+
 #define VIRT_XEN	1	/* xen dom0/domU */
 #define VIRT_KVM	2	/* only default virtual CPU */
 
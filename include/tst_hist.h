@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2026 Linux Test Project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+ /*
+
+   Log-linear histogram buckets for latency percentiles in constant memory.
+   Values below 2^bits have a bucket each, every power of two above that is
+   split into 2^(bits - 1) buckets, which bounds the relative error of the
+   reported values to 2^(1 - bits). The caller owns the bucket array of
+   TST_HIST_BUCKETS(bits) counters and keeps the count and the exact maximum
+   next to it, the functions are inline so that they can be used by tests
+   that are not linked against the LTP library.
+
+  */
+
+#ifndef TST_HIST_H__
+#define TST_HIST_H__
+
+#define TST_HIST_BUCKETS(bits) \
+	((1U << (bits)) + (64 - (bits)) * (1U << ((bits) - 1)))
+
+static inline unsigned int tst_hist_bucket(unsigned int bits,
+                                           unsigned long long val)
+{
+	unsigned int shift;
+
+	if (val < (1ULL << bits))
+		return val;
+
+	/* keep the bits most significant bits of val */
+	shift = (63 - __builtin_clzll(val)) - (bits - 1);
+
+	return (1U << bits) + (shift - 1) * (1U << (bits - 1)) +
+	       (val >> shift) - (1U << (bits - 1));
+}
+
+/* The largest value that falls into the bucket */
+static inline unsigned long long tst_hist_bucket_max(unsigned int bits,
+                                                     unsigned int bucket)
+{
+	unsigned long long mant;
+	unsigned int shift, half = 1U << (bits - 1);
+
+	if (bucket < (1U << bits))
+		return bucket;
+
+	bucket -= 1U << bits;
+	shift = bucket / half + 1;
+	mant = bucket % half + half;
+
+	return (mant << shift) + ((1ULL << shift) - 1);
+}
+
+static inline void tst_hist_merge(unsigned int bits, unsigned long long *dst,
+                                  const unsigned long long *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < TST_HIST_BUCKETS(bits); i++)
+		dst[i] += src[i];
+}
+
+/*
+ * Returns the upper bound of the bucket that holds the rank-th smallest
+ * sample, counted from one, clamped to the exact maximum so that the high
+ * percentiles never exceed it.
+ */
+static inline unsigned long long tst_hist_rank(unsigned int bits,
+                                               const unsigned long long *hist,
+                                               unsigned long long rank,
+                                               unsigned long long max)
+{
+	unsigned long long seen = 0, val = max;
+	unsigned int i;
+
+	for (i = 0; i < TST_HIST_BUCKETS(bits); i++) {
+		seen += hist[i];
+		if (seen >= rank) {
+			val = tst_hist_bucket_max(bits, i);
+			break;
+		}
+	}
+
+	return val < max ? val : max;
+}
+
+/* The pct percentile of count samples, 0 if there are none */
+static inline unsigned long long tst_hist_percentile(unsigned int bits,
+                                                     const unsigned long long *hist,
+                                                     unsigned long long count,
+                                                     unsigned long long max,
+                                                     double pct)
+{
+	double exact = count * pct / 100;
+	unsigned long long rank = exact;
+
+	if (!count)
+		return 0;
+
+	if (rank < exact)
+		rank++;
+	if (rank < 1)
+		rank = 1;
+	if (rank > count)
+		rank = count;
+
+	return tst_hist_rank(bits, hist, rank, max);
+}
+
+#endif /* TST_HIST_H__ */
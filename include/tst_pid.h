@@ -26,11 +26,18 @@
 pid_t tst_get_unused_pid_(void (*cleanup_fn)(void));
 
 /*
- * Returns number of free pids by substarction of the number of pids
- * currently used ('ps -eT') from max_pids
+ * Returns number of free pids, i.e. the smallest of pid_max, threads-max
+ * and the pids cgroup limits up the hierarchy minus the current usage.
+ * The number of threads in the system is taken from /proc/loadavg.
  */
 int tst_get_free_pids_(void (*cleanup_fn)(void));
 
+/*
+ * The same as above but the limits are read only on the first call, the
+ * following calls read just the current usage.
+ */
+int tst_get_free_pids_cached_(void (*cleanup_fn)(void));
+
 #ifdef TST_TEST_H__
 static inline pid_t tst_get_unused_pid(void)
 {
@@ -41,6 +48,11 @@ static inline int tst_get_free_pids(void)
 {
 	return tst_get_free_pids_(NULL);
 }
+
+static inline int tst_get_free_pids_cached(void)
+{
+	return tst_get_free_pids_cached_(NULL);
+}
 #else
 static inline pid_t tst_get_unused_pid(void (*cleanup_fn)(void))
 {
@@ -51,6 +63,11 @@ static inline int tst_get_free_pids(void (*cleanup_fn)(void))
 {
 	return tst_get_free_pids_(cleanup_fn);
 }
+
+static inline int tst_get_free_pids_cached(void (*cleanup_fn)(void))
+{
+	return tst_get_free_pids_cached_(cleanup_fn);
+}
 #endif
 
 #endif /* TST_PID_H__ */
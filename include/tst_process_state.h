@@ -50,6 +50,10 @@
 #define TST_PROCESS_STATE_WAIT(pid, state) \
 	tst_process_state_wait(__FILE__, __LINE__, NULL, \
 	                       (pid), (state))
+
+#define TST_PROCESS_STATE_WAIT_ALL(pids, cnt, state) \
+	tst_process_state_wait_all(__FILE__, __LINE__, NULL, \
+	                           (pids), (cnt), (state))
 #else
 /*
  * The same as above but does not use tst_brkm() interface.
@@ -63,10 +67,23 @@ int tst_process_state_wait2(pid_t pid, const char state);
 # define TST_PROCESS_STATE_WAIT(cleanup_fn, pid, state) \
 	 tst_process_state_wait(__FILE__, __LINE__, (cleanup_fn), \
 	                        (pid), (state))
+
+# define TST_PROCESS_STATE_WAIT_ALL(cleanup_fn, pids, cnt, state) \
+	 tst_process_state_wait_all(__FILE__, __LINE__, (cleanup_fn), \
+	                            (pids), (cnt), (state))
 #endif
 
 void tst_process_state_wait(const char *file, const int lineno,
                             void (*cleanup_fn)(void),
                             pid_t pid, const char state);
 
+/*
+ * Waits until all cnt processes in pids are in the state. Fails if any of
+ * them exits before getting there.
+ */
+void tst_process_state_wait_all(const char *file, const int lineno,
+                                void (*cleanup_fn)(void),
+                                const pid_t *pids, unsigned int cnt,
+                                const char state);
+
 #endif /* TST_PROCESS_STATE__ */
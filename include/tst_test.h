@@ -96,8 +96,77 @@ struct tst_test {
 
 	/* NULL terminated array of resource file names */
 	const char *const *resource_files;
+
+	/* number of per-child shared memory slots, see tst_slot() */
+	unsigned int shm_slots;
+	/* size of the test specific data in each slot */
+	size_t shm_slot_size;
 };
 
+/*
+ * Per-child slot in the shared memory arena, each on its own cache line(s).
+ * The test specific data of shm_slot_size bytes follow the header.
+ */
+struct tst_slot {
+	pid_t pid;
+	unsigned long long start_ns;
+	unsigned long long heartbeat_ns;
+	/* operations done, used for the throughput report */
+	unsigned long long counter;
+	/* latency or other samples, see tst_slot_sample() */
+	unsigned long long samples;
+	unsigned long long sample_sum;
+	unsigned long long sample_max;
+} __attribute__((aligned(64)));
+
+/*
+ * Slot totals, added up after the children are reaped at the end of each
+ * test function and accumulated over the whole run.
+ */
+struct tst_slot_totals {
+	unsigned int slots;
+	unsigned long long counter;
+	unsigned long long samples;
+	unsigned long long sample_sum;
+	unsigned long long sample_max;
+	double secs;
+};
+
+/*
+ * Returns the slot of the calling process, the first call claims a free
+ * one. Only the owner may write to its slot.
+ */
+struct tst_slot *tst_slot(void);
+
+static inline void *tst_slot_data(struct tst_slot *slot)
+{
+	return slot + 1;
+}
+
+static inline void tst_slot_add(struct tst_slot *slot, unsigned long long n)
+{
+	slot->counter += n;
+}
+
+static inline void tst_slot_sample(struct tst_slot *slot,
+                                   unsigned long long val)
+{
+	slot->samples++;
+	slot->sample_sum += val;
+	if (val > slot->sample_max)
+		slot->sample_max = val;
+}
+
+void tst_slot_heartbeat(struct tst_slot *slot);
+
+/*
+ * Returns i-th claimed slot or NULL, lets the parent watch the children's
+ * progress while they run.
+ */
+struct tst_slot *tst_slot_peek(unsigned int i);
+
+const struct tst_slot_totals *tst_slot_totals(void);
+
 /*
  * Runs tests.
  */
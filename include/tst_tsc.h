@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2026 Linux Test Project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+ /*
+
+   Low overhead timestamps. The CPU timestamp counter is calibrated against
+   CLOCK_MONOTONIC when the test starts, if it's not usable (not invariant,
+   marked unstable by the kernel or unsupported architecture) the functions
+   transparently fall back to clock_gettime(CLOCK_MONOTONIC) which is
+   serviced by vDSO.
+
+  */
+
+#ifndef TST_TSC_H__
+#define TST_TSC_H__
+
+#include <stdint.h>
+#include <time.h>
+
+struct tst_tsc_clock {
+	/* non-zero if the CPU timestamp counter is used */
+	int use_tsc;
+	/* ticks to nanoseconds conversion, ns = ticks * mult >> shift */
+	uint32_t mult;
+	uint32_t shift;
+	/* converted ticks + offset = CLOCK_MONOTONIC in nanoseconds */
+	int64_t offset;
+};
+
+extern struct tst_tsc_clock tst_tsc_clock;
+
+#if defined(__x86_64__) || defined(__i386__)
+# define TST_HAS_TSC 1
+static inline uint64_t tst_tsc_rdtsc(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+
+	return (uint64_t)hi << 32 | lo;
+}
+#elif defined(__aarch64__)
+# define TST_HAS_TSC 1
+static inline uint64_t tst_tsc_rdtsc(void)
+{
+	uint64_t val;
+
+	__asm__ __volatile__ ("isb; mrs %0, cntvct_el0" : "=r" (val) :: "memory");
+
+	return val;
+}
+#elif defined(__powerpc64__)
+# define TST_HAS_TSC 1
+static inline uint64_t tst_tsc_rdtsc(void)
+{
+	uint64_t val;
+
+	__asm__ __volatile__ ("mfspr %0, 268" : "=r" (val));
+
+	return val;
+}
+#else
+# define TST_HAS_TSC 0
+static inline uint64_t tst_tsc_rdtsc(void)
+{
+	return 0;
+}
+#endif
+
+/*
+ * Returns raw timestamp, use tst_tsc_to_ns() to convert it or a difference
+ * of two timestamps to nanoseconds.
+ */
+static inline uint64_t tst_tsc_read(void)
+{
+	struct timespec ts;
+
+	if (tst_tsc_clock.use_tsc)
+		return tst_tsc_rdtsc();
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Converts timestamp ticks to nanoseconds, split so that the multiplication
+ * does not overflow.
+ */
+static inline uint64_t tst_tsc_to_ns(uint64_t ticks)
+{
+	uint32_t shift = tst_tsc_clock.shift;
+	uint64_t mask = ((uint64_t)1 << shift) - 1;
+
+	return (ticks >> shift) * tst_tsc_clock.mult +
+	       (((ticks & mask) * tst_tsc_clock.mult) >> shift);
+}
+
+/*
+ * Returns current CLOCK_MONOTONIC time in nanoseconds.
+ */
+static inline uint64_t tst_tsc_now_ns(void)
+{
+	return tst_tsc_to_ns(tst_tsc_read()) + tst_tsc_clock.offset;
+}
+
+/*
+ * Returns name of the clock source in use, suitable for TINFO messages.
+ */
+const char *tst_tsc_source(void);
+
+#endif /* TST_TSC_H__ */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2026 Linux Test Project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Test for the TSC timestamps, the converted time has to track
+ * CLOCK_MONOTONIC.
+ */
+
+#include <stdint.h>
+#include "tst_test.h"
+#include "tst_tsc.h"
+
+static void do_test(void)
+{
+	struct timespec ts0, ts1;
+	uint64_t t0, t1, mono0, mono1, now;
+
+	tst_res(TINFO, "Clock source %s", tst_tsc_source());
+
+	t0 = tst_tsc_read();
+	usleep(100000);
+	t1 = tst_tsc_read();
+
+	clock_gettime(CLOCK_MONOTONIC, &ts0);
+	now = tst_tsc_now_ns();
+	clock_gettime(CLOCK_MONOTONIC, &ts1);
+	mono0 = (uint64_t)ts0.tv_sec * 1000000000 + ts0.tv_nsec;
+	mono1 = (uint64_t)ts1.tv_sec * 1000000000 + ts1.tv_nsec;
+
+	if (tst_tsc_to_ns(t1 - t0) < 100000000)
+		tst_res(TFAIL, "usleep(100000) took %llu ns",
+		        (unsigned long long)tst_tsc_to_ns(t1 - t0));
+	else
+		tst_res(TPASS, "usleep(100000) took %llu ns",
+		        (unsigned long long)tst_tsc_to_ns(t1 - t0));
+
+	/* Allow for 1ms of error accumulated since the calibration */
+	if (now + 1000000 < mono0 || now > mono1 + 1000000) {
+		tst_res(TFAIL, "Time %llu ns not in CLOCK_MONOTONIC [%llu, %llu]",
+		        (unsigned long long)now, (unsigned long long)mono0,
+		        (unsigned long long)mono1);
+	} else {
+		tst_res(TPASS, "Time differs from CLOCK_MONOTONIC by %lli ns",
+		        (long long)(now - mono0));
+	}
+}
+
+static struct tst_test test = {
+	.tid = "test14",
+	.test_all = do_test,
+};
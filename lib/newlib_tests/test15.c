@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2026 Linux Test Project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Test for the batch mode, run as ./test15 -B 4 -i 10.
+ *
+ * Each test function call passes once and forks a child that passes too,
+ * so the children count into their worker concurrently with it. Workers
+ * with odd index call tst_brk(TCONF) on their second call. The batch
+ * report must still be printed, the summary must read passed 44 and the
+ * test must exit with TCONF.
+ */
+
+#include <sys/mman.h>
+#include <stdlib.h>
+#include "tst_test.h"
+
+static int *workers;
+
+static void setup(void)
+{
+	workers = SAFE_MMAP(NULL, sizeof(*workers), PROT_READ | PROT_WRITE,
+	                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+}
+
+static void cleanup(void)
+{
+	if (workers)
+		SAFE_MUNMAP(workers, sizeof(*workers));
+}
+
+static void do_test(void)
+{
+	static int idx = -1, calls;
+
+	if (idx < 0)
+		idx = tst_atomic_inc(workers) - 1;
+
+	if (++calls == 2 && idx % 2)
+		tst_brk(TCONF, "Worker %i gives up", idx);
+
+	if (!SAFE_FORK()) {
+		tst_res(TPASS, "Child of worker %i passed", idx);
+		exit(0);
+	}
+
+	tst_res(TPASS, "Worker %i passed", idx);
+}
+
+static struct tst_test test = {
+	.tid = "test15",
+	.test_all = do_test,
+	.setup = setup,
+	.cleanup = cleanup,
+	.forks_child = 1,
+};
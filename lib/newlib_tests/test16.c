@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2026 Linux Test Project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Test for the shared memory slots, run both as ./test16 -i 3 and in
+ * batch mode as ./test16 -B 2 -i 3.
+ *
+ * The test process and two children claim one slot each in every
+ * iteration, so all three slots have to be freed between iterations and
+ * the test process must not keep using the slot it claimed before.
+ */
+
+#include <stdlib.h>
+#include "tst_test.h"
+
+#define OPS 1000
+
+static void do_test(void)
+{
+	const struct tst_slot_totals *totals = tst_slot_totals();
+	static unsigned int runs;
+	struct tst_slot *slot;
+	int i;
+
+	if (totals->slots != 3 * runs || totals->counter != 3ULL * OPS * runs) {
+		tst_res(TFAIL, "Totals after %u runs: %u slots, %llu ops",
+		        runs, totals->slots, totals->counter);
+	} else {
+		tst_res(TPASS, "Totals after %u runs: %u slots, %llu ops",
+		        runs, totals->slots, totals->counter);
+	}
+
+	runs++;
+
+	tst_slot_add(tst_slot(), OPS);
+
+	for (i = 0; i < 2; i++) {
+		if (!SAFE_FORK()) {
+			slot = tst_slot();
+			tst_slot_add(slot, OPS);
+			tst_slot_sample(slot, i + 1);
+			exit(0);
+		}
+	}
+}
+
+static struct tst_test test = {
+	.tid = "test16",
+	.test_all = do_test,
+	.forks_child = 1,
+	.shm_slots = 3,
+};
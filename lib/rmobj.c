@@ -42,6 +42,7 @@
  *
  *    SYNOPSIS:
  *      int rmobj(char *obj, char **errmsg)
+ *      int rmobj_parallel(char *obj, int nworkers, char **errmsg)
  *
  *    AUTHOR            : Kent Rogers
  *
@@ -55,22 +56,28 @@
  *      any problems, and errmsg is not NULL, errmsg is set to point to a
  *      string explaining the error.
  *
+ *      rmobj_parallel() does the same, but splits the entries directly
+ *      under a directory object between nworkers forked children.  It is
+ *      worth it for trees with many top level entries; with nworkers < 2
+ *      it is rmobj().
+ *
  *    DETAILED DESCRIPTION
- *      Allocate space for the directory and its contents
- *      Open the directory to get access to what is in it
- *      Loop through the objects in the directory:
- *        If the object is not "." or "..":
- *          Determine the file type by calling lstat()
- *          If the object is not a directory:
- *            Remove the object with unlink()
- *         Else:
- *            Call rmobj(object) to remove the object's contents
- *            Determine the link count on object by calling lstat()
- *            If the link count >= 3:
- *              Remove the directory with unlink()
- *            Else
- *               Remove the directory with rmdir()
- *      Close the directory and free the pointers
+ *      Open the object with O_DIRECTORY | O_NOFOLLOW; if it is not a
+ *      directory remove it with unlink()
+ *      Read the directory with getdents64() into a buffer, one per level
+ *      For each entry that is not "." or "..":
+ *        Use d_type, or fstatat() when the file system leaves it unset
+ *        If the entry is not a directory:
+ *          Remove it with unlinkat()
+ *        Else:
+ *          openat() it, empty it the same way and unlinkat(AT_REMOVEDIR)
+ *      Entries that vanish underneath us (ENOENT) are not errors
+ *      Remove the directory itself with rmdir()
+ *
+ *      Everything below the object is addressed relative to the parent
+ *      directory fd, so no path names are built and the depth of the
+ *      tree is not limited by PATH_MAX.  Paths are put together only
+ *      for error messages.
  *
  *    RETURN VALUE
  *      If there are any problems, rmobj() will set errmsg (if it was not
@@ -80,132 +87,289 @@
 #define _GNU_SOURCE
 #include <errno.h>		/* for errno */
 #include <stdio.h>		/* for NULL */
+#include <stdint.h>
 #include <stdlib.h>		/* for malloc() */
 #include <string.h>		/* for string function */
 #include <limits.h>		/* for PATH_MAX */
-#include <sys/types.h>		/* for opendir(), readdir(), closedir(), stat() */
-#include <sys/stat.h>		/* for [l]stat() */
+#include <sys/types.h>
+#include <sys/stat.h>		/* for fstatat() */
+#include <sys/syscall.h>	/* for SYS_getdents64 */
+#include <sys/wait.h>
 #include <fcntl.h>
-#include <dirent.h>		/* for opendir(), readdir(), closedir() */
+#include <dirent.h>		/* for DT_* */
 #include <unistd.h>		/* for rmdir(), unlink() */
 #include "rmobj.h"
 
-#define SYSERR strerror(errno)
+#define DENTS_BUFSIZE	32768
+#define MAX_WORKERS	64
 
-int rmobj(char *obj, char **errmsg)
+struct linux_dirent64 {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+/* One directory level on the way down, used to name failing entries */
+struct rmlevel {
+	const char *name;
+	const struct rmlevel *up;
+};
+
+static char err_msg[PATH_MAX + 128];	/* error message */
+
+static int rm_path(const struct rmlevel *lvl, char *buf, int size)
 {
-	int ret_val = 0;	/* return value from this routine */
-	DIR *dir;		/* pointer to a directory */
-	struct dirent *dir_ent;	/* pointer to directory entries */
-	char dirobj[PATH_MAX];	/* object inside directory to modify */
-	struct stat statbuf;	/* used to hold stat information */
-	static char err_msg[1024];	/* error message */
-	int fd;
-
-	/* Determine the file type */
-
-	fd = open(obj, O_DIRECTORY | O_NOFOLLOW);
-	if (fd != -1) {
-		close(fd);
-		/* object is a directory */
-
-		/* Do NOT perform the request if the directory is "/" */
-		if (!strcmp(obj, "/")) {
-			if (errmsg != NULL) {
-				sprintf(err_msg, "Cannot remove /");
-				*errmsg = err_msg;
-			}
-			return -1;
-		}
+	int len = 0;
 
-		/* Open the directory to get access to what is in it */
-		if ((dir = opendir(obj)) == NULL) {
-			if (rmdir(obj) != 0) {
-				if (errmsg != NULL) {
-					sprintf(err_msg,
-						"rmdir(%s) failed; errno=%d: %s",
-						obj, errno, SYSERR);
-					*errmsg = err_msg;
-				}
-				return -1;
-			} else {
-				return 0;
-			}
-		}
+	if (lvl->up)
+		len = rm_path(lvl->up, buf, size);
+
+	if (len < size)
+		len += snprintf(buf + len, size - len, "%s%s",
+				lvl->up ? "/" : "", lvl->name);
+
+	return len;
+}
+
+static int rm_error(const struct rmlevel *up, const char *name,
+		    const char *op, char **errmsg)
+{
+	int err = errno;
+	struct rmlevel lvl = { name, up };
+	char path[PATH_MAX];
+
+	if (errmsg != NULL) {
+		rm_path(&lvl, path, sizeof(path));
+		snprintf(err_msg, sizeof(err_msg),
+			 "%s(%s) failed; errno=%d: %s",
+			 op, path, err, strerror(err));
+		*errmsg = err_msg;
+	}
 
-		/* Loop through the entries in the directory, removing each one */
-		for (dir_ent = (struct dirent *)readdir(dir);
-		     dir_ent != NULL; dir_ent = (struct dirent *)readdir(dir)) {
+	return -1;
+}
 
-			/* Don't remove "." or ".." */
-			if (!strcmp(dir_ent->d_name, ".")
-			    || !strcmp(dir_ent->d_name, ".."))
+static int is_dot(const char *name)
+{
+	return name[0] == '.' &&
+	       (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+static int rm_entry(int dirfd, const char *name, int type,
+		    const struct rmlevel *up, char **errmsg);
+
+/*
+ * Removes everything inside the directory open as dirfd, lvl names that
+ * directory. Keeps going after a failure so that as much as possible is
+ * gone, the last error is the one reported.
+ */
+static int rm_contents(int dirfd, const struct rmlevel *lvl, char **errmsg)
+{
+	struct linux_dirent64 *d;
+	char *buf;
+	long n, pos;
+	int ret_val = 0;
+
+	buf = malloc(DENTS_BUFSIZE);
+	if (buf == NULL)
+		return rm_error(lvl->up, lvl->name, "malloc", errmsg);
+
+	while ((n = syscall(SYS_getdents64, dirfd, buf, DENTS_BUFSIZE)) > 0) {
+		for (pos = 0; pos < n; pos += d->d_reclen) {
+			d = (struct linux_dirent64 *)(buf + pos);
+
+			if (is_dot(d->d_name))
 				continue;
 
-			/* Recursively call this routine to remove the current entry */
-			sprintf(dirobj, "%s/%s", obj, dir_ent->d_name);
-			if (rmobj(dirobj, errmsg) != 0)
+			if (rm_entry(dirfd, d->d_name, d->d_type, lvl, errmsg))
 				ret_val = -1;
 		}
+	}
 
-		/* Close the directory */
-		closedir(dir);
-
-		/* If there were problems removing an entry, don't attempt to
-		   remove the directory itself */
-		if (ret_val == -1)
-			return -1;
-
-		/* Get the link count, now that all the entries have been removed */
-		if (lstat(obj, &statbuf) < 0) {
-			if (errmsg != NULL) {
-				sprintf(err_msg,
-					"lstat(%s) failed; errno=%d: %s", obj,
-					errno, SYSERR);
-				*errmsg = err_msg;
-			}
-			return -1;
+	if (n < 0)
+		ret_val = rm_error(lvl->up, lvl->name, "getdents64", errmsg);
+
+	free(buf);
+	return ret_val;
+}
+
+static int rm_entry(int dirfd, const char *name, int type,
+		    const struct rmlevel *up, char **errmsg)
+{
+	struct rmlevel lvl = { name, up };
+	struct stat statbuf;
+	int fd, ret_val;
+
+	if (type == DT_UNKNOWN) {
+		if (fstatat(dirfd, name, &statbuf, AT_SYMLINK_NOFOLLOW) < 0) {
+			if (errno == ENOENT)
+				return 0;
+			return rm_error(up, name, "lstat", errmsg);
 		}
+		type = S_ISDIR(statbuf.st_mode) ? DT_DIR : DT_REG;
+	}
+
+	if (type != DT_DIR) {
+		if (unlinkat(dirfd, name, 0) == 0 || errno == ENOENT)
+			return 0;
+		return rm_error(up, name, "unlink", errmsg);
+	}
 
-		/* Remove the directory itself */
-		if (statbuf.st_nlink >= 3) {
-			/* The directory is linked; unlink() must be used */
-			if (unlink(obj) < 0) {
-				if (errmsg != NULL) {
-					sprintf(err_msg,
-						"unlink(%s) failed; errno=%d: %s",
-						obj, errno, SYSERR);
-					*errmsg = err_msg;
-				}
-				return -1;
+	fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+	if (fd == -1) {
+		if (errno == ENOENT)
+			return 0;
+		/* We cannot look inside, but it may be empty already */
+		if (unlinkat(dirfd, name, AT_REMOVEDIR) == 0)
+			return 0;
+		return rm_error(up, name, "rmdir", errmsg);
+	}
+
+	ret_val = rm_contents(fd, &lvl, errmsg);
+	close(fd);
+
+	/* If there were problems removing an entry, don't attempt to
+	   remove the directory itself */
+	if (ret_val == -1)
+		return -1;
+
+	if (unlinkat(dirfd, name, AT_REMOVEDIR) == 0 || errno == ENOENT)
+		return 0;
+
+	return rm_error(up, name, "rmdir", errmsg);
+}
+
+/*
+ * Splits the entries of the directory open as dirfd between nworkers
+ * children. Worker errors are not reported from here, whatever they
+ * failed to remove is left for the serial pass in the caller, which
+ * reports it.
+ */
+static void rm_fanout(int dirfd, int nworkers)
+{
+	struct linux_dirent64 *d;
+	struct rmlevel top = { ".", NULL };
+	char *buf, *names = NULL, *tmp;
+	unsigned char *types = NULL;
+	size_t *offs = NULL;
+	size_t nlen = 0, nsize = 0, cnt = 0, size = 0, i;
+	long n, pos;
+	pid_t pids[MAX_WORKERS];
+	int w, status;
+
+	buf = malloc(DENTS_BUFSIZE);
+	if (buf == NULL)
+		return;
+
+	while ((n = syscall(SYS_getdents64, dirfd, buf, DENTS_BUFSIZE)) > 0) {
+		for (pos = 0; pos < n; pos += d->d_reclen) {
+			size_t len;
+
+			d = (struct linux_dirent64 *)(buf + pos);
+			if (is_dot(d->d_name))
+				continue;
+
+			len = strlen(d->d_name) + 1;
+			if (nlen + len > nsize) {
+				nsize = nsize ? 2 * nsize + len : 4096 + len;
+				tmp = realloc(names, nsize);
+				if (tmp == NULL)
+					goto out;
+				names = tmp;
 			}
-		} else {
-			/* The directory is not linked; remove() can be used */
-			if (remove(obj) < 0) {
-				if (errmsg != NULL) {
-					sprintf(err_msg,
-						"remove(%s) failed; errno=%d: %s",
-						obj, errno, SYSERR);
-					*errmsg = err_msg;
-				}
-				return -1;
+			if (cnt == size) {
+				size = size ? 2 * size : 256;
+				tmp = realloc(offs, size * sizeof(*offs));
+				if (tmp == NULL)
+					goto out;
+				offs = (size_t *)tmp;
+				tmp = realloc(types, size);
+				if (tmp == NULL)
+					goto out;
+				types = (unsigned char *)tmp;
 			}
+			memcpy(names + nlen, d->d_name, len);
+			offs[cnt] = nlen;
+			types[cnt++] = d->d_type;
+			nlen += len;
+		}
+	}
+
+	if (nworkers > MAX_WORKERS)
+		nworkers = MAX_WORKERS;
+	if ((size_t)nworkers > cnt)
+		nworkers = cnt;
+
+	for (w = 0; w < nworkers; w++) {
+		pids[w] = fork();
+		if (pids[w] == -1)
+			break;
+		if (pids[w] == 0) {
+			for (i = w; i < cnt; i += nworkers)
+				rm_entry(dirfd, names + offs[i], types[i], &top,
+					 NULL);
+			_exit(0);
 		}
-	} else {
+	}
+
+	/* Don't reap anything else, the caller may have children of its own */
+	while (w-- > 0)
+		waitpid(pids[w], &status, 0);
+
+out:
+	free(types);
+	free(offs);
+	free(names);
+	free(buf);
+}
+
+int rmobj_parallel(char *obj, int nworkers, char **errmsg)
+{
+	struct rmlevel top = { obj, NULL };
+	int fd, ret_val;
+
+	/* Do NOT perform the request if the directory is "/" */
+	if (!strcmp(obj, "/")) {
+		if (errmsg != NULL) {
+			sprintf(err_msg, "Cannot remove /");
+			*errmsg = err_msg;
+		}
+		return -1;
+	}
+
+	fd = open(obj, O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+	if (fd == -1) {
 		/* object is not a directory; just use unlink() */
-		if (unlink(obj) < 0) {
-			if (errmsg != NULL) {
-				sprintf(err_msg,
-					"unlink(%s) failed; errno=%d: %s", obj,
-					errno, SYSERR);
-				*errmsg = err_msg;
-			}
-			return -1;
+		if (errno == ENOTDIR || errno == ELOOP) {
+			if (unlink(obj) < 0)
+				return rm_error(NULL, obj, "unlink", errmsg);
+			return 0;
 		}
-	}			/* if obj is a directory */
+		if (rmdir(obj) != 0)
+			return rm_error(NULL, obj, "rmdir", errmsg);
+		return 0;
+	}
+
+	if (nworkers > 1) {
+		rm_fanout(fd, nworkers);
+		lseek(fd, 0, SEEK_SET);
+	}
+
+	ret_val = rm_contents(fd, &top, errmsg);
+	close(fd);
+
+	if (ret_val == -1)
+		return -1;
+
+	if (rmdir(obj) < 0)
+		return rm_error(NULL, obj, "rmdir", errmsg);
 
-	/*
-	 * Everything must have went ok.
-	 */
 	return 0;
-}				/* rmobj() */
+}
+
+int rmobj(char *obj, char **errmsg)
+{
+	return rmobj_parallel(obj, 1, errmsg);
+}
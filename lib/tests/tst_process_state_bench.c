@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016 Linux Test Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Measures how long TST_PROCESS_STATE_WAIT() takes to notice that a child
+ * went to sleep, i.e. the time between the child calling pause() and the
+ * parent returning from the wait. The second part waits for a whole set
+ * of children with TST_PROCESS_STATE_WAIT_ALL() and measures from the
+ * moment the last of them went to sleep.
+ *
+ * Usage: tst_process_state_bench [iterations]
+ */
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "test.h"
+
+char *TCID = "tst_process_state_bench";
+int TST_TOTAL = 1;
+
+#define SET_SIZE	8
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void handler(int sig LTP_ATTRIBUTE_UNUSED)
+{
+}
+
+static pid_t sleeper(volatile long long *asleep, int spin_us)
+{
+	long long end;
+	pid_t pid;
+
+	pid = fork();
+	if (pid == -1)
+		tst_brkm(TBROK | TERRNO, NULL, "fork() failed");
+
+	if (pid == 0) {
+		signal(SIGUSR1, handler);
+		end = now_ns() + spin_us * 1000LL;
+		while (now_ns() < end)
+			;
+		*asleep = now_ns();
+		pause();
+		_exit(0);
+	}
+
+	return pid;
+}
+
+static void reap(pid_t pid)
+{
+	kill(pid, SIGUSR1);
+	waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+	volatile long long *asleep;
+	pid_t pids[SET_SIZE];
+	long long lat, sum = 0, max = 0, last, set_sum = 0;
+	int i, j, iters = 200;
+
+	if (argc > 1)
+		iters = atoi(argv[1]);
+
+	asleep = mmap(NULL, getpagesize(), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (asleep == MAP_FAILED)
+		tst_brkm(TBROK | TERRNO, NULL, "mmap() failed");
+
+	for (i = 0; i < iters; i++) {
+		pids[0] = sleeper(asleep, i % 1000);
+		TST_PROCESS_STATE_WAIT(NULL, pids[0], 'S');
+		lat = now_ns() - asleep[0];
+		sum += lat;
+		if (lat > max)
+			max = lat;
+		reap(pids[0]);
+	}
+
+	for (i = 0; i < iters; i++) {
+		for (j = 0; j < SET_SIZE; j++)
+			pids[j] = sleeper(&asleep[j], (i + j * 97) % 1000);
+		TST_PROCESS_STATE_WAIT_ALL(NULL, pids, SET_SIZE, 'S');
+		lat = now_ns();
+		for (last = 0, j = 0; j < SET_SIZE; j++) {
+			if (asleep[j] > last)
+				last = asleep[j];
+		}
+		set_sum += lat - last;
+		for (j = 0; j < SET_SIZE; j++)
+			reap(pids[j]);
+	}
+
+	tst_resm(TPASS, "single: avg %lldus max %lldus, set of %i: avg %lldus",
+		 sum / iters / 1000, max / 1000, SET_SIZE,
+		 set_sum / iters / 1000);
+	tst_exit();
+}
@@ -17,7 +17,12 @@
  *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include "test.h"
 #include "safe_macros.h"
@@ -71,3 +76,426 @@ long tst_ncpus_max(void)
 	}
 	return ncpus_max;
 }
+
+/*
+ * CPU topology
+ *
+ * The model is built from sysfs on the first call of tst_cpu_topology() and
+ * kept for the rest of the process. Everything that is missing in sysfs
+ * (containers, old kernels, no NUMA) degrades to the simplest answer: each
+ * CPU is its own core, the package is the LLC domain, all CPUs are on node 0.
+ */
+
+#define SYS_CPU		"/sys/devices/system/cpu"
+#define SYS_NODE	"/sys/devices/system/node"
+
+static struct tst_cpu_topology *topology;
+
+static int read_sysfs(const char *path, char *buf, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return -1;
+
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+
+	buf[len] = '\0';
+	return 0;
+}
+
+static int read_sysfs_int(const char *path, int *val)
+{
+	char buf[64];
+
+	if (read_sysfs(path, buf, sizeof(buf)))
+		return -1;
+
+	*val = atoi(buf);
+	return 0;
+}
+
+/*
+ * Parses a cpu list such as "0-3,8,10-11" into set, an array of max chars.
+ * Returns the lowest number in the list or -1 if it is empty or invalid.
+ */
+static int parse_cpulist(const char *str, char *set, int max)
+{
+	long first, last, i, lowest = -1;
+	char *end;
+
+	while (*str && *str != '\n') {
+		first = last = strtol(str, &end, 10);
+		if (end == str)
+			return -1;
+		if (*end == '-') {
+			str = end + 1;
+			last = strtol(str, &end, 10);
+			if (end == str)
+				return -1;
+		}
+		for (i = first; i <= last && i < max; i++) {
+			if (i >= 0 && set)
+				set[i] = 1;
+		}
+		if (lowest == -1 || first < lowest)
+			lowest = first;
+		str = *end == ',' ? end + 1 : end;
+		if (*end && *end != ',' && *end != '\n')
+			return -1;
+	}
+
+	return lowest;
+}
+
+/* Lowest CPU in the list read from path, or -1 */
+static int read_cpulist_min(const char *path)
+{
+	char buf[4096];
+
+	if (read_sysfs(path, buf, sizeof(buf)))
+		return -1;
+
+	return parse_cpulist(buf, NULL, 0);
+}
+
+/* The LLC domain is named by the lowest CPU sharing the deepest data cache */
+static int read_llc_key(int cpu)
+{
+	char path[256], buf[64];
+	int i, level, best_level = -1, key = -1;
+
+	for (i = 0; ; i++) {
+		snprintf(path, sizeof(path), SYS_CPU "/cpu%i/cache/index%i/type",
+			 cpu, i);
+		if (read_sysfs(path, buf, sizeof(buf)))
+			break;
+		if (!strncmp(buf, "Instruction", 11))
+			continue;
+
+		snprintf(path, sizeof(path), SYS_CPU "/cpu%i/cache/index%i/level",
+			 cpu, i);
+		if (read_sysfs_int(path, &level) || level <= best_level)
+			continue;
+
+		snprintf(path, sizeof(path),
+			 SYS_CPU "/cpu%i/cache/index%i/shared_cpu_list", cpu, i);
+		key = read_cpulist_min(path);
+		best_level = level;
+	}
+
+	return key;
+}
+
+/* Maps key to a dense index, keys are assigned in order of appearance */
+static int compact_id(int *keys, int *nkeys, int key)
+{
+	int i;
+
+	for (i = 0; i < *nkeys; i++) {
+		if (keys[i] == key)
+			return i;
+	}
+
+	keys[(*nkeys)++] = key;
+	return i;
+}
+
+static void *topo_alloc(size_t size)
+{
+	void *ptr = calloc(1, size);
+
+	if (!ptr)
+		tst_brkm(TBROK | TERRNO, NULL, "calloc(%zu) failed", size);
+
+	return ptr;
+}
+
+static void read_nodes(struct tst_cpu_topology *topo, int max,
+		       char *online, int *node_of)
+{
+	char path[256], buf[4096], *set, *p, *end;
+	int i, j, n, nnodes = 0;
+
+	topo->node_ids = topo_alloc(max * sizeof(int));
+
+	if (!read_sysfs(SYS_NODE "/online", buf, sizeof(buf))) {
+		set = topo_alloc(max);
+		parse_cpulist(buf, set, max);
+		for (i = 0; i < max; i++) {
+			if (set[i])
+				topo->node_ids[nnodes++] = i;
+		}
+		free(set);
+	}
+
+	if (!nnodes) {
+		topo->nnodes = 1;
+		topo->distance = topo_alloc(sizeof(int));
+		topo->distance[0] = 10;
+		return;
+	}
+
+	topo->nnodes = nnodes;
+	topo->distance = topo_alloc(nnodes * nnodes * sizeof(int));
+	set = topo_alloc(max);
+
+	for (n = 0; n < nnodes; n++) {
+		snprintf(path, sizeof(path), SYS_NODE "/node%i/cpulist",
+			 topo->node_ids[n]);
+		memset(set, 0, max);
+		if (!read_sysfs(path, buf, sizeof(buf))) {
+			parse_cpulist(buf, set, max);
+			for (i = 0; i < max; i++) {
+				if (set[i] && online[i])
+					node_of[i] = topo->node_ids[n];
+			}
+		}
+
+		snprintf(path, sizeof(path), SYS_NODE "/node%i/distance",
+			 topo->node_ids[n]);
+		if (read_sysfs(path, buf, sizeof(buf)))
+			buf[0] = '\0';
+		for (p = buf, j = 0; j < nnodes; j++, p = end) {
+			topo->distance[n * nnodes + j] = strtol(p, &end, 10);
+			if (end == p)
+				topo->distance[n * nnodes + j] = n == j ? 10 : -1;
+		}
+	}
+
+	free(set);
+}
+
+static struct tst_cpu_topology *build_topology(void)
+{
+	struct tst_cpu_topology *topo;
+	struct tst_cpu_info *info;
+	char path[256], buf[4096], *online;
+	int *node_of, *pkg_keys, *core_keys, *llc_keys;
+	int max, i, key, npkgs = 0;
+	cpu_set_t *mask;
+	size_t mask_size;
+
+	max = tst_ncpus_max();
+	if (max < tst_ncpus_conf())
+		max = tst_ncpus_conf();
+
+	topo = topo_alloc(sizeof(*topo));
+	topo->cpus = topo_alloc(max * sizeof(*topo->cpus));
+	online = topo_alloc(max);
+	node_of = topo_alloc(max * sizeof(int));
+	pkg_keys = topo_alloc(max * sizeof(int));
+	core_keys = topo_alloc(max * sizeof(int));
+	llc_keys = topo_alloc(max * sizeof(int));
+
+	if (read_sysfs(SYS_CPU "/online", buf, sizeof(buf)) ||
+	    parse_cpulist(buf, online, max) == -1) {
+		for (i = 0; i < tst_ncpus(); i++)
+			online[i] = 1;
+	}
+
+	read_nodes(topo, max, online, node_of);
+
+	/* cpuset cgroup restrictions are part of the affinity mask */
+	mask = CPU_ALLOC(max);
+	mask_size = CPU_ALLOC_SIZE(max);
+	if (!mask)
+		tst_brkm(TBROK | TERRNO, NULL, "CPU_ALLOC(%i) failed", max);
+	if (sched_getaffinity(0, mask_size, mask)) {
+		memset(mask, 0, mask_size);
+		for (i = 0; i < max; i++)
+			CPU_SET_S(i, mask_size, mask);
+	}
+
+	for (i = 0; i < max; i++) {
+		if (!online[i])
+			continue;
+
+		info = &topo->cpus[topo->ncpus++];
+		info->cpu = i;
+		info->node = node_of[i];
+		info->allowed = !!CPU_ISSET_S(i, mask_size, mask);
+		topo->nallowed += info->allowed;
+
+		snprintf(path, sizeof(path),
+			 SYS_CPU "/cpu%i/topology/physical_package_id", i);
+		if (read_sysfs_int(path, &key) || key < 0)
+			key = 0;
+		info->package = compact_id(pkg_keys, &npkgs, key);
+
+		snprintf(path, sizeof(path),
+			 SYS_CPU "/cpu%i/topology/thread_siblings_list", i);
+		key = read_cpulist_min(path);
+		info->core = compact_id(core_keys, &topo->ncores,
+					key == -1 ? i : key);
+
+		key = read_llc_key(i);
+		/* Different packages never share a cache */
+		if (key == -1)
+			key = -1 - info->package;
+		info->llc = compact_id(llc_keys, &topo->nllcs, key);
+	}
+
+	topo->npackages = npkgs;
+
+	CPU_FREE(mask);
+	free(llc_keys);
+	free(core_keys);
+	free(pkg_keys);
+	free(node_of);
+	free(online);
+
+	return topo;
+}
+
+const struct tst_cpu_topology *tst_cpu_topology(void)
+{
+	struct tst_cpu_topology *topo;
+
+	if (topology)
+		return topology;
+
+	topo = build_topology();
+
+	/* Two threads may race here, the loser throws its copy away */
+	if (!__sync_bool_compare_and_swap(&topology, NULL, topo)) {
+		free(topo->distance);
+		free(topo->node_ids);
+		free(topo->cpus);
+		free(topo);
+	}
+
+	return topology;
+}
+
+int tst_cpu_node_distance(int node1, int node2)
+{
+	const struct tst_cpu_topology *topo = tst_cpu_topology();
+	int i, n1 = -1, n2 = -1;
+
+	if (topo->nnodes == 1 && node1 == 0 && node2 == 0)
+		return topo->distance[0];
+
+	for (i = 0; i < topo->nnodes; i++) {
+		if (topo->node_ids[i] == node1)
+			n1 = i;
+		if (topo->node_ids[i] == node2)
+			n2 = i;
+	}
+
+	if (n1 == -1 || n2 == -1)
+		return -1;
+
+	return topo->distance[n1 * topo->nnodes + n2];
+}
+
+struct place_key {
+	int smt;
+	int core_rank;
+	int llc;
+	int cpu;
+};
+
+static int place_key_cmp(const void *a, const void *b)
+{
+	const struct place_key *ka = a, *kb = b;
+
+	if (ka->smt != kb->smt)
+		return ka->smt - kb->smt;
+	if (ka->core_rank != kb->core_rank)
+		return ka->core_rank - kb->core_rank;
+	if (ka->llc != kb->llc)
+		return ka->llc - kb->llc;
+	return ka->cpu - kb->cpu;
+}
+
+int tst_cpu_place(int policy, int *cpus, int size)
+{
+	const struct tst_cpu_topology *topo = tst_cpu_topology();
+	const struct tst_cpu_info *info;
+	struct place_key *keys;
+	int *core_seen, *core_rank, *llc_cores;
+	char *node_seen;
+	int i, n, nkeys = 0, ret = 0;
+
+	keys = topo_alloc(topo->ncpus * sizeof(*keys));
+	core_seen = topo_alloc(topo->ncores * sizeof(int));
+	core_rank = topo_alloc(topo->ncores * sizeof(int));
+	llc_cores = topo_alloc(topo->nllcs * sizeof(int));
+	node_seen = topo_alloc(topo->nnodes);
+
+	for (i = 0; i < topo->ncpus; i++) {
+		info = &topo->cpus[i];
+		if (!info->allowed)
+			continue;
+
+		keys[nkeys].cpu = info->cpu;
+		keys[nkeys].llc = info->llc;
+		keys[nkeys].smt = core_seen[info->core]++;
+		if (!keys[nkeys].smt)
+			core_rank[info->core] = llc_cores[info->llc]++;
+		keys[nkeys].core_rank = core_rank[info->core];
+
+		switch (policy) {
+		case TST_CPU_PER_CORE:
+			if (keys[nkeys].smt)
+				continue;
+			break;
+		case TST_CPU_PER_LLC:
+			if (keys[nkeys].smt || keys[nkeys].core_rank)
+				continue;
+			break;
+		case TST_CPU_PER_NODE:
+			for (n = 0; n < topo->nnodes - 1; n++) {
+				if (topo->node_ids[n] == info->node)
+					break;
+			}
+			if (node_seen[n])
+				continue;
+			node_seen[n] = 1;
+			/* Ordered by node */
+			keys[nkeys].smt = keys[nkeys].core_rank = 0;
+			keys[nkeys].llc = n;
+			break;
+		}
+
+		nkeys++;
+	}
+
+	qsort(keys, nkeys, sizeof(*keys), place_key_cmp);
+
+	for (i = 0; i < nkeys && i < size; i++)
+		cpus[ret++] = keys[i].cpu;
+
+	free(node_seen);
+	free(llc_cores);
+	free(core_rank);
+	free(core_seen);
+	free(keys);
+
+	return ret;
+}
+
+int tst_cpu_bind(int cpu)
+{
+	cpu_set_t *mask;
+	size_t mask_size;
+	int ret;
+
+	mask = CPU_ALLOC(cpu + 1);
+	if (!mask)
+		return -1;
+
+	mask_size = CPU_ALLOC_SIZE(cpu + 1);
+	CPU_ZERO_S(mask_size, mask);
+	CPU_SET_S(cpu, mask_size, mask);
+	ret = sched_setaffinity(0, mask_size, mask);
+	CPU_FREE(mask);
+
+	return ret;
+}
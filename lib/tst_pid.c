@@ -20,6 +20,10 @@
 
 #include <fcntl.h>
 #include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include "test.h"
 #include "tst_pid.h"
@@ -36,29 +40,189 @@ pid_t tst_get_unused_pid_(void (*cleanup_fn) (void))
 	return pid;
 }
 
-int tst_get_free_pids_(void (*cleanup_fn) (void))
+/*
+ * The number of free pids is limited by pid_max, by threads-max and by the
+ * pids controller of every cgroup up the hierarchy. The limits are read
+ * into struct pid_limits, the usage is the thread count from /proc/loadavg
+ * and pids.current of each limited cgroup.
+ */
+
+#define THREADS_MAX_PATH "/proc/sys/kernel/threads-max"
+#define LOADAVG_PATH "/proc/loadavg"
+#define CGROUP_PATH "/proc/self/cgroup"
+#define MAX_CGROUPS 16
+
+struct pid_limits {
+	int max_pids;
+	int threads_max;
+	int ncgroups;
+	int cg_max[MAX_CGROUPS];
+	char cg_current[MAX_CGROUPS][PATH_MAX];
+};
+
+static int read_int(const char *path, int *val)
+{
+	FILE *f;
+	int rc;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+
+	rc = fscanf(f, "%i", val);
+	fclose(f);
+
+	return rc == 1 ? 0 : -1;
+}
+
+/* Finds the pids controller directory of this process, v1 first */
+static int find_pids_cgroup(char *dir, size_t size)
+{
+	char line[PATH_MAX], *ctrls, *path;
+	char v2_path[PATH_MAX] = "";
+	FILE *f;
+
+	f = fopen(CGROUP_PATH, "r");
+	if (!f)
+		return -1;
+
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\n")] = '\0';
+		ctrls = strchr(line, ':');
+		if (!ctrls)
+			continue;
+		path = strchr(++ctrls, ':');
+		if (!path)
+			continue;
+		*path++ = '\0';
+
+		if (!*ctrls) {
+			snprintf(v2_path, sizeof(v2_path), "%s", path);
+			continue;
+		}
+
+		/* The list is comma separated, e.g. "cpu,cpuacct" */
+		for (ctrls = strtok(ctrls, ","); ctrls; ctrls = strtok(NULL, ",")) {
+			if (!strcmp(ctrls, "pids")) {
+				fclose(f);
+				snprintf(dir, size, "/sys/fs/cgroup/pids%s", path);
+				return 0;
+			}
+		}
+	}
+	fclose(f);
+
+	if (!*v2_path)
+		return -1;
+
+	if (access("/sys/fs/cgroup/cgroup.controllers", F_OK) == 0)
+		snprintf(dir, size, "/sys/fs/cgroup%s", v2_path);
+	else
+		snprintf(dir, size, "/sys/fs/cgroup/unified%s", v2_path);
+
+	return 0;
+}
+
+static void read_pid_limits(void (*cleanup_fn) (void), struct pid_limits *lim)
 {
+	char dir[PATH_MAX], path[PATH_MAX + 16], buf[32], *slash;
 	FILE *f;
-	int rc, used_pids, max_pids;
+	int max;
+
+	SAFE_FILE_SCANF(cleanup_fn, PID_MAX_PATH, "%d", &lim->max_pids);
+
+	if (read_int(THREADS_MAX_PATH, &lim->threads_max))
+		lim->threads_max = INT_MAX;
+
+	lim->ncgroups = 0;
+	if (find_pids_cgroup(dir, sizeof(dir)))
+		return;
+
+	/* Walk up to the root, any level may set a limit */
+	for (;;) {
+		snprintf(path, sizeof(path), "%s/pids.max", dir);
+		f = fopen(path, "r");
+		if (f) {
+			if (fscanf(f, "%31s", buf) == 1 && strcmp(buf, "max") &&
+			    snprintf(lim->cg_current[lim->ncgroups], PATH_MAX,
+				     "%s/pids.current", dir) < PATH_MAX) {
+				max = atoi(buf);
+				lim->cg_max[lim->ncgroups++] = max;
+			}
+			fclose(f);
+		}
+
+		if (lim->ncgroups == MAX_CGROUPS)
+			break;
+
+		slash = strrchr(dir, '/');
+		if (!slash || !strcmp(dir, "/sys/fs/cgroup"))
+			break;
+		*slash = '\0';
+	}
+}
+
+static int count_free_pids(const struct pid_limits *lim)
+{
+	int i, used_pids, cur, free_pids, cg_free;
 
-	f = popen("ps -eT | wc -l", "r");
-	if (!f) {
-		tst_resm(TBROK, "Could not run 'ps' to calculate used " "pids");
+	/* The fourth field is "running/total" scheduling entities */
+	if (FILE_SCANF(LOADAVG_PATH, "%*s %*s %*s %*d/%d", &used_pids) ||
+	    used_pids < 0) {
+		tst_resm(TBROK, "Could not read %s to calculate used pids",
+			 LOADAVG_PATH);
 		return -1;
 	}
-	rc = fscanf(f, "%i", &used_pids);
-	pclose(f);
 
-	if (rc != 1 || used_pids < 0) {
-		tst_resm(TBROK, "Could not read output of 'ps' to "
-			 "calculate used pids");
+	/* pid_max is the maximum PID + 1 and pid 0 is never used */
+	free_pids = lim->max_pids - 1 - used_pids;
+
+	if (lim->threads_max - used_pids < free_pids)
+		free_pids = lim->threads_max - used_pids;
+
+	for (i = 0; i < lim->ncgroups; i++) {
+		if (read_int(lim->cg_current[i], &cur))
+			continue;
+		cg_free = lim->cg_max[i] - cur;
+		if (cg_free < free_pids)
+			free_pids = cg_free;
+	}
+
+	if (free_pids < 0)
+		free_pids = 0;
+
+	return free_pids;
+}
+
+int tst_get_free_pids_(void (*cleanup_fn) (void))
+{
+	struct pid_limits *lim;
+	int free_pids;
+
+	/* Too big for the stack with MAX_CGROUPS paths */
+	lim = malloc(sizeof(*lim));
+	if (!lim) {
+		tst_brkm(TBROK | TERRNO, cleanup_fn,
+			 "malloc(%zu) failed", sizeof(*lim));
 		return -1;
 	}
 
-	SAFE_FILE_SCANF(cleanup_fn, PID_MAX_PATH, "%d", &max_pids);
+	read_pid_limits(cleanup_fn, lim);
+	free_pids = count_free_pids(lim);
+	free(lim);
+
+	return free_pids;
+}
+
+int tst_get_free_pids_cached_(void (*cleanup_fn) (void))
+{
+	static struct pid_limits lim;
+	static int limits_read;
+
+	if (!limits_read) {
+		read_pid_limits(cleanup_fn, &lim);
+		limits_read = 1;
+	}
 
-	/* max_pids contains the maximum PID + 1,
-	 * used_pids contains used PIDs + 1,
-	 * so this additional '1' is eliminated by the substraction */
-	return max_pids - used_pids;
+	return count_free_pids(&lim);
 }
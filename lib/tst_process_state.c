@@ -21,57 +21,236 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+/*
+ * The waiter keeps /proc/<pid>/stat open and re-reads it with pread(), the
+ * kernel regenerates the content on each read from offset 0. The first few
+ * polls only yield the CPU since the process we wait for is usually about to
+ * block, then the sleep between the polls doubles up to MAX_SLEEP_NS. The
+ * sleeps are done in ppoll() on pidfds, so a process that exits instead of
+ * reaching the state is noticed right away rather than polled forever.
+ */
+
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
 
 #include "test.h"
 #include "tst_process_state.h"
+#include "lapi/pidfd.h"
 
-void tst_process_state_wait(const char *file, const int lineno,
-                            void (*cleanup_fn)(void),
-                            pid_t pid, const char state)
-{
-	char proc_path[128], cur_state;
+#define SPIN_POLLS	16
+#define MIN_SLEEP_NS	10000
+#define MAX_SLEEP_NS	10000000
 
-	snprintf(proc_path, sizeof(proc_path), "/proc/%i/stat", pid);
+struct proc_waiter {
+	pid_t pid;
+	int stat_fd;
+};
 
-	for (;;) {
-		safe_file_scanf(file, lineno, cleanup_fn, proc_path,
-		                "%*i %*s %c", &cur_state);
+static int read_state(int fd, char *state)
+{
+	char buf[512], *p;
+	ssize_t len;
 
-		if (state == cur_state)
-			return;
+	len = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0) {
+		if (len == 0)
+			errno = ESRCH;
+		return -1;
+	}
+	buf[len] = '\0';
 
-		usleep(10000);
+	/* The comm field may contain spaces and parens, skip past the last ')' */
+	p = strrchr(buf, ')');
+	if (!p || p[1] != ' ' || !p[2]) {
+		errno = EINVAL;
+		return -1;
 	}
+
+	*state = p[2];
+	return 0;
 }
 
-int tst_process_state_wait2(pid_t pid, const char state)
+/*
+ * Waits until all processes are in the state. On failure returns -1 with
+ * errno set, *fail_op set to the operation that failed and *fail_pid to the
+ * process it failed for. A process that has exited fails with ESRCH.
+ */
+static int wait_state(const pid_t *pids, unsigned int cnt, char state,
+		      pid_t *fail_pid, const char **fail_op)
 {
-	char proc_path[128], cur_state;
+	struct proc_waiter *w;
+	struct pollfd *pfds;
+	struct timespec ts;
+	char path[128], cur_state;
+	unsigned int i, left, polls = 0;
+	long sleep_ns = MIN_SLEEP_NS;
+	int ret = -1, err = 0;
 
-	snprintf(proc_path, sizeof(proc_path), "/proc/%i/stat", pid);
+	w = malloc(cnt * sizeof(*w));
+	pfds = malloc(cnt * sizeof(*pfds));
+	if (!w || !pfds) {
+		free(w);
+		free(pfds);
+		*fail_op = "malloc";
+		*fail_pid = cnt ? pids[0] : 0;
+		return -1;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		w[i].pid = pids[i];
+		w[i].stat_fd = -1;
+		pfds[i].fd = -1;
+		pfds[i].events = POLLIN;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		snprintf(path, sizeof(path), "/proc/%i/stat", pids[i]);
+		w[i].stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (w[i].stat_fd == -1) {
+			err = errno;
+			*fail_op = "open";
+			*fail_pid = pids[i];
+			goto out;
+		}
+
+		/* Not supported on older kernels, we just sleep then */
+		pfds[i].fd = ltp_pidfd_open(pids[i], 0);
+	}
+
+	left = cnt;
 
 	for (;;) {
-		FILE *f = fopen(proc_path, "r");
-		if (!f) {
-			fprintf(stderr, "Failed to open '%s': %s\n",
-			        proc_path, strerror(errno));
-			return 1;
+		for (i = 0; i < left; ) {
+			if (read_state(w[i].stat_fd, &cur_state)) {
+				err = errno;
+				*fail_op = "read";
+				*fail_pid = w[i].pid;
+				goto out;
+			}
+
+			if (cur_state != state) {
+				i++;
+				continue;
+			}
+
+			/* Done with this one, move the last one in its place */
+			close(w[i].stat_fd);
+			if (pfds[i].fd != -1)
+				close(pfds[i].fd);
+			left--;
+			w[i] = w[left];
+			pfds[i] = pfds[left];
+			w[left].stat_fd = -1;
+			pfds[left].fd = -1;
+		}
+
+		if (!left) {
+			ret = 0;
+			goto out;
+		}
+
+		if (polls++ < SPIN_POLLS) {
+			sched_yield();
+			continue;
 		}
 
-		if (fscanf(f, "%*i %*s %c", &cur_state) != 1) {
-			fclose(f);
-			fprintf(stderr, "Failed to read '%s': %s\n",
-			        proc_path, strerror(errno));
-			return 1;
+		ts.tv_sec = 0;
+		ts.tv_nsec = sleep_ns;
+		sleep_ns *= 2;
+		if (sleep_ns > MAX_SLEEP_NS)
+			sleep_ns = MAX_SLEEP_NS;
+
+		/* Entries without pidfd are -1 and ppoll() just skips them */
+		if (ppoll(pfds, left, &ts, NULL) > 0) {
+			for (i = 0; i < left; i++) {
+				if (!pfds[i].revents)
+					continue;
+
+				/* It may have exited into the state we wait for */
+				if (read_state(w[i].stat_fd, &cur_state) == 0 &&
+				    cur_state == state)
+					continue;
+
+				err = ESRCH;
+				*fail_op = "wait";
+				*fail_pid = w[i].pid;
+				goto out;
+			}
 		}
-		fclose(f);
+	}
+
+out:
+	for (i = 0; i < cnt; i++) {
+		if (w[i].stat_fd != -1)
+			close(w[i].stat_fd);
+		if (pfds[i].fd != -1)
+			close(pfds[i].fd);
+	}
+	free(w);
+	free(pfds);
+	errno = err;
+	return ret;
+}
+
+static void brk_wait_failed(const char *file, const int lineno,
+			    void (*cleanup_fn)(void), pid_t pid,
+			    const char *op, const char state)
+{
+	if (errno == ESRCH) {
+		tst_brkm(TBROK, cleanup_fn,
+			 "Process %i exited while waiting for state '%c' at %s:%d",
+			 pid, state, file, lineno);
+	}
+
+	tst_brkm(TBROK | TERRNO, cleanup_fn,
+		 "Failed to %s /proc/%i/stat at %s:%d",
+		 op, pid, file, lineno);
+}
+
+void tst_process_state_wait(const char *file, const int lineno,
+                            void (*cleanup_fn)(void),
+                            pid_t pid, const char state)
+{
+	const char *fail_op;
+	pid_t fail_pid;
+
+	if (wait_state(&pid, 1, state, &fail_pid, &fail_op)) {
+		brk_wait_failed(file, lineno, cleanup_fn, fail_pid, fail_op,
+				state);
+	}
+}
+
+void tst_process_state_wait_all(const char *file, const int lineno,
+                                void (*cleanup_fn)(void),
+                                const pid_t *pids, unsigned int cnt,
+                                const char state)
+{
+	const char *fail_op;
+	pid_t fail_pid;
 
-		if (state == cur_state)
-			return 0;
+	if (wait_state(pids, cnt, state, &fail_pid, &fail_op)) {
+		brk_wait_failed(file, lineno, cleanup_fn, fail_pid, fail_op,
+				state);
+	}
+}
 
-		usleep(10000);
+int tst_process_state_wait2(pid_t pid, const char state)
+{
+	const char *fail_op;
+	pid_t fail_pid;
+
+	if (wait_state(&pid, 1, state, &fail_pid, &fail_op)) {
+		fprintf(stderr, "Failed to %s '/proc/%i/stat': %s\n",
+		        fail_op, fail_pid, strerror(errno));
+		return 1;
 	}
+
+	return 0;
 }
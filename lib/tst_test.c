@@ -24,11 +24,13 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/time.h>
+#include <time.h>
 
 #define TST_NO_DEFAULT_MAIN
 #include "tst_test.h"
 #include "tst_device.h"
 #include "lapi/futex.h"
+#include "tst_hist.h"
 
 #include "old_resource.h"
 #include "old_device.h"
@@ -46,6 +48,12 @@ struct results {
 	int skipped;
 	int failed;
 	int warnings;
+	/* The slot arena starts on the page after this one */
+	int slots_used;
+	unsigned int slots;
+	unsigned int slot_size;
+	/* Set when the slots are split into per worker ranges */
+	int batch;
 };
 
 static struct results *results;
@@ -63,12 +71,82 @@ char *const tst_ipc_envp[] = {ipc_path, NULL};
 
 static char shm_path[1024];
 
+/*
+ * Batch mode (-B) runs the test functions in a loop in a number of worker
+ * processes pinned to CPUs. Each worker counts results, failures and the
+ * latency of each test function call in its own slot instead of printing
+ * them, the test process reports the aggregate at the end.
+ */
+#define BATCH_HIST_BITS		4
+#define BATCH_BUCKETS		TST_HIST_BUCKETS(BATCH_HIST_BITS)
+#define BATCH_MAX_FAILS		8
+
+struct batch_fail {
+	const char *file;
+	int lineno;
+	int ttype;
+	unsigned long long count;
+	char msg[256];
+};
+
+struct batch_stats {
+	struct results results;
+	int cpu;
+	unsigned long long ops;
+	unsigned long long lost_fails;
+	unsigned long long start_ns;
+	unsigned long long end_ns;
+	unsigned long long op_start_ns;
+	unsigned long long max_ns;
+	unsigned long long last_heartbeat_ns;
+	unsigned long long hist[BATCH_BUCKETS];
+	struct batch_fail fails[BATCH_MAX_FAILS];
+	/* Header of this worker's range of shared memory slots */
+	struct results slot_hdr;
+	struct tst_slot_totals slot_totals;
+} __attribute__((aligned(64)));
+
+static int batch_workers = -1;
+static struct batch_stats *batch_self;
+
 static void do_cleanup(void);
 static void do_exit(int ret) __attribute__ ((noreturn));
 
+static size_t ipc_size;
+static struct results *slots_hdr;
+static char *slot_arena;
+static unsigned int slot_first;
+static struct tst_slot *own_slot;
+static pid_t own_slot_pid;
+static struct tst_slot_totals slot_totals;
+static struct tst_slot_totals *totals = &slot_totals;
+
+/*
+ * The first page holds the results and the checkpoint futexes, the slots
+ * follow it. Each slot is a struct tst_slot followed by the test data,
+ * rounded up to a cache line so that children don't share them. In batch
+ * mode each worker gets its own range of shm_slots slots.
+ */
+static void setup_slots(struct results *hdr)
+{
+	size_t page = getpagesize();
+
+	hdr->slots = tst_test->shm_slots;
+	if (batch_workers > 0)
+		hdr->slots *= batch_workers;
+	hdr->slot_size = (sizeof(struct tst_slot) + tst_test->shm_slot_size + 63)
+	                 & ~(size_t)63;
+
+	ipc_size = page + hdr->slots * hdr->slot_size;
+	ipc_size = (ipc_size + page - 1) & ~(page - 1);
+}
+
 static void setup_ipc(void)
 {
 	size_t size = getpagesize();
+	struct results hdr;
+
+	setup_slots(&hdr);
 
 	//TODO: Fallback to tst_tmpdir() if /dev/shm does not exits?
 	snprintf(shm_path, sizeof(shm_path), "/dev/shm/ltp_%s_%d",
@@ -78,9 +156,15 @@ static void setup_ipc(void)
 	if (ipc_fd < 0)
 		tst_brk(TBROK | TERRNO, "open(%s)", shm_path);
 
-	SAFE_FTRUNCATE(ipc_fd, size);
+	SAFE_FTRUNCATE(ipc_fd, ipc_size);
 
-	results = SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, ipc_fd, 0);
+	results = SAFE_MMAP(NULL, ipc_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	                    ipc_fd, 0);
+	results->slots = hdr.slots;
+	results->slot_size = hdr.slot_size;
+	results->batch = batch_workers > 0;
+	slots_hdr = results;
+	slot_arena = (char*)results + size;
 
 	/* Checkpoints needs to be accessible from processes started by exec() */
 	if (tst_test->needs_checkpoints)
@@ -98,22 +182,21 @@ static void setup_ipc(void)
 
 static void cleanup_ipc(void)
 {
-	size_t size = getpagesize();
-
 	if (ipc_fd > 0 && close(ipc_fd))
 		tst_res(TWARN | TERRNO, "close(ipc_fd) failed");
 
 	if (!access(shm_path, F_OK) && unlink(shm_path))
 		tst_res(TWARN | TERRNO, "unlink(%s) failed", shm_path);
 
-	msync((void*)results, size, MS_SYNC);
-	munmap((void*)results, size);
+	msync((void*)results, ipc_size, MS_SYNC);
+	munmap((void*)results, ipc_size);
 }
 
 void tst_reinit(void)
 {
 	const char *path = getenv("LTP_IPC_PATH");
 	size_t size = getpagesize();
+	struct results *hdr;
 	int fd;
 	void *ptr;
 
@@ -126,31 +209,163 @@ void tst_reinit(void)
 	fd = SAFE_OPEN(path, O_RDWR);
 
 	ptr = SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	/* Map the slot arena as well if the test has one */
+	hdr = ptr;
+	if (hdr->slots) {
+		ipc_size = size + hdr->slots * hdr->slot_size;
+		ipc_size = (ipc_size + size - 1) & ~(size - 1);
+		SAFE_MUNMAP(ptr, size);
+		ptr = SAFE_MMAP(NULL, ipc_size, PROT_READ | PROT_WRITE,
+		                MAP_SHARED, fd, 0);
+		slots_hdr = ptr;
+		slot_arena = (char*)ptr + size;
+	}
+
 	tst_futexes = (char*)ptr + sizeof(struct results);
 	tst_max_futexes = (size - sizeof(struct results))/sizeof(futex_t);
 
 	SAFE_CLOSE(fd);
 }
 
+static unsigned long long get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct tst_slot *slot_at(unsigned int i)
+{
+	return (void*)(slot_arena +
+	               (size_t)(slot_first + i) * slots_hdr->slot_size);
+}
+
+struct tst_slot *tst_slot(void)
+{
+	pid_t pid = getpid();
+	int i;
+
+	/* A forked child inherits the parent's pointer but needs its own */
+	if (own_slot && own_slot_pid == pid)
+		return own_slot;
+
+	if (!slots_hdr || !slots_hdr->slots)
+		tst_brk(TBROK, "No shared memory slots, set test.shm_slots");
+
+	/* Each worker has its own range, see batch_run() */
+	if (slots_hdr->batch) {
+		tst_brk(TCONF, "Shared memory slots are available only to "
+		        "batch workers and their forked children");
+	}
+
+	i = tst_atomic_inc(&slots_hdr->slots_used) - 1;
+	if (i >= (int)slots_hdr->slots) {
+		tst_brk(TBROK, "All %u shared memory slots are in use",
+		        slots_hdr->slots);
+	}
+
+	own_slot = slot_at(i);
+	own_slot_pid = pid;
+	own_slot->pid = pid;
+	own_slot->start_ns = own_slot->heartbeat_ns = get_time_ns();
+
+	return own_slot;
+}
+
+struct tst_slot *tst_slot_peek(unsigned int i)
+{
+	if (!slots_hdr || i >= slots_hdr->slots ||
+	    i >= (unsigned int)slots_hdr->slots_used)
+		return NULL;
+
+	return slot_at(i);
+}
+
+void tst_slot_heartbeat(struct tst_slot *slot)
+{
+	slot->heartbeat_ns = get_time_ns();
+}
+
+const struct tst_slot_totals *tst_slot_totals(void)
+{
+	return totals;
+}
+
+/*
+ * Called once the children are reaped, adds their slots up, reports the
+ * throughput and frees the slots for the next run.
+ */
+static void aggregate_slots(void)
+{
+	struct tst_slot *slot;
+	unsigned long long counter = 0, start = ~0ULL, now;
+	unsigned int i, used;
+	double secs;
+
+	if (!slots_hdr || !slots_hdr->slots_used)
+		return;
+
+	used = slots_hdr->slots_used;
+	if (used > slots_hdr->slots)
+		used = slots_hdr->slots;
+
+	now = get_time_ns();
+
+	for (i = 0; i < used; i++) {
+		slot = slot_at(i);
+
+		counter += slot->counter;
+		totals->samples += slot->samples;
+		totals->sample_sum += slot->sample_sum;
+		if (slot->sample_max > totals->sample_max)
+			totals->sample_max = slot->sample_max;
+		if (slot->start_ns < start)
+			start = slot->start_ns;
+
+		memset(slot, 0, slots_hdr->slot_size);
+	}
+
+	/* The slot claimed by this process was freed as well */
+	slots_hdr->slots_used = 0;
+	own_slot = NULL;
+
+	secs = now > start ? (now - start) / 1000000000.0 : 0;
+	totals->slots += used;
+	totals->counter += counter;
+	totals->secs += secs;
+
+	if (!counter)
+		return;
+
+	tst_res(TINFO, "%u slots: %llu ops in %.3fms, %.0f ops/s",
+	        used, counter, secs * 1000, secs > 0 ? counter / secs : 0);
+}
+
 static void update_results(const char *file, unsigned int lineno, int ttype)
 {
-	if (!results) {
+	/* Children forked by a worker count into the worker's slot too */
+	struct results *res = batch_self ? &batch_self->results : results;
+
+	if (!res) {
 		tst_brk(TBROK,
 		        "%s: %d: Results IPC not initialized!", file, lineno);
 	}
 
 	switch (ttype) {
 	case TCONF:
-		tst_atomic_inc(&results->skipped);
+		tst_atomic_inc(&res->skipped);
 	break;
 	case TPASS:
-		tst_atomic_inc(&results->passed);
+		tst_atomic_inc(&res->passed);
 	break;
 	case TWARN:
-		tst_atomic_inc(&results->warnings);
+		tst_atomic_inc(&res->warnings);
 	break;
 	case TFAIL:
-		tst_atomic_inc(&results->failed);
+		tst_atomic_inc(&res->failed);
 	break;
 	}
 }
@@ -211,9 +426,66 @@ static void print_result(const char *file, const int lineno, int ttype,
 	fputs(buf, stderr);
 }
 
+/*
+ * Failures in batch mode are counted per source location, only the message
+ * of the first one is kept.
+ */
+static void batch_record(const char *file, const int lineno, int ttype,
+                         const char *fmt, va_list va)
+{
+	struct batch_fail *fail;
+	const char *str_errno = NULL;
+	unsigned int i;
+	int len;
+
+	if (ttype & TERRNO)
+		str_errno = tst_strerrno(errno);
+
+	if (ttype & TTERRNO)
+		str_errno = tst_strerrno(TEST_ERRNO);
+
+	ttype = TTYPE_RESULT(ttype);
+
+	if (ttype == TPASS || ttype == TINFO)
+		return;
+
+	for (i = 0; i < BATCH_MAX_FAILS; i++) {
+		fail = &batch_self->fails[i];
+
+		if (!fail->count) {
+			fail->file = file;
+			fail->lineno = lineno;
+			fail->ttype = ttype;
+			len = vsnprintf(fail->msg, sizeof(fail->msg), fmt, va);
+			if (str_errno && len >= 0 && len < (int)sizeof(fail->msg)) {
+				snprintf(fail->msg + len, sizeof(fail->msg) - len,
+				         ": %s", str_errno);
+			}
+		}
+
+		if (fail->file == file && fail->lineno == lineno &&
+		    fail->ttype == ttype) {
+			fail->count++;
+			return;
+		}
+	}
+
+	batch_self->lost_fails++;
+}
+
 void tst_vres_(const char *file, const int lineno, int ttype,
                const char *fmt, va_list va)
 {
+	/*
+	 * Only the worker itself aggregates failures, children it forked
+	 * print them as usual rather than racing on the table.
+	 */
+	if (batch_self && getpid() == main_pid) {
+		batch_record(file, lineno, ttype, fmt, va);
+		update_results(file, lineno, TTYPE_RESULT(ttype));
+		return;
+	}
+
 	print_result(file, lineno, ttype, fmt, va);
 
 	update_results(file, lineno, TTYPE_RESULT(ttype));
@@ -233,7 +505,8 @@ void tst_vbrk_(const char *file, const int lineno, int ttype,
 {
 	print_result(file, lineno, ttype, fmt, va);
 
-	if (getpid() == main_pid)
+	/* Batch workers leave the cleanup to the test process */
+	if (getpid() == main_pid && !batch_self)
 		do_test_cleanup();
 
 	if (getpid() == lib_pid)
@@ -307,6 +580,8 @@ static void reap_children(void)
 
 		tst_brk(TBROK | TERRNO, "wait() failed");
 	}
+
+	aggregate_slots();
 }
 
 
@@ -333,6 +608,7 @@ static struct option {
 	{"h",  "-h      Prints this help"},
 	{"i:", "-i n    Execute test n times"},
 	{"I:", "-I x    Execute test for n seconds"},
+	{"B:", "-B n    Batch mode, run the test in n pinned workers (0 = one per CPU)"},
 	{"C:", "-C ARG  Run child process with ARG arguments (used internally)"},
 };
 
@@ -431,6 +707,11 @@ static void parse_opts(int argc, char *argv[])
 		case 'I':
 			duration = atof(optarg);
 		break;
+		case 'B':
+			batch_workers = atoi(optarg);
+			if (batch_workers < 0)
+				tst_brk(TBROK, "Invalid number of workers '%s'", optarg);
+		break;
 		case 'C':
 #ifdef UCLINUX
 			child_args = optarg;
@@ -535,6 +816,13 @@ static void do_setup(int argc, char *argv[])
 
 	parse_opts(argc, argv);
 
+	/* The slot arena is sized by the number of workers */
+	if (!batch_workers) {
+		batch_workers = tst_cpu_topology()->nallowed;
+		if (!batch_workers)
+			batch_workers = 1;
+	}
+
 	setup_ipc();
 
 	if (needs_tmpdir()) {
@@ -581,14 +869,51 @@ static void do_cleanup(void)
 	cleanup_ipc();
 }
 
+static void batch_op_start(void)
+{
+	if (batch_self)
+		batch_self->op_start_ns = get_time_ns();
+}
+
+static void batch_op_end(void)
+{
+	unsigned long long ns;
+
+	if (!batch_self)
+		return;
+
+	ns = get_time_ns();
+
+	/* Keep the heartbeat but don't signal the library process per op */
+	if (ns - batch_self->last_heartbeat_ns > 1000000000ULL) {
+		kill(lib_pid, SIGUSR1);
+		batch_self->last_heartbeat_ns = ns;
+	}
+
+	batch_self->end_ns = ns;
+	ns -= batch_self->op_start_ns;
+
+	batch_self->ops++;
+	batch_self->hist[tst_hist_bucket(BATCH_HIST_BITS, ns)]++;
+	if (ns > batch_self->max_ns)
+		batch_self->max_ns = ns;
+}
+
+static struct results *cur_results(void)
+{
+	return batch_self ? &batch_self->results : results;
+}
+
 static void run_tests(void)
 {
 	unsigned int i;
 	struct results saved_results;
 
 	if (!tst_test->test) {
-		saved_results = *results;
+		saved_results = *cur_results();
+		batch_op_start();
 		tst_test->test_all();
+		batch_op_end();
 
 		if (getpid() != main_pid) {
 			exit(0);
@@ -596,14 +921,16 @@ static void run_tests(void)
 
 		reap_children();
 
-		if (results_equal(&saved_results, results))
+		if (results_equal(&saved_results, cur_results()))
 			tst_brk(TBROK, "Test haven't reported results!");
 		return;
 	}
 
 	for (i = 0; i < tst_test->tcnt; i++) {
-		saved_results = *results;
+		saved_results = *cur_results();
+		batch_op_start();
 		tst_test->test(i);
+		batch_op_end();
 
 		if (getpid() != main_pid) {
 			exit(0);
@@ -611,7 +938,7 @@ static void run_tests(void)
 
 		reap_children();
 
-		if (results_equal(&saved_results, results))
+		if (results_equal(&saved_results, cur_results()))
 			tst_brk(TBROK, "Test %i haven't reported results!", i);
 	}
 }
@@ -625,14 +952,12 @@ static unsigned long long get_time_ms(void)
 	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
 }
 
-static void testrun(void)
+static void run_loop(void)
 {
 	unsigned int i = 0;
 	unsigned long long stop_time = 0;
 	int cont = 1;
 
-	do_test_setup();
-
 	if (duration > 0)
 		stop_time = get_time_ms() + (unsigned long long)(duration * 1000);
 
@@ -652,9 +977,246 @@ static void testrun(void)
 
 		run_tests();
 
-		kill(getppid(), SIGUSR1);
+		if (!batch_self)
+			kill(getppid(), SIGUSR1);
+	}
+}
+
+static unsigned long long batch_percentile(struct batch_stats *stats,
+                                           double pct)
+{
+	return tst_hist_percentile(BATCH_HIST_BITS, stats->hist, stats->ops,
+	                           stats->max_ns, pct);
+}
+
+static void batch_print(const char *file, const int lineno, int ttype,
+                        const char *fmt, ...)
+{
+	va_list va;
+
+	va_start(va, fmt);
+	print_result(file, lineno, ttype, fmt, va);
+	va_end(va);
+}
+
+/* Adds up the slot totals of the workers, each aggregated per iteration */
+static void batch_report_slots(struct batch_stats *stats, unsigned int nworkers)
+{
+	struct tst_slot_totals *wt;
+	unsigned long long counter = 0;
+	double rate = 0;
+	unsigned int w;
+
+	for (w = 0; w < nworkers; w++) {
+		wt = &stats[w].slot_totals;
+
+		counter += wt->counter;
+		if (wt->secs > 0)
+			rate += wt->counter / wt->secs;
+
+		slot_totals.slots += wt->slots;
+		slot_totals.counter += wt->counter;
+		slot_totals.samples += wt->samples;
+		slot_totals.sample_sum += wt->sample_sum;
+		if (wt->sample_max > slot_totals.sample_max)
+			slot_totals.sample_max = wt->sample_max;
+		if (wt->secs > slot_totals.secs)
+			slot_totals.secs = wt->secs;
+	}
+
+	if (!counter)
+		return;
+
+	tst_res(TINFO, "Slots: %u workers, %llu ops, %.0f ops/s",
+	        nworkers, counter, rate);
+}
+
+static void batch_report(struct batch_stats *stats, unsigned int nworkers)
+{
+	struct batch_stats *total = &stats[nworkers];
+	struct batch_fail *fail, *tfail;
+	unsigned long long start = ~0ULL, end = 0;
+	double secs;
+	unsigned int w, i, j;
+
+	memset(total, 0, sizeof(*total));
+
+	for (w = 0; w < nworkers; w++) {
+		struct batch_stats *ws = &stats[w];
+
+		secs = (ws->end_ns - ws->start_ns) / 1000000000.0;
+		tst_res(TINFO, "Worker %u cpu %i: %llu ops, %.0f ops/s, "
+		        "latency p50 %.3fus p99 %.3fus max %.3fus",
+		        w, ws->cpu, ws->ops, secs > 0 ? ws->ops / secs : 0,
+		        batch_percentile(ws, 50) / 1000.0,
+		        batch_percentile(ws, 99) / 1000.0,
+		        ws->max_ns / 1000.0);
+
+		if (ws->start_ns < start)
+			start = ws->start_ns;
+		if (ws->end_ns > end)
+			end = ws->end_ns;
+
+		total->ops += ws->ops;
+		total->lost_fails += ws->lost_fails;
+		if (ws->max_ns > total->max_ns)
+			total->max_ns = ws->max_ns;
+		tst_hist_merge(BATCH_HIST_BITS, total->hist, ws->hist);
+
+		results->passed += ws->results.passed;
+		results->failed += ws->results.failed;
+		results->skipped += ws->results.skipped;
+		results->warnings += ws->results.warnings;
+
+		for (i = 0; i < BATCH_MAX_FAILS && ws->fails[i].count; i++) {
+			fail = &ws->fails[i];
+			for (j = 0; j < BATCH_MAX_FAILS; j++) {
+				tfail = &total->fails[j];
+				if (!tfail->count) {
+					*tfail = *fail;
+					break;
+				}
+				if (tfail->file == fail->file &&
+				    tfail->lineno == fail->lineno &&
+				    tfail->ttype == fail->ttype) {
+					tfail->count += fail->count;
+					break;
+				}
+			}
+			if (j == BATCH_MAX_FAILS)
+				total->lost_fails += fail->count;
+		}
+	}
+
+	secs = end > start ? (end - start) / 1000000000.0 : 0;
+	tst_res(TINFO, "Batch: %u workers, %llu ops in %.2fs, %.0f ops/s, "
+	        "latency p50 %.3fus p99 %.3fus max %.3fus",
+	        nworkers, total->ops, secs, secs > 0 ? total->ops / secs : 0,
+	        batch_percentile(total, 50) / 1000.0,
+	        batch_percentile(total, 99) / 1000.0,
+	        total->max_ns / 1000.0);
+
+	for (i = 0; i < BATCH_MAX_FAILS && total->fails[i].count; i++) {
+		fail = &total->fails[i];
+		batch_print(fail->file, fail->lineno, fail->ttype,
+		            "%llu times, first: %s", fail->count, fail->msg);
+	}
+
+	if (total->lost_fails) {
+		tst_res(TWARN, "%llu more failures at other locations",
+		        total->lost_fails);
 	}
 
+	batch_report_slots(stats, nworkers);
+}
+
+/*
+ * Like check_child_status() but returns TPASS, TCONF or TBROK instead of
+ * exiting, so that the remaining workers can be waited for.
+ */
+static int batch_worker_status(unsigned int w, pid_t pid, int status)
+{
+	if (WIFSIGNALED(status)) {
+		tst_res(TINFO, "Worker %u (%i) killed by signal %s",
+		        w, pid, tst_strsig(WTERMSIG(status)));
+		return TBROK;
+	}
+
+	if (!WIFEXITED(status)) {
+		tst_res(TINFO, "Worker %u (%i) exitted abnormaly", w, pid);
+		return TBROK;
+	}
+
+	switch (WEXITSTATUS(status)) {
+	case TPASS:
+	case TBROK:
+	case TCONF:
+		return WEXITSTATUS(status);
+	default:
+		tst_res(TINFO, "Invalid worker %u (%i) exit value %i",
+		        w, pid, WEXITSTATUS(status));
+		return TBROK;
+	}
+}
+
+static void batch_run(void)
+{
+	const struct tst_cpu_topology *topo = tst_cpu_topology();
+	struct batch_stats *stats;
+	unsigned int w, nworkers = batch_workers, failed = 0;
+	int *cpus, ncpus, status, ret, worst = TPASS;
+	pid_t pid, *pids;
+	size_t size;
+
+	cpus = SAFE_MALLOC(topo->ncpus * sizeof(int));
+	pids = SAFE_MALLOC(nworkers * sizeof(pid_t));
+	ncpus = tst_cpu_place(TST_CPU_SPREAD, cpus, topo->ncpus);
+
+	/* One more slot for the totals */
+	size = (nworkers + 1) * sizeof(*stats);
+	stats = SAFE_MMAP(NULL, size, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+	tst_res(TINFO, "Running in %u workers", nworkers);
+
+	for (w = 0; w < nworkers; w++) {
+		stats[w].cpu = ncpus ? cpus[w % ncpus] : -1;
+
+		fflush(stdout);
+		pid = fork();
+		if (pid < 0)
+			tst_brk(TBROK | TERRNO, "fork()");
+
+		pids[w] = pid;
+
+		if (!pid) {
+			batch_self = &stats[w];
+			main_pid = getpid();
+			batch_self->slot_hdr.slots = tst_test->shm_slots;
+			batch_self->slot_hdr.slot_size = slots_hdr->slot_size;
+			slots_hdr = &batch_self->slot_hdr;
+			slot_first = w * tst_test->shm_slots;
+			totals = &batch_self->slot_totals;
+			if (batch_self->cpu != -1 && tst_cpu_bind(batch_self->cpu))
+				batch_self->cpu = -1;
+			batch_self->start_ns = get_time_ns();
+			batch_self->end_ns = batch_self->start_ns;
+			batch_self->last_heartbeat_ns = batch_self->start_ns;
+			run_loop();
+			exit(0);
+		}
+	}
+
+	/* Wait for all workers so that the report covers them all */
+	for (w = 0; w < nworkers; w++) {
+		SAFE_WAITPID(pids[w], &status, 0);
+		ret = batch_worker_status(w, pids[w], status);
+		if (ret != TPASS) {
+			failed++;
+			if (worst != TBROK)
+				worst = ret;
+		}
+	}
+
+	batch_report(stats, nworkers);
+
+	SAFE_MUNMAP(stats, size);
+	free(pids);
+	free(cpus);
+
+	if (failed)
+		tst_brk(worst, "Reported by %u of %u workers", failed, nworkers);
+}
+
+static void testrun(void)
+{
+	do_test_setup();
+
+	if (batch_workers >= 0)
+		batch_run();
+	else
+		run_loop();
+
 	do_test_cleanup();
 	exit(0);
 }
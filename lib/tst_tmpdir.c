@@ -60,8 +60,10 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <libgen.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -188,9 +190,71 @@ void tst_tmpdir(void)
 	}
 }
 
+/*
+ * Moves TESTDIR into a trash directory next to it and removes it from a
+ * detached grandchild, so that the test does not wait for the removal.
+ * The grandchild calls setsid() so that it survives the test runner
+ * killing the test process group. Returns non-zero if TESTDIR could not
+ * be moved away, the caller removes it in that case.
+ */
+static int defer_rmdir(int nworkers)
+{
+	char parent[PATH_MAX], trash[PATH_MAX], dst[PATH_MAX];
+	char *base;
+	pid_t pid;
+	int fd, status;
+
+	strncpy(parent, TESTDIR, sizeof(parent) - 1);
+	parent[sizeof(parent) - 1] = '\0';
+	base = strrchr(TESTDIR, '/');
+	base = base ? base + 1 : TESTDIR;
+
+	snprintf(trash, sizeof(trash), "%s/ltp-trash", dirname(parent));
+	if (snprintf(dst, sizeof(dst), "%s/%s", trash, base) >= (int)sizeof(dst))
+		return 1;
+
+	if (mkdir(trash, DIR_MODE) == -1 && errno != EEXIST)
+		return 1;
+
+	if (rename(TESTDIR, dst) == -1)
+		return 1;
+
+	pid = fork();
+	if (pid == -1) {
+		/* TESTDIR is gone already, clean up in place */
+		rmobj_parallel(dst, nworkers, NULL);
+		return 0;
+	}
+
+	if (pid == 0) {
+		setsid();
+		if (fork() != 0)
+			_exit(0);
+
+		/* Don't hold the test runner's output pipes open */
+		fd = open("/dev/null", O_RDWR);
+		if (fd != -1) {
+			dup2(fd, STDIN_FILENO);
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			if (fd > STDERR_FILENO)
+				close(fd);
+		}
+		if (chdir("/") == -1)
+			_exit(1);
+
+		rmobj_parallel(dst, nworkers, NULL);
+		_exit(0);
+	}
+
+	waitpid(pid, &status, 0);
+	return 0;
+}
+
 void tst_rmdir(void)
 {
-	char *errmsg;
+	char *errmsg, *env;
+	int nworkers = 1;
 
 	/*
 	 * Check that TESTDIR is not NULL.
@@ -211,10 +275,17 @@ void tst_rmdir(void)
 		munmap((void *)tst_futexes, getpagesize());
 	}
 
+	env = getenv("LTP_RMDIR_WORKERS");
+	if (env)
+		nworkers = atoi(env);
+
+	if (getenv("LTP_RMDIR_DEFER") && !defer_rmdir(nworkers))
+		return;
+
 	/*
 	 * Attempt to remove the "TESTDIR" directory, using rmobj().
 	 */
-	if (rmobj(TESTDIR, &errmsg) == -1) {
+	if (rmobj_parallel(TESTDIR, nworkers, &errmsg) == -1) {
 		tst_resm(TWARN, "%s: rmobj(%s) failed: %s",
 			 __func__, TESTDIR, errmsg);
 	}
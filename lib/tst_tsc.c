@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2026 Linux Test Project
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tst_tsc.h"
+
+/* Number of calibration rounds and the length of each of them */
+#define CAL_ROUNDS 3
+#define CAL_NS 10000000
+/* Max frequency difference between the calibration rounds */
+#define CAL_MAX_PPM 1000
+
+#define CLOCKSOURCE "/sys/devices/system/clocksource/clocksource0/available_clocksource"
+
+struct tst_tsc_clock tst_tsc_clock = {
+	.use_tsc = 0,
+	.mult = 1,
+	.shift = 0,
+	.offset = 0,
+};
+
+static uint64_t mono_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int file_has_word(const char *path, const char *prefix,
+                         const char *word)
+{
+	char buf[4096], *tok, *save;
+	FILE *f;
+	int ret = 0;
+
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+
+	while (!ret && fgets(buf, sizeof(buf), f)) {
+		if (strncmp(buf, prefix, strlen(prefix)))
+			continue;
+
+		for (tok = strtok_r(buf, " \t\n", &save); tok;
+		     tok = strtok_r(NULL, " \t\n", &save)) {
+			if (!strcmp(tok, word)) {
+				ret = 1;
+				break;
+			}
+		}
+	}
+
+	fclose(f);
+	return ret;
+}
+
+/*
+ * The x86 TSC is usable only if it ticks with constant rate regardless of
+ * frequency scaling and deep C states and if the kernel did not find it
+ * unstable (unsynchronized between CPUs, etc.), in which case it's removed
+ * from the list of available clocksources. The counters on the other
+ * supported architectures are invariant by definition.
+ */
+static int tsc_is_invariant(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return file_has_word("/proc/cpuinfo", "flags", "constant_tsc") &&
+	       file_has_word("/proc/cpuinfo", "flags", "nonstop_tsc") &&
+	       file_has_word(CLOCKSOURCE, "", "tsc");
+#else
+	return TST_HAS_TSC;
+#endif
+}
+
+/*
+ * Takes a pair of timestamps, retries a few times to pick the one where
+ * the clock_gettime() call was the least disturbed.
+ */
+static void sample(uint64_t *ticks, uint64_t *ns)
+{
+	uint64_t t0, t1, now, best = UINT64_MAX;
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		t0 = tst_tsc_rdtsc();
+		now = mono_ns();
+		t1 = tst_tsc_rdtsc();
+
+		if (t1 - t0 < best) {
+			best = t1 - t0;
+			*ticks = t0 + (t1 - t0) / 2;
+			*ns = now;
+		}
+	}
+}
+
+static int calibrate(double *ticks_per_ns, uint64_t *ticks, uint64_t *ns)
+{
+	struct timespec wait = {0, CAL_NS};
+	uint64_t t[CAL_ROUNDS + 1], n[CAL_ROUNDS + 1];
+	double freq, min = 0, max = 0;
+	int i;
+
+	sample(&t[0], &n[0]);
+
+	for (i = 1; i <= CAL_ROUNDS; i++) {
+		nanosleep(&wait, NULL);
+		sample(&t[i], &n[i]);
+
+		if (t[i] <= t[i - 1] || n[i] <= n[i - 1])
+			return 1;
+
+		freq = (double)(t[i] - t[i - 1]) / (n[i] - n[i - 1]);
+		if (i == 1 || freq < min)
+			min = freq;
+		if (i == 1 || freq > max)
+			max = freq;
+	}
+
+	if ((max - min) / min * 1000000 > CAL_MAX_PPM)
+		return 1;
+
+	/* The rounds only check stability, the rate is taken over all of them */
+	*ticks_per_ns = (double)(t[CAL_ROUNDS] - t[0]) / (n[CAL_ROUNDS] - n[0]);
+	*ticks = t[CAL_ROUNDS];
+	*ns = n[CAL_ROUNDS];
+	return 0;
+}
+
+static void __attribute__((constructor)) tst_tsc_init(void)
+{
+	double ticks_per_ns, mult;
+	uint64_t ticks, ns;
+	uint32_t shift = 32;
+
+	if (!tsc_is_invariant() || calibrate(&ticks_per_ns, &ticks, &ns))
+		return;
+
+	/* Largest shift that keeps the multiplier in 32 bits */
+	mult = (double)((uint64_t)1 << shift) / ticks_per_ns;
+	while (shift > 0 && mult >= 4294967295.0)
+		mult = (double)((uint64_t)1 << --shift) / ticks_per_ns;
+
+	if (mult < 1 || mult >= 4294967295.0)
+		return;
+
+	tst_tsc_clock.mult = mult + 0.5;
+	tst_tsc_clock.shift = shift;
+	tst_tsc_clock.offset = ns - tst_tsc_to_ns(ticks);
+	tst_tsc_clock.use_tsc = 1;
+}
+
+const char *tst_tsc_source(void)
+{
+	return tst_tsc_clock.use_tsc ? "tsc" : "CLOCK_MONOTONIC";
+}
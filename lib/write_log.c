@@ -51,6 +51,10 @@
  *
  * There is also a function to scan a write logfile in reverse order.
  *
+ * wlog_set_batch() turns on group commits: appended records are
+ * collected in a per-process buffer and written with a single write(2)
+ * every nrecs records, at wlog_flush(), wlog_close(), a scan, or exit().
+ *
  * NOTE:	For target file analysis based on a write logfile, the
  * 		assumption is made that the file being written to is
  * 		locked from simultaneous access, so that the order of
@@ -64,6 +68,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -86,14 +92,21 @@
 /*#define PATH_MAX pathconf("/", _PC_PATH_MAX)*/
 #endif
 
-char Wlog_Error_String[256];
+/* room for a full w_file path plus the message */
+char Wlog_Error_String[256 + 1024];
+
+/* batched wlog_files, flushed by wlog_atexit() */
+static struct wlog_file *Wlog_Batched;
 
 #if __STDC__
 static int wlog_rec_pack(struct wlog_rec *wrec, char *buf, int flag);
 static int wlog_rec_unpack(struct wlog_rec *wrec, char *buf);
+static int wlog_overlay(struct wlog_file *wfile, char *wbuf, int reclen,
+			long offset);
 #else
 static int wlog_rec_pack();
 static int wlog_rec_unpack();
+static int wlog_overlay();
 #endif
 
 /*
@@ -114,6 +127,9 @@ int wlog_open(struct wlog_file *wfile, int trunc, int mode)
 {
 	int omask, oflags;
 
+	memset(&wfile->w_batch, 0,
+	       sizeof(*wfile) - offsetof(struct wlog_file, w_batch));
+
 	if (trunc)
 		trunc = O_TRUNC;
 
@@ -158,8 +174,134 @@ int wlog_open(struct wlog_file *wfile, int trunc, int mode)
 
 int wlog_close(struct wlog_file *wfile)
 {
+	struct wlog_file **wp;
+	int rval;
+
+	rval = wlog_flush(wfile);
+
+	for (wp = &Wlog_Batched; *wp != NULL; wp = &(*wp)->w_nextfile) {
+		if (*wp == wfile) {
+			*wp = wfile->w_nextfile;
+			break;
+		}
+	}
+
+	free(wfile->w_buf);
+	free(wfile->w_ext);
+	memset(&wfile->w_batch, 0,
+	       sizeof(*wfile) - offsetof(struct wlog_file, w_batch));
+
 	close(wfile->w_afd);
 	close(wfile->w_rfd);
+	return rval;
+}
+
+static void wlog_atexit(void)
+{
+	struct wlog_file *wfile;
+
+	for (wfile = Wlog_Batched; wfile != NULL; wfile = wfile->w_nextfile)
+		wlog_flush(wfile);
+}
+
+/*
+ * Collect appended records in a buffer and write them nrecs at a time
+ * with a single write(2) instead of one write per record.  Pending records
+ * are also written by wlog_flush(), wlog_close(), wlog_scan_backward()
+ * and at exit(), but are lost if the process is killed.  Must be called
+ * right after wlog_open(), and a process that forks must wlog_flush()
+ * first so the child does not write the parent's records again.
+ *
+ * Once batching is on, wlog_record_write() returns the record's logical
+ * offset, the number of bytes this wlog_file appended before it.  That
+ * value is only meaningful as the offset argument of a later
+ * wlog_record_write() on the same wlog_file.  Overlaying a record that
+ * is still in the buffer costs no I/O at all.
+ */
+
+int wlog_set_batch(struct wlog_file *wfile, int nrecs)
+{
+	static int registered;
+
+	if (nrecs <= 1)
+		return 0;
+
+	wfile->w_buf = malloc(nrecs * (WLOG_REC_MAX_SIZE + 2));
+	if (wfile->w_buf == NULL) {
+		snprintf(Wlog_Error_String, sizeof(Wlog_Error_String),
+			"Could not allocate write log buffer for %d records:  %s\n",
+			nrecs, strerror(errno));
+		return -1;
+	}
+	wfile->w_batch = nrecs;
+
+	if (!registered) {
+		atexit(wlog_atexit);
+		registered = 1;
+	}
+	wfile->w_nextfile = Wlog_Batched;
+	Wlog_Batched = wfile;
+
+	return 0;
+}
+
+/*
+ * Write the records collected by a batched wlog_file as one group commit
+ * and remember where they ended up in the log file.
+ */
+
+int wlog_flush(struct wlog_file *wfile)
+{
+	struct wlog_extent *ext;
+	off_t fbase;
+	int len = wfile->w_buflen;
+
+	if (len == 0)
+		return 0;
+
+	if (write(wfile->w_afd, wfile->w_buf, len) != len) {
+		snprintf(Wlog_Error_String, sizeof(Wlog_Error_String),
+			"Could not write log - write(%s, %d records, %d) failed:  %s\n",
+			wfile->w_file, wfile->w_nbuf, len, strerror(errno));
+		return -1;
+	}
+
+	fbase = lseek(wfile->w_afd, 0, SEEK_CUR) - len;
+	if (fbase < 0) {
+		snprintf(Wlog_Error_String, sizeof(Wlog_Error_String),
+			"Could not reposition file pointer - lseek(%s, 0, SEEK_CUR) failed:  %s\n",
+			wfile->w_file, strerror(errno));
+		return -1;
+	}
+
+	ext = wfile->w_next ? &wfile->w_ext[wfile->w_next - 1] : NULL;
+	if (ext != NULL && ext->e_fbase + ext->e_len == fbase) {
+		/* nobody else appended in between */
+		ext->e_len += len;
+	} else {
+		if (wfile->w_next == wfile->w_maxext) {
+			int n = wfile->w_maxext ? 2 * wfile->w_maxext : 64;
+
+			ext = realloc(wfile->w_ext, n * sizeof(*ext));
+			if (ext == NULL) {
+				snprintf(Wlog_Error_String, sizeof(Wlog_Error_String),
+					"Could not grow write log extents to %d:  %s\n",
+					n, strerror(errno));
+				return -1;
+			}
+			wfile->w_ext = ext;
+			wfile->w_maxext = n;
+		}
+		ext = &wfile->w_ext[wfile->w_next++];
+		ext->e_lbase = wfile->w_lbase;
+		ext->e_fbase = fbase;
+		ext->e_len = len;
+	}
+
+	wfile->w_lbase += len;
+	wfile->w_buflen = 0;
+	wfile->w_nbuf = 0;
+
 	return 0;
 }
 
@@ -205,6 +347,9 @@ int wlog_record_write(struct wlog_file *wfile, struct wlog_rec *wrec,
 
 	reclen = wlog_rec_pack(wrec, wbuf, (offset < 0));
 
+	if (wfile->w_batch)
+		return wlog_overlay(wfile, wbuf, reclen, offset);
+
 	if (offset < 0) {
 		/*
 		 * Since we're writing a complete new record, we must also tack
@@ -250,6 +395,74 @@ int wlog_record_write(struct wlog_file *wfile, struct wlog_rec *wrec,
 	return offset;
 }
 
+/*
+ * wlog_record_write() for a batched wlog_file.  offset is a logical
+ * offset as returned by an earlier append.
+ */
+
+static int wlog_overlay(struct wlog_file *wfile, char *wbuf, int reclen,
+			long offset)
+{
+	struct wlog_extent *ext;
+	int lo, hi, mid;
+	long foffset;
+
+	if (offset < 0) {
+		offset = wfile->w_lbase + wfile->w_buflen;
+
+		wbuf[reclen] = reclen / 256;
+		wbuf[reclen + 1] = reclen % 256;
+		reclen += 2;
+
+		memcpy(wfile->w_buf + wfile->w_buflen, wbuf, reclen);
+		wfile->w_buflen += reclen;
+
+		if (++wfile->w_nbuf >= wfile->w_batch &&
+		    wlog_flush(wfile) == -1)
+			return -1;
+
+		return offset;
+	}
+
+	if (offset >= wfile->w_lbase) {
+		memcpy(wfile->w_buf + (offset - wfile->w_lbase), wbuf, reclen);
+		return offset;
+	}
+
+	lo = 0;
+	hi = wfile->w_next - 1;
+	ext = NULL;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (offset < wfile->w_ext[mid].e_lbase) {
+			hi = mid - 1;
+		} else if (offset >= wfile->w_ext[mid].e_lbase +
+			   wfile->w_ext[mid].e_len) {
+			lo = mid + 1;
+		} else {
+			ext = &wfile->w_ext[mid];
+			break;
+		}
+	}
+
+	if (ext == NULL) {
+		snprintf(Wlog_Error_String, sizeof(Wlog_Error_String),
+			"Could not overlay record - %s has no record at logical offset %ld\n",
+			wfile->w_file, offset);
+		return -1;
+	}
+
+	foffset = ext->e_fbase + (offset - ext->e_lbase);
+	if (pwrite(wfile->w_rfd, wbuf, reclen, foffset) != reclen) {
+		snprintf(Wlog_Error_String, sizeof(Wlog_Error_String),
+			"Could not write log - pwrite(%s, %d, %ld) failed:  %s\n",
+			wfile->w_file, reclen, foffset, strerror(errno));
+		return -1;
+	}
+
+	return offset;
+}
+
 /*
  * Function to scan a logfile in reverse order.  Wfile is a valid
  * wlog_file structure initialized by wlog_open().  nrecs is the number
@@ -266,6 +479,9 @@ int wlog_scan_backward(struct wlog_file *wfile, int nrecs,
 	char albuf[WLOG_REC_MAX_SIZE];
 	struct wlog_rec wrec;
 
+	if (wlog_flush(wfile) == -1)
+		return -1;
+
 	fd = wfile->w_rfd;
 
 	/*
@@ -407,6 +623,7 @@ static int wlog_rec_pack(struct wlog_rec *wrec, char *buf, int flag)
 	struct wlog_rec_disk *wrecd;
 
 	wrecd = (struct wlog_rec_disk *)buf;
+	memset(wrecd, 0, sizeof(struct wlog_rec_disk));
 
 	wrecd->w_pid = (uint) wrec->w_pid;
 	wrecd->w_offset = (uint) wrec->w_offset;
@@ -0,0 +1,484 @@
+/*
+ * Copyright (c) 2016 Linux Test Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * cgroup v2 helpers for ltp-pan, see cglib.h.
+ *
+ * All files are accessed relative to directory fds so the paths do not
+ * have to be rebuilt for every read, and a leaf that has been moved or
+ * removed underneath us fails cleanly instead of touching another one.
+ */
+
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cglib.h"
+
+#ifndef CGROUP2_SUPER_MAGIC
+# define CGROUP2_SUPER_MAGIC 0x63677270
+#endif
+
+char cg_error[CGELEN];
+
+static int root_dfd = -1;
+static int top_dfd = -1;
+static char top_name[NAME_MAX + 1];
+
+static const char *const controllers[] = {"cpu", "memory", "io", "pids"};
+
+static ssize_t read_file(int dfd, const char *name, char *buf, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	fd = openat(dfd, name, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len < 0)
+		return -1;
+
+	buf[len] = '\0';
+	return len;
+}
+
+static int write_file(int dfd, const char *name, const char *val)
+{
+	ssize_t len = strlen(val);
+	int fd;
+
+	fd = openat(dfd, name, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (write(fd, val, len) != len) {
+		int e = errno;
+
+		close(fd);
+		errno = e;
+		return -1;
+	}
+
+	return close(fd);
+}
+
+/* Returns the value following key in a flat keyed file, or -1 if absent */
+static long long keyed_value(const char *buf, const char *key)
+{
+	size_t len = strlen(key);
+	const char *p = buf;
+
+	while (p && *p) {
+		if (!strncmp(p, key, len) && p[len] == ' ')
+			return strtoll(p + len + 1, NULL, 10);
+		p = strchr(p, '\n');
+		if (p)
+			p++;
+	}
+
+	return -1;
+}
+
+static void enable_controllers(int dfd)
+{
+	char buf[256], ctrl[16];
+	unsigned int i;
+	char *tok, *save;
+
+	if (read_file(dfd, "cgroup.controllers", buf, sizeof(buf)) < 0)
+		return;
+
+	for (tok = strtok_r(buf, " \n", &save); tok;
+	     tok = strtok_r(NULL, " \n", &save)) {
+		for (i = 0; i < sizeof(controllers) / sizeof(*controllers); i++) {
+			if (strcmp(tok, controllers[i]))
+				continue;
+
+			/* Failures only matter if a test asks for a limit */
+			snprintf(ctrl, sizeof(ctrl), "+%s", tok);
+			write_file(dfd, "cgroup.subtree_control", ctrl);
+		}
+	}
+}
+
+int cg_init(const char *root, const char *panname)
+{
+	struct statfs sfs;
+
+	root_dfd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (root_dfd < 0) {
+		snprintf(cg_error, CGELEN, "open(%s) failed: %s",
+			 root, strerror(errno));
+		return -1;
+	}
+
+	if (fstatfs(root_dfd, &sfs) || sfs.f_type != CGROUP2_SUPER_MAGIC) {
+		snprintf(cg_error, CGELEN, "%s is not a cgroup v2 directory",
+			 root);
+		goto err;
+	}
+
+	enable_controllers(root_dfd);
+
+	snprintf(top_name, sizeof(top_name), "ltp-pan-%s.%d",
+		 panname, getpid());
+	if (mkdirat(root_dfd, top_name, 0755)) {
+		snprintf(cg_error, CGELEN, "mkdir(%s/%s) failed: %s",
+			 root, top_name, strerror(errno));
+		goto err;
+	}
+
+	top_dfd = openat(root_dfd, top_name,
+			 O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (top_dfd < 0) {
+		snprintf(cg_error, CGELEN, "open(%s/%s) failed: %s",
+			 root, top_name, strerror(errno));
+		unlinkat(root_dfd, top_name, AT_REMOVEDIR);
+		goto err;
+	}
+
+	enable_controllers(top_dfd);
+	return 0;
+err:
+	close(root_dfd);
+	root_dfd = -1;
+	return -1;
+}
+
+/*
+ * Applies "file=value file=value ..." to the leaf. A value containing
+ * spaces, such as cpu.max or io.max, has to be double quoted.
+ */
+static int apply_limits(struct cg_leaf *leaf, const char *tag,
+			const char *limits)
+{
+	char *buf, *p, *key, *val;
+	int ret = 0;
+
+	buf = strdup(limits);
+	if (!buf) {
+		snprintf(cg_error, CGELEN, "strdup() failed");
+		return -1;
+	}
+
+	for (p = buf; *p;) {
+		p += strspn(p, " \t");
+		if (!*p)
+			break;
+
+		key = p;
+		val = strchr(p, '=');
+		if (!val) {
+			snprintf(cg_error, CGELEN,
+				 "tag %s: malformed cgroup limit '%s'",
+				 tag, key);
+			ret = -1;
+			break;
+		}
+		*val++ = '\0';
+
+		if (*val == '"') {
+			p = strchr(++val, '"');
+			if (!p) {
+				snprintf(cg_error, CGELEN,
+					 "tag %s: unterminated quote for %s",
+					 tag, key);
+				ret = -1;
+				break;
+			}
+		} else {
+			p = val + strcspn(val, " \t");
+		}
+		if (*p)
+			*p++ = '\0';
+
+		if (strchr(key, '/') || write_file(leaf->dfd, key, val)) {
+			snprintf(cg_error, CGELEN,
+				 "tag %s: cannot set %s to '%s': %s",
+				 tag, key, val, strerror(errno));
+			ret = -1;
+			break;
+		}
+	}
+
+	free(buf);
+	return ret;
+}
+
+int cg_create(struct cg_leaf *leaf, const char *tag, const char *limits)
+{
+	static unsigned long cnt;
+	char *p;
+
+	snprintf(leaf->name, sizeof(leaf->name), "%s.%lu", tag, cnt++);
+	for (p = leaf->name; *p; p++) {
+		if (*p == '/')
+			*p = '_';
+	}
+
+	if (mkdirat(top_dfd, leaf->name, 0755)) {
+		snprintf(cg_error, CGELEN, "mkdir(%s/%s) failed: %s",
+			 top_name, leaf->name, strerror(errno));
+		leaf->dfd = -1;
+		return -1;
+	}
+
+	leaf->dfd = openat(top_dfd, leaf->name,
+			   O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (leaf->dfd < 0) {
+		snprintf(cg_error, CGELEN, "open(%s/%s) failed: %s",
+			 top_name, leaf->name, strerror(errno));
+		unlinkat(top_dfd, leaf->name, AT_REMOVEDIR);
+		return -1;
+	}
+
+	if (limits && apply_limits(leaf, tag, limits)) {
+		cg_destroy(leaf);
+		return -1;
+	}
+
+	return 0;
+}
+
+int cg_attach(struct cg_leaf *leaf)
+{
+	if (write_file(leaf->dfd, "cgroup.procs", "0")) {
+		snprintf(cg_error, CGELEN,
+			 "cannot move into cgroup %s/%s: %s",
+			 top_name, leaf->name, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int cg_signal(struct cg_leaf *leaf, int sig)
+{
+	char buf[4096], *p, *end;
+	pid_t pid;
+	int fd;
+	FILE *f;
+
+	if (sig == SIGKILL && !write_file(leaf->dfd, "cgroup.kill", "1"))
+		return 0;
+
+	/* Older kernels without cgroup.kill, or any other signal */
+	fd = openat(leaf->dfd, "cgroup.procs", O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || !(f = fdopen(fd, "r"))) {
+		snprintf(cg_error, CGELEN, "cannot read %s/%s/cgroup.procs: %s",
+			 top_name, leaf->name, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	while (fgets(buf, sizeof(buf), f)) {
+		p = buf;
+		pid = strtol(p, &end, 10);
+		if (end != p && pid > 0)
+			kill(pid, sig);
+	}
+
+	fclose(f);
+	return 0;
+}
+
+int cg_populated(struct cg_leaf *leaf)
+{
+	char buf[256];
+
+	if (read_file(leaf->dfd, "cgroup.events", buf, sizeof(buf)) < 0)
+		return -1;
+
+	return keyed_value(buf, "populated") > 0;
+}
+
+int cg_drain(struct cg_leaf *leaf, int timeout_ms)
+{
+	struct pollfd pfd;
+	struct timespec now, end;
+	char buf[256];
+	ssize_t len;
+	int left;
+
+	if (cg_populated(leaf) <= 0)
+		return 0;
+
+	pfd.fd = openat(leaf->dfd, "cgroup.events", O_RDONLY | O_CLOEXEC);
+	if (pfd.fd < 0)
+		return -1;
+	pfd.events = POLLPRI;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	end.tv_sec += timeout_ms / 1000;
+	end.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if (end.tv_nsec >= 1000000000L) {
+		end.tv_sec++;
+		end.tv_nsec -= 1000000000L;
+	}
+
+	for (;;) {
+		cg_signal(leaf, SIGKILL);
+
+		/*
+		 * cgroup.events signals a change of populated with POLLPRI,
+		 * reading it through the polled fd rearms the notification.
+		 */
+		len = pread(pfd.fd, buf, sizeof(buf) - 1, 0);
+		if (len > 0) {
+			buf[len] = '\0';
+			if (keyed_value(buf, "populated") == 0)
+				break;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		left = (end.tv_sec - now.tv_sec) * 1000 +
+		       (end.tv_nsec - now.tv_nsec) / 1000000;
+		if (left <= 0)
+			break;
+
+		/* Wake up regularly for kernels without cgroup.kill */
+		poll(&pfd, 1, left < 100 ? left : 100);
+	}
+
+	close(pfd.fd);
+	return cg_populated(leaf) ? -1 : 0;
+}
+
+static void append(char **p, size_t *left, const char *key, long long val)
+{
+	int len;
+
+	if (val < 0 || !*left)
+		return;
+
+	len = snprintf(*p, *left, " %s=%lld", key, val);
+	if (len < 0 || (size_t)len >= *left)
+		len = *left - 1;
+	*p += len;
+	*left -= len;
+}
+
+void cg_usage(struct cg_leaf *leaf, char *buf, size_t size)
+{
+	char stat[4096], *line, *f, *save;
+	long long rbytes = -1, wbytes = -1, v;
+
+	buf[0] = '\0';
+
+	if (read_file(leaf->dfd, "cpu.stat", stat, sizeof(stat)) > 0) {
+		v = keyed_value(stat, "user_usec");
+		append(&buf, &size, "cg_ucpu", v < 0 ? v : v / 1000);
+		v = keyed_value(stat, "system_usec");
+		append(&buf, &size, "cg_scpu", v < 0 ? v : v / 1000);
+	}
+
+	if (read_file(leaf->dfd, "memory.peak", stat, sizeof(stat)) > 0)
+		append(&buf, &size, "cg_maxmem", strtoll(stat, NULL, 10) / 1024);
+
+	if (read_file(leaf->dfd, "memory.events", stat, sizeof(stat)) > 0)
+		append(&buf, &size, "cg_oom", keyed_value(stat, "oom_kill"));
+
+	/* io.stat has one "MAJ:MIN rbytes=.. wbytes=.. ..." line per device */
+	if (read_file(leaf->dfd, "io.stat", stat, sizeof(stat)) >= 0) {
+		rbytes = wbytes = 0;
+		for (line = strtok_r(stat, " \n", &save); line;
+		     line = strtok_r(NULL, " \n", &save)) {
+			f = strchr(line, '=');
+			if (!f)
+				continue;
+			if (!strncmp(line, "rbytes=", 7))
+				rbytes += strtoll(f + 1, NULL, 10);
+			else if (!strncmp(line, "wbytes=", 7))
+				wbytes += strtoll(f + 1, NULL, 10);
+		}
+	}
+	append(&buf, &size, "cg_rbytes", rbytes);
+	append(&buf, &size, "cg_wbytes", wbytes);
+
+	if (read_file(leaf->dfd, "pids.peak", stat, sizeof(stat)) > 0)
+		append(&buf, &size, "cg_pids", strtoll(stat, NULL, 10));
+}
+
+int cg_destroy(struct cg_leaf *leaf)
+{
+	int ret = 0;
+
+	if (leaf->dfd < 0)
+		return 0;
+
+	close(leaf->dfd);
+	leaf->dfd = -1;
+
+	if (unlinkat(top_dfd, leaf->name, AT_REMOVEDIR)) {
+		snprintf(cg_error, CGELEN, "rmdir(%s/%s) failed: %s",
+			 top_name, leaf->name, strerror(errno));
+		ret = -1;
+	}
+
+	return ret;
+}
+
+void cg_cleanup(void)
+{
+	struct cg_leaf leaf;
+	struct dirent *ent;
+	DIR *dir;
+	int fd;
+
+	if (top_dfd < 0)
+		return;
+
+	fd = dup(top_dfd);
+	dir = fd < 0 ? NULL : fdopendir(fd);
+	if (dir) {
+		while ((ent = readdir(dir))) {
+			if (ent->d_type != DT_DIR || ent->d_name[0] == '.')
+				continue;
+
+			leaf.dfd = openat(top_dfd, ent->d_name,
+					  O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (leaf.dfd < 0)
+				continue;
+			snprintf(leaf.name, sizeof(leaf.name), "%s",
+				 ent->d_name);
+			cg_drain(&leaf, 5000);
+			cg_destroy(&leaf);
+		}
+		closedir(dir);
+	} else if (fd >= 0) {
+		close(fd);
+	}
+
+	close(top_dfd);
+	top_dfd = -1;
+	unlinkat(root_dfd, top_name, AT_REMOVEDIR);
+	close(root_dfd);
+	root_dfd = -1;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2016 Linux Test Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef CGLIB_H
+#define CGLIB_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * Per-test cgroup v2 leaves for ltp-pan.
+ *
+ * ltp-pan creates one directory below the cgroup given with -c and one leaf
+ * in it for every test it starts. Everything the test forks, including
+ * daemons that left the pgrp, stays in the leaf, so it can be signaled and
+ * accounted as a whole.
+ */
+
+#define CGELEN 1024
+extern char cg_error[CGELEN];
+
+struct cg_leaf {
+	int dfd;		/* leaf directory, -1 when unused */
+	char name[NAME_MAX + 1];
+};
+
+/* cg_init(): create the ltp-pan directory below root and enable the cpu,
+ * memory, io and pids controllers for the leaves where available
+ *	returns 0 on success, -1 on error */
+int cg_init(const char *root, const char *panname);
+
+/* cg_create(): create a leaf for a tag and apply the limits, a list of
+ * file=value pairs as given in a runtest #@cgroup annotation
+ *	returns 0 on success, -1 on error */
+int cg_create(struct cg_leaf *leaf, const char *tag, const char *limits);
+
+/* cg_attach(): move the calling process into the leaf
+ *	returns 0 on success, -1 on error */
+int cg_attach(struct cg_leaf *leaf);
+
+/* cg_signal(): send a signal to every process in the leaf, SIGKILL is
+ * delivered atomically through cgroup.kill when the kernel has it
+ *	returns 0 on success, -1 on error */
+int cg_signal(struct cg_leaf *leaf, int sig);
+
+/* cg_populated(): returns 1 if the leaf still has processes, 0 if not
+ * and -1 on error */
+int cg_populated(struct cg_leaf *leaf);
+
+/* cg_drain(): kill whatever is left in the leaf and wait up to timeout_ms
+ * for it to go away
+ *	returns 0 when the leaf is empty, -1 otherwise */
+int cg_drain(struct cg_leaf *leaf, int timeout_ms);
+
+/* cg_usage(): format the leaf accounting as " key=value" pairs */
+void cg_usage(struct cg_leaf *leaf, char *buf, size_t size);
+
+/* cg_destroy(): remove the leaf, it must be empty
+ *	returns 0 on success, -1 on error */
+int cg_destroy(struct cg_leaf *leaf);
+
+/* cg_cleanup(): kill and remove all remaining leaves and the ltp-pan
+ * directory */
+void cg_cleanup(void);
+
+#endif /* CGLIB_H */
@@ -52,6 +52,7 @@
 /* $Id: ltp-pan.c,v 1.4 2009/10/15 18:45:55 yaberauneya Exp $ */
 
 #include <sys/param.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/times.h>
 #include <sys/types.h>
@@ -65,6 +66,8 @@
 #include <string.h>
 #include <time.h>
 
+#include "cglib.h"
+#include "results.h"
 #include "splitstr.h"
 #include "zoolib.h"
 #include "tst_res_flags.h"
@@ -74,6 +77,7 @@ struct coll_entry {
 	char *name;		/* tag name */
 	char *cmdline;		/* command line */
 	char *pcnt_f;		/* location of %f in the command line args, flag */
+	char *cglimits;		/* #@cgroup annotation, NULL if none */
 	struct coll_entry *next;
 };
 
@@ -87,6 +91,7 @@ struct tag_pgrp {
 	int stopping;
 	time_t mystime;
 	struct coll_entry *cmd;
+	struct cg_leaf cg;	/* cgroup leaf (-c), dfd is -1 when unused */
 	char output[PATH_MAX];
 };
 
@@ -110,6 +115,8 @@ static int check_pids(struct tag_pgrp *running, int *num_active,
 static void propagate_signal(struct tag_pgrp *running, int keep_active,
 			     struct orphan_pgrp *orphans);
 static void dump_coll(struct collection *coll);
+static int order_by_history(struct collection *coll, const char *store,
+			    int skip_unaffected, int quiet_mode);
 static char *subst_pcnt_f(struct coll_entry *colle);
 static void mark_orphan(struct orphan_pgrp *orphans, pid_t cpid);
 static void orphans_running(struct orphan_pgrp *orphans);
@@ -119,13 +126,19 @@ static void copy_buffered_output(struct tag_pgrp *running);
 static void write_test_start(struct tag_pgrp *running);
 static void write_test_end(struct tag_pgrp *running, const char *init_status,
 			   time_t exit_time, char *term_type, int stat_loc,
-			   int term_id, struct tms *tms1, struct tms *tms2);
+			   int term_id, struct tms *tms1, struct tms *tms2,
+			   const char *usage);
+static void format_rusage(char *buf, size_t size, const struct rusage *ru);
+static void store_result(struct tag_pgrp *running, time_t exit_time,
+			 int signaled, int term_id, const struct rusage *ru);
 
 //wjh
 static char PAN_STOP_FILE[] = "PAN_STOP_FILE";
 
 static char *panname = NULL;
 static char *test_out_dir = NULL;	/* dir to buffer output to */
+static char *cgroup_root = NULL;	/* cgroup v2 dir for test leaves */
+static struct rs_writer results = {.fd = -1};	/* -R results store */
 zoo_t zoofile;
 static char *reporttype = NULL;
 
@@ -154,6 +167,8 @@ int main(int argc, char **argv)
 	char *failcmdfilename = NULL;
 	char *tconfcmdfilename = NULL;
 	char *outputfilename = NULL;
+	char *resultsfilename = NULL;
+	int failure_first = 0;	/* order tags by their -R history */
 	struct collection *coll = NULL;
 	struct tag_pgrp *running;
 	struct orphan_pgrp *orphans, *orph;
@@ -185,16 +200,27 @@ int main(int argc, char **argv)
 	struct sigaction sa;
 
 	while ((c =
-		getopt(argc, argv, "AO:Sa:C:T:d:ef:hl:n:o:pqr:s:t:x:y"))
+		getopt(argc, argv, "AFO:R:SUa:C:T:c:d:ef:hl:n:o:pqr:s:t:x:y"))
 		       != -1) {
 		switch (c) {
 		case 'A':	/* all-stop flag */
 			has_brakes = 1;
 			track_exit_stats = 1;
 			break;
+		case 'F':	/* failing and flaky tags first */
+			failure_first = 1;
+			sequential = 1;
+			break;
+		case 'U':	/* -F and skip tags that passed on this kernel */
+			failure_first = 2;
+			sequential = 1;
+			break;
 		case 'O':	/* output buffering directory */
 			test_out_dir = strdup(optarg);
 			break;
+		case 'R':	/* binary results store */
+			resultsfilename = strdup(optarg);
+			break;
 		case 'S':	/* run tests sequentially */
 			sequential = 1;
 			break;
@@ -211,6 +237,9 @@ int main(int argc, char **argv)
 			 */
 			tconfcmdfilename = strdup(optarg);
 			break;
+		case 'c':	/* run each test in a leaf of this cgroup */
+			cgroup_root = strdup(optarg);
+			break;
 		case 'd':	/* debug options */
 			sscanf(optarg, "%i", &Debug);
 			break;
@@ -222,12 +251,13 @@ int main(int argc, char **argv)
 			break;
 		case 'h':	/* help */
 			fprintf(stdout,
-				"Usage: pan -n name [ -SyAehpq ] [ -s starts ]"
+				"Usage: pan -n name [ -SyAehpqFU ] [ -s starts ]"
 				" [-t time[s|m|h|d] [ -x nactive ] [ -l logfile ]\n\t"
 				"[ -a active-file ] [ -f command-file ] "
-				"[ -C fail-command-file ] "
+				"[ -C fail-command-file ] [ -c cgroup-dir ] "
 				"[ -d debug-level ]\n\t[-o output-file] "
-				"[-O output-buffer-directory] [cmd]\n");
+				"[-O output-buffer-directory] "
+				"[-R results-store] [cmd]\n");
 			exit(0);
 		case 'l':	/* log file */
 			logfilename = strdup(optarg);
@@ -363,6 +393,25 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (failure_first) {
+		if (!resultsfilename) {
+			fprintf(stderr, "pan(%s): -F and -U need -R\n",
+				panname);
+			exit(1);
+		}
+		if (order_by_history(coll, resultsfilename,
+				     failure_first == 2, quiet_mode)) {
+			/* The run still counts towards SKIP_BUILDS */
+			if (rs_open(&results, resultsfilename, panname)) {
+				fprintf(stderr, "pan(%s): %s\n", panname,
+					rs_error);
+				exit(1);
+			}
+			rs_close(&results);
+			exit(0);
+		}
+	}
+
 	if (Debug & Dsetup)
 		dump_coll(coll);
 
@@ -376,6 +425,8 @@ int main(int argc, char **argv)
 		exit(2);
 	}
 	memset(running, 0, keep_active * sizeof(struct tag_pgrp));
+	for (i = 0; i < keep_active; i++)
+		running[i].cg.dfd = -1;
 	running[keep_active].pgrp = -1;	/* end sentinel */
 
 	/* a head to the orphaned pgrp list */
@@ -463,6 +514,16 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (resultsfilename && rs_open(&results, resultsfilename, panname)) {
+		fprintf(stderr, "pan(%s): %s\n", panname, rs_error);
+		exit(1);
+	}
+
+	if (cgroup_root && cg_init(cgroup_root, panname)) {
+		fprintf(stderr, "pan(%s): %s\n", panname, cg_error);
+		exit(1);
+	}
+
 	if ((zoofile = zoo_open(zooname)) == NULL) {
 		fprintf(stderr, "pan(%s): %s\n", panname, zoo_error);
 		exit(1);
@@ -634,6 +695,11 @@ int main(int argc, char **argv)
 			break;
 	}
 
+	if (cgroup_root)
+		cg_cleanup();
+
+	rs_close(&results);
+
 	if (zoo_clear(zoofile, getpid())) {
 		fprintf(stderr, "pan(%s): %s\n", panname, zoo_error);
 		++exit_stat;
@@ -686,7 +752,13 @@ propagate_signal(struct tag_pgrp *running, int keep_active,
 		if (Debug & Dshutdown)
 			fprintf(stderr, "  propagating sig %d to %d\n",
 				send_signal, -running[i].pgrp);
-		if (kill(-running[i].pgrp, send_signal) != 0) {
+		/* The leaf also holds the test's daemons, not just its pgrp */
+		if (running[i].cg.dfd >= 0) {
+			if (cg_signal(&running[i].cg, send_signal))
+				fprintf(stderr, "pan(%s): %s (tag %s)\n",
+					panname, cg_error,
+					running[i].cmd->name);
+		} else if (kill(-running[i].pgrp, send_signal) != 0) {
 			fprintf(stderr,
 				"pan(%s): kill(%d,%d) failed on tag (%s).  errno:%d  %s\n",
 				panname, -running[i].pgrp, send_signal,
@@ -716,6 +788,9 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 	char *result_str;
 	int signaled = 0;
 	struct tms tms1, tms2;
+	struct rusage ru;
+	char usage[512];
+	int cg_empty;
 	clock_t tck;
 
 	check_orphans(orphans, 0);
@@ -725,7 +800,7 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 		fprintf(stderr, "pan(%s): times(&tms1) failed.  errno:%d  %s\n",
 			panname, errno, strerror(errno));
 	}
-	cpid = wait(&stat_loc);
+	cpid = wait4(-1, &stat_loc, 0, &ru);
 	tck = times(&tms2);
 	if (tck == -1) {
 		fprintf(stderr, "pan(%s): times(&tms2) failed.  errno:%d  %s\n",
@@ -744,6 +819,8 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 		}
 	} else if (cpid > 0) {
 
+		format_rusage(usage, sizeof(usage), &ru);
+
 		if (WIFSIGNALED(stat_loc)) {
 			w = WTERMSIG(stat_loc);
 			status = "signaled";
@@ -775,6 +852,22 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 
 		for (i = 0; i < keep_active; ++i) {
 			if (running[i].pgrp == cpid) {
+				/* Kill whatever the test left behind in its
+				 * leaf, then account for all of it.
+				 */
+				cg_empty = 0;
+				if (running[i].cg.dfd >= 0) {
+					size_t len = strlen(usage);
+
+					cg_empty = !cg_drain(&running[i].cg,
+							     5000);
+					cg_usage(&running[i].cg, usage + len,
+						 sizeof(usage) - len);
+					if (cg_destroy(&running[i].cg))
+						fprintf(stderr,
+							"pan(%s): %s\n",
+							panname, cg_error);
+				}
 				if ((w == 130) && running[i].stopping &&
 				    (strcmp(status, "exited") == 0)) {
 					/* The child received sigint, but
@@ -793,7 +886,7 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 				if (logfile != NULL) {
 					if (!fmt_print)
 						fprintf(logfile,
-							"tag=%s stime=%d dur=%d exit=%s stat=%d core=%s cu=%d cs=%d\n",
+							"tag=%s stime=%d dur=%d exit=%s stat=%d core=%s cu=%d cs=%d%s\n",
 							running[i].cmd->name,
 							(int)(running[i].
 							      mystime),
@@ -806,7 +899,8 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 							(int)(tms2.tms_cutime -
 							      tms1.tms_cutime),
 							(int)(tms2.tms_cstime -
-							      tms1.tms_cstime));
+							      tms1.tms_cstime),
+							usage);
 					else {
 						if (strcmp(status, "exited") ==
 						    0 && w == TCONF) {
@@ -829,6 +923,8 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 					fflush(logfile);
 				}
 
+				store_result(running + i, t, signaled, w, &ru);
+
 				if (w != 0) {
 					if (tconfcmdfile != NULL &&
 					    w == TCONF) {
@@ -854,7 +950,7 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 				if (!quiet_mode)
 					write_test_end(running + i, "ok", t,
 						       status, stat_loc, w,
-						       &tms1, &tms2);
+						       &tms1, &tms2, usage);
 
 				/* If signaled and we weren't expecting
 				 * this to be stopped then the proc
@@ -870,8 +966,11 @@ check_pids(struct tag_pgrp *running, int *num_active, int keep_active,
 					exit(1);
 				}
 
-				/* Check for orphaned pgrps */
-				if ((kill(-cpid, 0) == 0) || (errno == EPERM)) {
+				/* Check for orphaned pgrps, with a cgroup leaf
+				 * that was emptied there cannot be any.
+				 */
+				if (!cg_empty &&
+				    ((kill(-cpid, 0) == 0) || (errno == EPERM))) {
 					if (zoo_mark_cmdline
 					    (zoofile, cpid, "panorphan",
 					     running[i].cmd->cmdline)) {
@@ -942,6 +1041,18 @@ run_child(struct coll_entry *colle, struct tag_pgrp *active, int quiet_mode,
 		return -1;
 	}
 
+	if (cgroup_root &&
+	    cg_create(&active->cg, colle->name, colle->cglimits)) {
+		fprintf(stderr, "pan(%s): %s\n", panname, cg_error);
+		if (capturing) {
+			close(c_stdout);
+			unlink(active->output);
+		}
+		close(errpipe[0]);
+		close(errpipe[1]);
+		return -1;
+	}
+
 	time(&active->mystime);
 	active->cmd = colle;
 
@@ -961,6 +1072,7 @@ run_child(struct coll_entry *colle, struct tag_pgrp *active, int quiet_mode,
 		}
 		close(errpipe[0]);
 		close(errpipe[1]);
+		cg_destroy(&active->cg);
 		return -1;
 	} else if (cpid == 0) {
 		/* child */
@@ -979,6 +1091,17 @@ run_child(struct coll_entry *colle, struct tag_pgrp *active, int quiet_mode,
 	}								\
 } while(0)
 
+		if (active->cg.dfd >= 0 && cg_attach(&active->cg)) {
+			errlen = snprintf(errbuf, sizeof(errbuf),
+					  "pan(%s): %s (tag %s)",
+					  panname, cg_error, colle->name);
+			if (errlen >= (ssize_t)sizeof(errbuf))
+				errlen = sizeof(errbuf) - 1;
+			WRITE_OR_DIE(errpipe[1], &errlen, sizeof(errlen));
+			WRITE_OR_DIE(errpipe[1], errbuf, errlen);
+			exit(2);
+		}
+
 		/* if we're putting output into a buffer file, we need to do the
 		 * redirection now.  If we fail
 		 */
@@ -1066,13 +1189,20 @@ run_child(struct coll_entry *colle, struct tag_pgrp *active, int quiet_mode,
 		int termid;
 		char *termtype;
 		struct tms notime = { 0, 0, 0, 0 };
+		struct rusage ru;
+		char usage[512];
 
 		if (read(errpipe[0], errbuf, errlen) < 0)
 			fprintf(stderr, "Failed to read from errpipe[0]\n");
 		close(errpipe[0]);
 		errbuf[errlen] = '\0';
 		/* fprintf(stderr, "%s", errbuf); */
-		waitpid(cpid, &status, 0);
+		wait4(cpid, &status, 0, &ru);
+		format_rusage(usage, sizeof(usage), &ru);
+		if (active->cg.dfd >= 0) {
+			cg_drain(&active->cg, 5000);
+			cg_destroy(&active->cg);
+		}
 		if (WIFSIGNALED(status)) {
 			termid = WTERMSIG(status);
 			termtype = "signaled";
@@ -1087,15 +1217,17 @@ run_child(struct coll_entry *colle, struct tag_pgrp *active, int quiet_mode,
 			termtype = "unknown";
 		}
 		time(&end_time);
+		store_result(active, end_time, WIFSIGNALED(status), termid, &ru);
 		if (logfile != NULL) {
 			if (!fmt_print) {
 				fprintf(logfile,
 					"tag=%s stime=%d dur=%d exit=%s "
-					"stat=%d core=%s cu=%d cs=%d\n",
+					"stat=%d core=%s cu=%d cs=%d%s\n",
 					colle->name, (int)(active->mystime),
 					(int)(end_time - active->mystime),
 					termtype, termid,
-					(status & 0200) ? "yes" : "no", 0, 0);
+					(status & 0200) ? "yes" : "no", 0, 0,
+					usage);
 			} else {
 				if (termid != 0)
 					++ * failcnt;
@@ -1111,7 +1243,7 @@ run_child(struct coll_entry *colle, struct tag_pgrp *active, int quiet_mode,
 		if (!quiet_mode) {
 			//write_test_start(active, errbuf);
 			write_test_end(active, errbuf, end_time, termtype,
-				       status, termid, &notime, &notime);
+				       status, termid, &notime, &notime, usage);
 		}
 		if (capturing) {
 			close(c_stdout);
@@ -1170,6 +1302,7 @@ static struct collection *get_collection(char *file, int optind, int argc,
 	char *buf, *a, *b;
 	struct coll_entry *head, *p, *n;
 	struct collection *coll;
+	char *cglimits = NULL;
 	int i;
 
 	buf = slurp(file);
@@ -1187,12 +1320,20 @@ static struct collection *get_collection(char *file, int optind, int argc,
 		if ((b = strchr(a, '\n')) != NULL)
 			*b++ = '\0';
 
+		/* "#@cgroup file=value ..." applies to the next tag */
+		if (!strncmp(a, "#@cgroup", 8) && (a[8] == ' ' || a[8] == '\t')) {
+			free(cglimits);
+			cglimits = strdup(a + 9);
+		}
+
 		/* If this is line isn't a comment */
 		if ((*a != '#') && (*a != '\0') && (*a != ' ')) {
 			n = malloc(sizeof(struct coll_entry));
 			if ((n->pcnt_f = strstr(a, "%f"))) {
 				n->pcnt_f[1] = 's';
 			}
+			n->cglimits = cglimits;
+			cglimits = NULL;
 			n->name = strdup(strsep(&a, " \t"));
 			n->cmdline = strdup(a);
 			n->next = NULL;
@@ -1209,6 +1350,7 @@ static struct collection *get_collection(char *file, int optind, int argc,
 		a = b;
 	}
 	free(buf);
+	free(cglimits);
 
 	/* is there something on the commandline to be counted? */
 	if (optind < argc) {
@@ -1229,6 +1371,7 @@ static struct collection *get_collection(char *file, int optind, int argc,
 		}
 		n->cmdline = strdup(workstr);
 		n->name = "cmdln";
+		n->cglimits = NULL;
 		n->next = NULL;
 		if (p) {
 			p->next = n;
@@ -1367,22 +1510,67 @@ static void write_test_start(struct tag_pgrp *running)
 static void
 write_test_end(struct tag_pgrp *running, const char *init_status,
 	       time_t exit_time, char *term_type, int stat_loc,
-	       int term_id, struct tms *tms1, struct tms *tms2)
+	       int term_id, struct tms *tms1, struct tms *tms2,
+	       const char *usage)
 {
 	if (!strcmp(reporttype, "rts")) {
 		printf
 		    ("%s\ninitiation_status=\"%s\"\nduration=%ld termination_type=%s "
-		     "termination_id=%d corefile=%s\ncutime=%d cstime=%d\n%s\n",
+		     "termination_id=%d corefile=%s\ncutime=%d cstime=%d%s\n%s\n",
 		     "<<<execution_status>>>", init_status,
 		     (long)(exit_time - running->mystime), term_type, term_id,
 		     (stat_loc & 0200) ? "yes" : "no",
 		     (int)(tms2->tms_cutime - tms1->tms_cutime),
 		     (int)(tms2->tms_cstime - tms1->tms_cstime),
-		     "<<<test_end>>>");
+		     usage, "<<<test_end>>>");
 	}
 	fflush(stdout);
 }
 
+/*
+ * Formats the resource usage of a reaped test as " key=value" pairs that
+ * are appended to the log line and to the rts execution status. The
+ * rusage covers the test process and all descendants it waited for, so
+ * orphans left in the pgrp are not accounted. Block I/O is reported in
+ * bytes (the kernel counts 512 byte units), CPU time in milliseconds.
+ */
+static void format_rusage(char *buf, size_t size, const struct rusage *ru)
+{
+	snprintf(buf, size,
+		 " maxrss=%ld majflt=%ld minflt=%ld rbytes=%lld wbytes=%lld"
+		 " nvcsw=%ld nivcsw=%ld ucpu=%lld scpu=%lld",
+		 ru->ru_maxrss, ru->ru_majflt, ru->ru_minflt,
+		 (long long)ru->ru_inblock * 512,
+		 (long long)ru->ru_oublock * 512,
+		 ru->ru_nvcsw, ru->ru_nivcsw,
+		 (long long)ru->ru_utime.tv_sec * 1000 +
+		 ru->ru_utime.tv_usec / 1000,
+		 (long long)ru->ru_stime.tv_sec * 1000 +
+		 ru->ru_stime.tv_usec / 1000);
+}
+
+static void store_result(struct tag_pgrp *running, time_t exit_time,
+			 int signaled, int term_id, const struct rusage *ru)
+{
+	struct rs_result res;
+
+	if (results.fd < 0)
+		return;
+
+	memset(&res, 0, sizeof(res));
+	res.stime = running->mystime;
+	res.dur = exit_time - running->mystime;
+	res.status = rs_classify(signaled, term_id);
+	res.exit = term_id;
+	res.signaled = signaled;
+	res.ucpu = ru->ru_utime.tv_sec * 1000 + ru->ru_utime.tv_usec / 1000;
+	res.scpu = ru->ru_stime.tv_sec * 1000 + ru->ru_stime.tv_usec / 1000;
+	res.maxrss = ru->ru_maxrss;
+
+	if (rs_append(&results, running->cmd->name, &res))
+		fprintf(stderr, "pan(%s): %s\n", panname, rs_error);
+}
+
 /* The functions below are all debugging related */
 
 static void pids_running(struct tag_pgrp *running, int keep_active)
@@ -1409,6 +1597,174 @@ static void orphans_running(struct orphan_pgrp *orphans)
 	fprintf(stderr, "\n");
 }
 
+struct coll_rank {
+	struct coll_entry *entry;
+	int class;
+	unsigned int dur;
+	int pos;
+};
+
+static int cmp_rank(const void *a, const void *b)
+{
+	const struct coll_rank *x = a, *y = b;
+
+	if (x->class != y->class)
+		return x->class - y->class;
+
+	if (x->dur != y->dur)
+		return x->dur < y->dur ? -1 : 1;
+
+	return x->pos - y->pos;
+}
+
+/*
+ * Returns the newest mtime of the command's executable and of the files it
+ * is given by path, or 0 if the executable cannot be found.
+ */
+static time_t cmd_mtime(const char *cmdline)
+{
+	char **argv, *path, *dir, *save;
+	char buf[PATH_MAX];
+	struct stat st;
+	time_t newest = 0;
+	int i;
+
+	argv = (char **)splitstr(cmdline, NULL, NULL);
+	if (!argv || !argv[0])
+		return 0;
+
+	if (strchr(argv[0], '/')) {
+		if (!stat(argv[0], &st))
+			newest = st.st_mtime;
+	} else if ((path = getenv("PATH")) && (path = strdup(path))) {
+		for (dir = strtok_r(path, ":", &save); dir;
+		     dir = strtok_r(NULL, ":", &save)) {
+			snprintf(buf, sizeof(buf), "%s/%s", dir, argv[0]);
+			if (!access(buf, X_OK) && !stat(buf, &st)) {
+				newest = st.st_mtime;
+				break;
+			}
+		}
+		free(path);
+	}
+
+	for (i = 1; newest && argv[i]; i++) {
+		if (strchr(argv[i], '/') && !stat(argv[i], &st) &&
+		    S_ISREG(st.st_mode) && st.st_mtime > newest)
+			newest = st.st_mtime;
+	}
+
+	splitstr_free((const char **)argv);
+	return newest;
+}
+
+/*
+ * A tag that kept passing on STABLE_BUILDS builds of the running kernel
+ * release is taken as unaffected by the next builds too, but only for
+ * SKIP_BUILDS builds in a row. Then it has to pass again, so a regression
+ * in it shows up at the latest SKIP_BUILDS + 1 builds later.
+ */
+#define STABLE_BUILDS 3
+#define SKIP_BUILDS 2
+
+/*
+ * Reorders the collection using the per-tag history in the results store:
+ * tags that failed last come first, then tags that failed or flipped in
+ * their recent history, then tags never seen before, all of them shortest
+ * first, and then the rest in command-file order. With skip_unaffected the
+ * tags without failures in their history that passed on this very kernel
+ * build, or on STABLE_BUILDS builds of this kernel release and not more
+ * than SKIP_BUILDS builds ago, are dropped unless their executable changed
+ * since the last pass. Only the results of this host are taken into
+ * account.
+ *
+ * Returns 1 if nothing is left to run.
+ */
+static int order_by_history(struct collection *coll, const char *store,
+			    int skip_unaffected, int quiet_mode)
+{
+	unsigned int cnt[4] = {0, 0, 0, 0}, flaky = 0, skipped = 0;
+	struct coll_rank *rank;
+	struct rs_history h;
+	struct rs_store st;
+	struct utsname uts;
+	uint64_t host, release, build;
+	int i, n = 0;
+	time_t mtime;
+
+	if (rs_load(&st, store)) {
+		/* No history yet, e.g. the first run */
+		if (!quiet_mode)
+			printf("pan(%s): %s, keeping the command-file order\n",
+			       panname, rs_error);
+		return 0;
+	}
+
+	uname(&uts);
+	host = rs_hash(uts.nodename);
+	release = rs_hash(uts.release);
+	build = rs_hash(uts.version);
+
+	rank = malloc(coll->cnt * sizeof(*rank));
+	if (!rank) {
+		fprintf(stderr, "pan(%s): Failed to allocate memory: %s\n",
+			panname, strerror(errno));
+		exit(2);
+	}
+
+	for (i = 0; i < coll->cnt; i++) {
+		rs_history(&st, coll->ary[i]->name, host, release, build, &h);
+
+		if (h.flips >= 2)
+			flaky++;
+
+		if (h.last == RS_FAIL || h.last == RS_BROK)
+			rank[n].class = 0;
+		else if (h.fails || h.flips)
+			rank[n].class = 1;
+		else if (!h.results)
+			rank[n].class = 2;
+		else
+			rank[n].class = 3;
+
+		if (skip_unaffected && rank[n].class == 3 && h.last_ok &&
+		    (h.ok_build || (h.ok_builds >= STABLE_BUILDS &&
+				    h.builds_since_ok < SKIP_BUILDS))) {
+			mtime = cmd_mtime(coll->ary[i]->cmdline);
+			/* stime has a one second resolution, be conservative */
+			if (mtime && mtime < h.last_ok) {
+				skipped++;
+				continue;
+			}
+		}
+
+		rank[n].entry = coll->ary[i];
+		rank[n].dur = rank[n].class < 3 ? h.dur : 0;
+		rank[n].pos = i;
+		cnt[rank[n].class]++;
+		n++;
+	}
+
+	qsort(rank, n, sizeof(*rank), cmp_rank);
+	for (i = 0; i < n; i++)
+		coll->ary[i] = rank[i].entry;
+	coll->cnt = n;
+
+	free(rank);
+	rs_free(&st);
+
+	if (!quiet_mode) {
+		printf("pan(%s): running %u failing, %u recently failing "
+		       "(%u flaky), %u new, %u passing tags",
+		       panname, cnt[0], cnt[1], flaky, cnt[2], cnt[3]);
+		if (skip_unaffected)
+			printf(", %u skipped as unaffected", skipped);
+		printf("\n");
+	}
+
+	return !n;
+}
+
 static void dump_coll(struct collection *coll)
 {
 	int i;
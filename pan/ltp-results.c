@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 2016 Linux Test Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Queries the results store written by ltp-pan -R.
+ *
+ *   ltp-results store runs
+ *   ltp-results [-r run] [-t tag] [-k kernel] [-s status] store show
+ *   ltp-results [-a] store diff run-a run-b
+ *
+ * A run is given by its number in the "runs" listing, by a prefix of its
+ * id, or as "last" or "prev".
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "results.h"
+
+struct tag_status {
+	uint64_t tag;
+	unsigned int status;
+};
+
+static void usage(const char *progname)
+{
+	fprintf(stderr,
+		"usage: %s store runs\n"
+		"       %s [-r run] [-t tag] [-k kernel] [-s status] store show\n"
+		"       %s [-a] store diff run-a run-b\n"
+		"  -a  also list tags that ran in only one of the runs\n",
+		progname, progname, progname);
+	exit(2);
+}
+
+static struct rs_run *find_run(struct rs_store *st, const char *spec)
+{
+	struct rs_run *run = NULL;
+	char id[17];
+	unsigned int i;
+	char *end;
+	long n;
+
+	if (!strcmp(spec, "last"))
+		return st->nruns ? &st->runs[st->nruns - 1] : NULL;
+
+	if (!strcmp(spec, "prev"))
+		return st->nruns > 1 ? &st->runs[st->nruns - 2] : NULL;
+
+	n = strtol(spec, &end, 10);
+	if (!*end && n > 0 && (unsigned long)n <= st->nruns)
+		return &st->runs[n - 1];
+
+	for (i = 0; i < st->nruns; i++) {
+		snprintf(id, sizeof(id), "%016" PRIx64, st->runs[i].run);
+		if (!strncmp(id, spec, strlen(spec))) {
+			if (run) {
+				fprintf(stderr, "ltp-results: run '%s' is "
+					"ambiguous\n", spec);
+				exit(2);
+			}
+			run = &st->runs[i];
+		}
+	}
+
+	return run;
+}
+
+static struct rs_run *get_run(struct rs_store *st, const char *spec)
+{
+	struct rs_run *run = find_run(st, spec);
+
+	if (!run) {
+		fprintf(stderr, "ltp-results: no run '%s'\n", spec);
+		exit(2);
+	}
+
+	return run;
+}
+
+static const char *fmt_time(int64_t t)
+{
+	static char buf[32];
+	time_t tt = t;
+	struct tm tm;
+
+	strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M", localtime_r(&tt, &tm));
+	return buf;
+}
+
+static void cmd_runs(struct rs_store *st)
+{
+	unsigned int cnt[RS_NSTATUS];
+	struct rs_run *run;
+	unsigned int i, s;
+	int r;
+
+	for (i = 0; i < st->nruns; i++) {
+		run = &st->runs[i];
+		memset(cnt, 0, sizeof(cnt));
+
+		for (r = rs_first_by_run(st, run->run); r >= 0;
+		     r = st->run_next[r])
+			cnt[st->res[r]->status]++;
+
+		printf("%4u %.8" PRIx64 " %s %-12s %-16s %-24s", i + 1,
+		       run->run >> 32, fmt_time(run->start),
+		       rs_str(st, run->name), rs_str(st, run->host),
+		       rs_str(st, run->kernel));
+		for (s = 0; s < RS_NSTATUS; s++)
+			printf(" %s=%u", rs_status_name(s), cnt[s]);
+		printf("\n");
+	}
+}
+
+/* Follows an index list, or the whole store when next is NULL */
+static int next_result(struct rs_store *st, int *next, int i)
+{
+	if (next)
+		return next[i];
+
+	return i + 1 < (int)st->nres ? i + 1 : -1;
+}
+
+static void cmd_show(struct rs_store *st, const char *run_spec,
+		     const char *tag, const char *kernel, int status)
+{
+	uint64_t run_id = 0, tag_id = 0, kernel_id = 0;
+	struct rs_result *r;
+	int i, *next;
+
+	if (run_spec)
+		run_id = get_run(st, run_spec)->run;
+	if (tag)
+		tag_id = rs_hash(tag);
+	if (kernel)
+		kernel_id = rs_hash(kernel);
+
+	/* Walk the most selective index, filter by the rest */
+	if (run_spec) {
+		i = rs_first_by_run(st, run_id);
+		next = st->run_next;
+	} else if (tag) {
+		i = rs_first_by_tag(st, tag_id);
+		next = st->tag_next;
+	} else if (kernel) {
+		i = rs_first_by_kernel(st, kernel_id);
+		next = st->kernel_next;
+	} else if (status >= 0) {
+		i = st->by_status[status];
+		next = st->status_next;
+	} else {
+		i = st->nres ? 0 : -1;
+		next = NULL;
+	}
+
+	for (; i >= 0; i = next_result(st, next, i)) {
+		r = st->res[i];
+
+		if ((run_spec && r->run != run_id) ||
+		    (tag && r->tag != tag_id) ||
+		    (kernel && r->kernel != kernel_id) ||
+		    (status >= 0 && r->status != (unsigned int)status))
+			continue;
+
+		printf("%-30s %s %-8s %3d %6us %.8" PRIx64 " %s\n",
+		       rs_str(st, r->tag), rs_status_name(r->status),
+		       r->signaled ? "signaled" : "exited", r->exit, r->dur,
+		       r->run >> 32, rs_str(st, r->kernel));
+	}
+}
+
+static int cmp_tag_status(const void *a, const void *b)
+{
+	const struct tag_status *x = a, *y = b;
+
+	if (x->tag != y->tag)
+		return x->tag < y->tag ? -1 : 1;
+
+	return 0;
+}
+
+/*
+ * Collects the tags of a run sorted by hash, folding repeated runs of a
+ * tag into the worst status.
+ */
+static struct tag_status *run_tags(struct rs_store *st, struct rs_run *run,
+				   size_t *cnt)
+{
+	struct tag_status *ts = NULL;
+	size_t n = 0, size = 0, i, j;
+	int r;
+
+	for (r = rs_first_by_run(st, run->run); r >= 0; r = st->run_next[r]) {
+		if (n == size) {
+			size = size ? size * 2 : 1024;
+			ts = realloc(ts, size * sizeof(*ts));
+			if (!ts) {
+				fprintf(stderr, "ltp-results: out of memory\n");
+				exit(2);
+			}
+		}
+		ts[n].tag = st->res[r]->tag;
+		ts[n++].status = st->res[r]->status;
+	}
+
+	if (!n) {
+		*cnt = 0;
+		return ts;
+	}
+
+	qsort(ts, n, sizeof(*ts), cmp_tag_status);
+
+	for (i = 0, j = 1; j < n; j++) {
+		if (ts[j].tag != ts[i].tag)
+			ts[++i] = ts[j];
+		else if (ts[j].status > ts[i].status)
+			ts[i].status = ts[j].status;
+	}
+
+	*cnt = i + 1;
+	return ts;
+}
+
+static int failed(unsigned int status)
+{
+	return status == RS_FAIL || status == RS_BROK;
+}
+
+static int cmd_diff(struct rs_store *st, const char *spec_a,
+		    const char *spec_b, int all)
+{
+	struct tag_status *a, *b;
+	size_t na, nb, i = 0, j = 0;
+	unsigned int regressed = 0, fixed = 0, changed = 0, added = 0, gone = 0;
+
+	a = run_tags(st, get_run(st, spec_a), &na);
+	b = run_tags(st, get_run(st, spec_b), &nb);
+
+	while (i < na || j < nb) {
+		if (j >= nb || (i < na && a[i].tag < b[j].tag)) {
+			gone++;
+			if (all)
+				printf("%-30s %s -> -\n", rs_str(st, a[i].tag),
+				       rs_status_name(a[i].status));
+			i++;
+		} else if (i >= na || b[j].tag < a[i].tag) {
+			added++;
+			if (all)
+				printf("%-30s - -> %s\n", rs_str(st, b[j].tag),
+				       rs_status_name(b[j].status));
+			j++;
+		} else {
+			if (a[i].status != b[j].status) {
+				if (!failed(a[i].status) && failed(b[j].status))
+					regressed++;
+				else if (failed(a[i].status) &&
+					 !failed(b[j].status))
+					fixed++;
+				else
+					changed++;
+				printf("%-30s %s -> %s\n", rs_str(st, b[j].tag),
+				       rs_status_name(a[i].status),
+				       rs_status_name(b[j].status));
+			}
+			i++;
+			j++;
+		}
+	}
+
+	printf("%u regressed, %u fixed, %u changed, %u new, %u gone\n",
+	       regressed, fixed, changed, added, gone);
+
+	free(a);
+	free(b);
+
+	return regressed ? 1 : 0;
+}
+
+static int parse_status(const char *str)
+{
+	unsigned int s;
+
+	for (s = 0; s < RS_NSTATUS; s++) {
+		if (!strcasecmp(str, rs_status_name(s)))
+			return s;
+	}
+
+	fprintf(stderr, "ltp-results: unknown status '%s'\n", str);
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *run = NULL, *tag = NULL, *kernel = NULL, *cmd;
+	struct rs_store st;
+	int status = -1, all = 0, ret = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "ak:r:s:t:h")) != -1) {
+		switch (c) {
+		case 'a':
+			all = 1;
+			break;
+		case 'k':
+			kernel = optarg;
+			break;
+		case 'r':
+			run = optarg;
+			break;
+		case 's':
+			status = parse_status(optarg);
+			break;
+		case 't':
+			tag = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (argc - optind < 2)
+		usage(argv[0]);
+
+	cmd = argv[optind + 1];
+
+	if (rs_load(&st, argv[optind])) {
+		fprintf(stderr, "ltp-results: %s\n", rs_error);
+		return 2;
+	}
+
+	if (!strcmp(cmd, "runs") && argc - optind == 2) {
+		cmd_runs(&st);
+	} else if (!strcmp(cmd, "show") && argc - optind == 2) {
+		cmd_show(&st, run, tag, kernel, status);
+	} else if (!strcmp(cmd, "diff") && argc - optind == 4) {
+		ret = cmd_diff(&st, argv[optind + 2], argv[optind + 3], all);
+	} else {
+		rs_free(&st);
+		usage(argv[0]);
+	}
+
+	rs_free(&st);
+	return ret;
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2016 Linux Test Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Compares the per-tag resource usage recorded in two ltp-pan logs (-l)
+ * and reports tags whose usage grew beyond a ratio of the baseline.
+ *
+ * Small absolute changes are ignored so that a test going from 2 to 5
+ * major faults is not reported; only growth that is both relative and
+ * above a per-metric floor is. When a tag ran several times the worst
+ * run is used on both sides.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct metric {
+	const char *key;
+	const char *unit;
+	long long floor;
+};
+
+static const struct metric metrics[] = {
+	{"dur", "s", 5},
+	{"ucpu", "ms", 500},
+	{"scpu", "ms", 500},
+	{"maxrss", "kB", 16384},
+	{"majflt", "", 100},
+	{"minflt", "", 10000},
+	{"rbytes", "B", 16 << 20},
+	{"wbytes", "B", 16 << 20},
+	{"nvcsw", "", 1000},
+	{"nivcsw", "", 1000},
+	/* Only present when ltp-pan ran the tests in cgroup leaves (-c) */
+	{"cg_ucpu", "ms", 500},
+	{"cg_scpu", "ms", 500},
+	{"cg_maxmem", "kB", 16384},
+	{"cg_rbytes", "B", 16 << 20},
+	{"cg_wbytes", "B", 16 << 20},
+	{"cg_pids", "", 32},
+};
+
+#define NMETRICS (sizeof(metrics) / sizeof(metrics[0]))
+
+struct tag_usage {
+	char *tag;
+	unsigned int runs;
+	long long val[NMETRICS];
+};
+
+struct usage_log {
+	struct tag_usage *tags;
+	size_t cnt;
+	size_t size;
+};
+
+static int cmp_tag(const void *a, const void *b)
+{
+	return strcmp(((const struct tag_usage *)a)->tag,
+		      ((const struct tag_usage *)b)->tag);
+}
+
+static void usage(const char *progname)
+{
+	fprintf(stderr,
+		"usage: %s [-r ratio] [-a] baseline.log current.log\n"
+		"  -r ratio  report growth above ratio times the baseline "
+		"(default 1.5)\n"
+		"  -a        ignore the per-metric floors\n", progname);
+	exit(2);
+}
+
+static void parse_line(char *line, struct tag_usage *t)
+{
+	char *tok, *save, *eq;
+	unsigned int i;
+
+	for (i = 0; i < NMETRICS; i++)
+		t->val[i] = -1;
+
+	for (tok = strtok_r(line, " \t\n", &save); tok;
+	     tok = strtok_r(NULL, " \t\n", &save)) {
+		eq = strchr(tok, '=');
+		if (!eq)
+			continue;
+		*eq++ = '\0';
+
+		if (!strcmp(tok, "tag")) {
+			t->tag = strdup(eq);
+			continue;
+		}
+
+		for (i = 0; i < NMETRICS; i++) {
+			if (!strcmp(tok, metrics[i].key)) {
+				t->val[i] = strtoll(eq, NULL, 10);
+				break;
+			}
+		}
+	}
+}
+
+/* Loads a pan log and folds repeated runs of a tag into their maximum. */
+static void load_log(const char *path, struct usage_log *log)
+{
+	FILE *f;
+	char line[4096];
+	struct tag_usage t;
+	size_t i, j;
+	unsigned int m;
+
+	f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "ltp-usage-cmp: %s: %s\n", path,
+			strerror(errno));
+		exit(2);
+	}
+
+	memset(log, 0, sizeof(*log));
+
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, "tag=", 4))
+			continue;
+
+		memset(&t, 0, sizeof(t));
+		parse_line(line, &t);
+		if (!t.tag)
+			continue;
+		t.runs = 1;
+
+		if (log->cnt == log->size) {
+			log->size = log->size ? log->size * 2 : 256;
+			log->tags = realloc(log->tags,
+					    log->size * sizeof(*log->tags));
+			if (!log->tags) {
+				fprintf(stderr, "ltp-usage-cmp: out of memory\n");
+				exit(2);
+			}
+		}
+		log->tags[log->cnt++] = t;
+	}
+
+	fclose(f);
+
+	if (!log->cnt)
+		return;
+
+	qsort(log->tags, log->cnt, sizeof(*log->tags), cmp_tag);
+
+	for (i = 0, j = 1; j < log->cnt; j++) {
+		struct tag_usage *a = &log->tags[i], *b = &log->tags[j];
+
+		if (strcmp(a->tag, b->tag)) {
+			log->tags[++i] = *b;
+			continue;
+		}
+
+		for (m = 0; m < NMETRICS; m++) {
+			if (b->val[m] > a->val[m])
+				a->val[m] = b->val[m];
+		}
+		a->runs++;
+		free(b->tag);
+	}
+	log->cnt = i + 1;
+}
+
+int main(int argc, char *argv[])
+{
+	struct usage_log base, cur;
+	struct tag_usage *b;
+	double ratio = 1.5;
+	int no_floor = 0;
+	unsigned int regressed = 0, compared = 0, m;
+	size_t i;
+	int c;
+
+	while ((c = getopt(argc, argv, "ar:h")) != -1) {
+		switch (c) {
+		case 'a':
+			no_floor = 1;
+			break;
+		case 'r':
+			ratio = strtod(optarg, NULL);
+			if (ratio <= 0)
+				usage(argv[0]);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (argc - optind != 2)
+		usage(argv[0]);
+
+	load_log(argv[optind], &base);
+	load_log(argv[optind + 1], &cur);
+
+	for (i = 0; i < cur.cnt; i++) {
+		b = bsearch(&cur.tags[i], base.tags, base.cnt,
+			    sizeof(*base.tags), cmp_tag);
+		if (!b)
+			continue;
+
+		compared++;
+
+		for (m = 0; m < NMETRICS; m++) {
+			long long old = b->val[m], new = cur.tags[i].val[m];
+
+			/* Missing in one of the logs, e.g. an older pan */
+			if (old < 0 || new < 0)
+				continue;
+
+			if (new <= old * ratio)
+				continue;
+
+			if (!no_floor && new - old < metrics[m].floor)
+				continue;
+
+			printf("%-30s %-7s %12lld%-2s -> %12lld%-2s",
+			       cur.tags[i].tag, metrics[m].key,
+			       old, metrics[m].unit, new, metrics[m].unit);
+			if (old)
+				printf(" x%.2f\n", (double)new / old);
+			else
+				printf(" (new)\n");
+			regressed++;
+		}
+	}
+
+	printf("%u tags compared, %u regressions (ratio %.2f)\n",
+	       compared, regressed, ratio);
+
+	return regressed ? 1 : 0;
+}
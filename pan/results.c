@@ -0,0 +1,757 @@
+/*
+ * Copyright (c) 2016 Linux Test Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Results store, see results.h for the format.
+ */
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/utsname.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "results.h"
+#include "tst_res_flags.h"
+
+char rs_error[RSELEN];
+
+/* 64-bit FNV-1a */
+uint64_t rs_hash(const char *str)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	while (*str) {
+		h ^= (unsigned char)*str++;
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+const char *rs_status_name(unsigned int status)
+{
+	static const char *const names[] = {"PASS", "CONF", "FAIL", "BROK"};
+
+	if (status >= RS_NSTATUS)
+		return "????";
+
+	return names[status];
+}
+
+enum rs_status rs_classify(int signaled, int exit_code)
+{
+	if (signaled)
+		return RS_BROK;
+
+	if (!exit_code)
+		return RS_PASS;
+
+	if (exit_code == TCONF)
+		return RS_CONF;
+
+	if (exit_code & TBROK)
+		return RS_BROK;
+
+	return RS_FAIL;
+}
+
+/*
+ * Open addressing hash map from a 64-bit hash to a pair of longs. The keys
+ * are already hashes, so the low bits are used as the bucket directly.
+ */
+struct rs_map {
+	uint64_t *keys;
+	long *val;
+	long *aux;
+	char *used;
+	size_t mask;
+	size_t cnt;
+};
+
+static struct rs_map *map_new(size_t size)
+{
+	struct rs_map *m;
+	size_t n = 64;
+
+	while (n < size * 2)
+		n <<= 1;
+
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return NULL;
+
+	m->keys = malloc(n * sizeof(*m->keys));
+	m->val = malloc(n * sizeof(*m->val));
+	m->aux = malloc(n * sizeof(*m->aux));
+	m->used = calloc(n, 1);
+	if (!m->keys || !m->val || !m->aux || !m->used) {
+		free(m->keys);
+		free(m->val);
+		free(m->aux);
+		free(m->used);
+		free(m);
+		return NULL;
+	}
+	m->mask = n - 1;
+
+	return m;
+}
+
+static void map_free(struct rs_map *m)
+{
+	if (!m)
+		return;
+
+	free(m->keys);
+	free(m->val);
+	free(m->aux);
+	free(m->used);
+	free(m);
+}
+
+static size_t map_slot(struct rs_map *m, uint64_t key)
+{
+	size_t i = key & m->mask;
+
+	while (m->used[i] && m->keys[i] != key)
+		i = (i + 1) & m->mask;
+
+	return i;
+}
+
+static long *map_get(struct rs_map *m, uint64_t key)
+{
+	size_t i = map_slot(m, key);
+
+	return m->used[i] ? &m->val[i] : NULL;
+}
+
+static int map_grow(struct rs_map *m)
+{
+	struct rs_map *n;
+	size_t i, j;
+
+	n = map_new(m->mask + 1);
+	if (!n)
+		return -1;
+
+	for (i = 0; i <= m->mask; i++) {
+		if (!m->used[i])
+			continue;
+		j = map_slot(n, m->keys[i]);
+		n->used[j] = 1;
+		n->keys[j] = m->keys[i];
+		n->val[j] = m->val[i];
+		n->aux[j] = m->aux[i];
+	}
+	n->cnt = m->cnt;
+
+	free(m->keys);
+	free(m->val);
+	free(m->aux);
+	free(m->used);
+	*m = *n;
+	free(n);
+
+	return 0;
+}
+
+/*
+ * Returns the slot for key, inserting it with val = aux = -1 if it was not
+ * there. *added tells which case it was.
+ */
+static long map_insert(struct rs_map *m, uint64_t key, int *added)
+{
+	size_t i;
+
+	if ((m->cnt + 1) * 2 > m->mask + 1 && map_grow(m))
+		return -1;
+
+	i = map_slot(m, key);
+	*added = !m->used[i];
+	if (*added) {
+		m->used[i] = 1;
+		m->keys[i] = key;
+		m->val[i] = -1;
+		m->aux[i] = -1;
+		m->cnt++;
+	}
+
+	return i;
+}
+
+/* Writer */
+
+static size_t put_string(char *buf, const char *str)
+{
+	struct rs_string *s = (struct rs_string *)buf;
+	size_t len = strlen(str) + 1;
+	size_t size = (sizeof(*s) + len + 7) & ~7UL;
+
+	memset(buf, 0, size);
+	s->hdr.type = RS_STRING;
+	s->hdr.size = size;
+	s->hash = rs_hash(str);
+	memcpy(s->str, str, len);
+
+	return size;
+}
+
+/*
+ * Appends whole records. A short write (e.g. ENOSPC) is cut off again
+ * while the lock is held, so that it cannot end up in the middle of the
+ * store once other writers append after it.
+ */
+static int write_locked(struct rs_writer *w, const void *buf, size_t len)
+{
+	ssize_t ret;
+	off_t end;
+
+	if (flock(w->fd, LOCK_EX)) {
+		snprintf(rs_error, RSELEN, "flock() failed: %s",
+			 strerror(errno));
+		return -1;
+	}
+
+	end = lseek(w->fd, 0, SEEK_END);
+	if (end < 0) {
+		snprintf(rs_error, RSELEN, "lseek() failed: %s",
+			 strerror(errno));
+		flock(w->fd, LOCK_UN);
+		return -1;
+	}
+
+	ret = write(w->fd, buf, len);
+	if (ret != (ssize_t)len) {
+		if (ret < 0) {
+			snprintf(rs_error, RSELEN, "write() failed: %s",
+				 strerror(errno));
+		} else {
+			snprintf(rs_error, RSELEN, "short write() %zi/%zu",
+				 ret, len);
+		}
+
+		if (ret > 0 && ftruncate(w->fd, end)) {
+			snprintf(rs_error + strlen(rs_error),
+				 RSELEN - strlen(rs_error),
+				 ", ftruncate() failed: %s", strerror(errno));
+		}
+	}
+
+	flock(w->fd, LOCK_UN);
+	return ret == (ssize_t)len ? 0 : -1;
+}
+
+int rs_open(struct rs_writer *w, const char *path, const char *panname)
+{
+	struct utsname uts;
+	struct rs_header hdr = {
+		.hdr = {RS_HEADER, sizeof(hdr)},
+		.magic = RS_MAGIC,
+		.version = RS_VERSION,
+	};
+	struct rs_run run = {.hdr = {RS_RUN, sizeof(run)}};
+	struct timespec ts;
+	struct stat st;
+	char id[256 + 64], name[256];
+	char buf[4 * (sizeof(struct rs_string) + 264) + sizeof(run)];
+	size_t len = 0;
+
+	memset(w, 0, sizeof(*w));
+
+	w->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (w->fd < 0) {
+		snprintf(rs_error, RSELEN, "open(%s) failed: %s",
+			 path, strerror(errno));
+		return -1;
+	}
+
+	/* Only the first writer of an empty store writes the header */
+	if (flock(w->fd, LOCK_EX) || fstat(w->fd, &st)) {
+		snprintf(rs_error, RSELEN, "cannot lock %s: %s",
+			 path, strerror(errno));
+		goto err;
+	}
+	if (!st.st_size && write(w->fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+		snprintf(rs_error, RSELEN, "write(%s) failed: %s",
+			 path, strerror(errno));
+		flock(w->fd, LOCK_UN);
+		goto err;
+	}
+	flock(w->fd, LOCK_UN);
+
+	uname(&uts);
+	clock_gettime(CLOCK_REALTIME, &ts);
+	snprintf(id, sizeof(id), "%s/%d/%ld/%ld", uts.nodename, getpid(),
+		 (long)ts.tv_sec, ts.tv_nsec);
+
+	w->run = rs_hash(id);
+	w->kernel = rs_hash(uts.release);
+
+	snprintf(name, sizeof(name), "%s", panname);
+	len += put_string(buf + len, name);
+	len += put_string(buf + len, uts.nodename);
+	len += put_string(buf + len, uts.release);
+	len += put_string(buf + len, uts.version);
+
+	run.run = w->run;
+	run.name = rs_hash(name);
+	run.host = rs_hash(uts.nodename);
+	run.kernel = w->kernel;
+	run.start = ts.tv_sec;
+	run.build = rs_hash(uts.version);
+	memcpy(buf + len, &run, sizeof(run));
+	len += sizeof(run);
+
+	if (write_locked(w, buf, len))
+		goto err;
+
+	return 0;
+err:
+	close(w->fd);
+	w->fd = -1;
+	return -1;
+}
+
+/* Returns 1 if the tag string was already written in this run */
+static int tag_seen(struct rs_writer *w, uint64_t tag)
+{
+	unsigned int i, mask;
+	uint64_t *old;
+
+	if ((w->ntags + 1) * 2 > w->tags_size) {
+		old = w->tags;
+		i = w->tags_size;
+		w->tags_size = w->tags_size ? w->tags_size * 2 : 256;
+		w->tags = calloc(w->tags_size, sizeof(*w->tags));
+		if (!w->tags) {
+			/* Writing the string again is harmless */
+			w->tags = old;
+			w->tags_size = i;
+			return 0;
+		}
+		w->ntags = 0;
+		while (i--) {
+			if (old[i])
+				tag_seen(w, old[i]);
+		}
+		free(old);
+	}
+
+	mask = w->tags_size - 1;
+	for (i = tag & mask; w->tags[i]; i = (i + 1) & mask) {
+		if (w->tags[i] == tag)
+			return 1;
+	}
+
+	w->tags[i] = tag;
+	w->ntags++;
+	return 0;
+}
+
+int rs_append(struct rs_writer *w, const char *tag, struct rs_result *res)
+{
+	char buf[sizeof(struct rs_string) + 264 + sizeof(*res)];
+	size_t len = 0;
+	char name[256];
+
+	if (w->fd < 0)
+		return 0;
+
+	snprintf(name, sizeof(name), "%s", tag);
+
+	res->hdr.type = RS_RESULT;
+	res->hdr.size = sizeof(*res);
+	res->run = w->run;
+	res->tag = rs_hash(name);
+	res->kernel = w->kernel;
+
+	if (!tag_seen(w, res->tag))
+		len += put_string(buf, name);
+
+	memcpy(buf + len, res, sizeof(*res));
+	len += sizeof(*res);
+
+	return write_locked(w, buf, len);
+}
+
+void rs_close(struct rs_writer *w)
+{
+	if (w->fd >= 0)
+		close(w->fd);
+	w->fd = -1;
+	free(w->tags);
+	w->tags = NULL;
+}
+
+/* Reader */
+
+const char *rs_str(struct rs_store *st, uint64_t hash)
+{
+	long *off = map_get(st->strings, hash);
+
+	if (!off)
+		return "?";
+
+	return ((struct rs_string *)((char *)st->base + *off))->str;
+}
+
+static int first(struct rs_map *m, uint64_t key)
+{
+	long *head = map_get(m, key);
+
+	return head ? *head : -1;
+}
+
+int rs_first_by_run(struct rs_store *st, uint64_t run)
+{
+	return first(st->by_run, run);
+}
+
+int rs_first_by_tag(struct rs_store *st, uint64_t tag)
+{
+	return first(st->by_tag, tag);
+}
+
+int rs_first_by_kernel(struct rs_store *st, uint64_t kernel)
+{
+	return first(st->by_kernel, kernel);
+}
+
+struct rs_run *rs_find_run(struct rs_store *st, uint64_t run)
+{
+	long *i = map_get(st->run_ids, run);
+
+	return i ? &st->runs[*i] : NULL;
+}
+
+static int failing(unsigned int status)
+{
+	return status == RS_FAIL || status == RS_BROK;
+}
+
+/* Adds build to the set in builds, returns the new size of the set */
+static unsigned int add_build(uint64_t *builds, unsigned int n, uint64_t build)
+{
+	unsigned int i;
+
+	for (i = 0; i < n && builds[i] != build; i++)
+		;
+
+	if (i == n && n < RS_HISTORY)
+		builds[n++] = build;
+
+	return n;
+}
+
+void rs_history(struct rs_store *st, const char *tag, uint64_t host,
+		uint64_t release, uint64_t build, struct rs_history *h)
+{
+	int ring[RS_HISTORY];
+	uint64_t builds[RS_HISTORY], later[RS_HISTORY];
+	struct rs_result *r;
+	struct rs_run *run, *ok_run = NULL;
+	unsigned int n = 0, i, dur = 0;
+	int prev = -1, k;
+
+	memset(h, 0, sizeof(*h));
+	h->last = -1;
+
+	for (k = rs_first_by_tag(st, rs_hash(tag)); k >= 0;
+	     k = st->tag_next[k]) {
+		r = st->res[k];
+
+		/* Results merged in from other machines don't count here */
+		run = rs_find_run(st, r->run);
+		if (!run || run->host != host)
+			continue;
+
+		ring[n++ % RS_HISTORY] = k;
+
+		if (!failing(r->status) && r->kernel == release) {
+			h->last_ok = r->stime;
+			ok_run = run;
+		}
+	}
+
+	if (!n)
+		return;
+
+	i = n > RS_HISTORY ? n - RS_HISTORY : 0;
+	for (; i < n; i++) {
+		r = st->res[ring[i % RS_HISTORY]];
+
+		h->results++;
+		dur += r->dur;
+		if (failing(r->status))
+			h->fails++;
+		if (prev >= 0 && failing(prev) != failing(r->status))
+			h->flips++;
+		prev = r->status;
+
+		/* Count the distinct builds of this release that passed */
+		run = rs_find_run(st, r->run);
+		if (failing(r->status) || r->kernel != release || !run->build)
+			continue;
+
+		if (run->build == build)
+			h->ok_build = 1;
+
+		h->ok_builds = add_build(builds, h->ok_builds, run->build);
+	}
+
+	h->last = prev;
+	h->dur = dur / h->results;
+
+	/*
+	 * Builds of the release run on this host after the last pass, on
+	 * which the tag has not passed since, e.g. because it was skipped.
+	 */
+	if (!ok_run)
+		return;
+
+	for (run = ok_run + 1; run < st->runs + st->nruns; run++) {
+		if (run->host != host || run->kernel != release ||
+		    !run->build || run->build == ok_run->build ||
+		    run->build == build)
+			continue;
+
+		h->builds_since_ok = add_build(later, h->builds_since_ok,
+					       run->build);
+	}
+}
+
+/* Appends result i to the list for key, keeping store order */
+static int link_result(struct rs_map *m, int *next, uint64_t key, int i)
+{
+	int added;
+	long slot;
+
+	slot = map_insert(m, key, &added);
+	if (slot < 0)
+		return -1;
+
+	if (added)
+		m->val[slot] = i;
+	else
+		next[m->aux[slot]] = i;
+	m->aux[slot] = i;
+	next[i] = -1;
+
+	return 0;
+}
+
+static void *grow(void *ptr, unsigned int *size, size_t elem)
+{
+	void *p;
+
+	*size = *size ? *size * 2 : 1024;
+	p = realloc(ptr, *size * elem);
+	if (!p)
+		free(ptr);
+
+	return p;
+}
+
+int rs_load(struct rs_store *st, const char *path)
+{
+	unsigned int runs_size = 0, res_size = 0, next_size = 0;
+	int status_tail[RS_NSTATUS];
+	struct rs_header *h;
+	struct rs_hdr *hdr;
+	struct rs_string *s;
+	struct rs_result *r;
+	struct stat sb;
+	size_t off = 0;
+	int fd, added, i;
+	long slot;
+
+	memset(st, 0, sizeof(*st));
+	for (i = 0; i < RS_NSTATUS; i++)
+		st->by_status[i] = status_tail[i] = -1;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &sb)) {
+		snprintf(rs_error, RSELEN, "%s: %s", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	st->size = sb.st_size;
+	if (st->size < sizeof(*h)) {
+		snprintf(rs_error, RSELEN, "%s: not a results store", path);
+		close(fd);
+		return -1;
+	}
+
+	st->base = mmap(NULL, st->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (st->base == MAP_FAILED) {
+		st->base = NULL;
+		snprintf(rs_error, RSELEN, "mmap(%s) failed: %s",
+			 path, strerror(errno));
+		return -1;
+	}
+
+	st->strings = map_new(1024);
+	st->run_ids = map_new(64);
+	st->by_run = map_new(64);
+	st->by_tag = map_new(1024);
+	st->by_kernel = map_new(64);
+	if (!st->strings || !st->run_ids || !st->by_run || !st->by_tag ||
+	    !st->by_kernel)
+		goto nomem;
+
+	while (off + sizeof(*hdr) <= st->size) {
+		hdr = (struct rs_hdr *)((char *)st->base + off);
+
+		/* A truncated or torn record ends the usable part */
+		if (hdr->size < sizeof(*hdr) || hdr->size % 8 ||
+		    hdr->size > st->size - off)
+			break;
+
+		if (!off && hdr->type != RS_HEADER) {
+			snprintf(rs_error, RSELEN, "%s: not a results store",
+				 path);
+			goto err;
+		}
+
+		switch (hdr->type) {
+		case RS_HEADER:
+			h = (struct rs_header *)hdr;
+			if (hdr->size < sizeof(*h) || h->magic != RS_MAGIC) {
+				snprintf(rs_error, RSELEN,
+					 "%s: bad header at %zu, wrong byte order?",
+					 path, off);
+				goto err;
+			}
+			if (h->version != RS_VERSION) {
+				snprintf(rs_error, RSELEN,
+					 "%s: store version %u, expected %u",
+					 path, h->version, RS_VERSION);
+				goto err;
+			}
+			break;
+		case RS_STRING:
+			s = (struct rs_string *)hdr;
+			if (hdr->size <= sizeof(*s) ||
+			    ((char *)hdr)[hdr->size - 1] != '\0')
+				break;
+			slot = map_insert(st->strings, s->hash, &added);
+			if (slot < 0)
+				goto nomem;
+			if (added)
+				st->strings->val[slot] = off;
+			break;
+		case RS_RUN:
+			if (hdr->size < sizeof(struct rs_run))
+				break;
+			if (st->nruns == runs_size) {
+				st->runs = grow(st->runs, &runs_size,
+						sizeof(*st->runs));
+				if (!st->runs)
+					goto nomem;
+			}
+			st->runs[st->nruns] = *(struct rs_run *)hdr;
+			slot = map_insert(st->run_ids, st->runs[st->nruns].run,
+					  &added);
+			if (slot < 0)
+				goto nomem;
+			st->run_ids->val[slot] = st->nruns++;
+			break;
+		case RS_RESULT:
+			r = (struct rs_result *)hdr;
+			if (hdr->size < sizeof(*r) || r->status >= RS_NSTATUS)
+				break;
+			if (st->nres == res_size) {
+				st->res = grow(st->res, &res_size,
+					       sizeof(*st->res));
+				if (!st->res)
+					goto nomem;
+			}
+			if (st->nres == next_size) {
+				unsigned int sz = next_size;
+
+				st->run_next = grow(st->run_next, &sz,
+						    sizeof(int));
+				sz = next_size;
+				st->tag_next = grow(st->tag_next, &sz,
+						    sizeof(int));
+				sz = next_size;
+				st->kernel_next = grow(st->kernel_next, &sz,
+						       sizeof(int));
+				st->status_next = grow(st->status_next,
+						       &next_size, sizeof(int));
+				if (!st->run_next || !st->tag_next ||
+				    !st->kernel_next || !st->status_next)
+					goto nomem;
+			}
+
+			i = st->nres++;
+			st->res[i] = r;
+
+			if (link_result(st->by_run, st->run_next, r->run, i) ||
+			    link_result(st->by_tag, st->tag_next, r->tag, i) ||
+			    link_result(st->by_kernel, st->kernel_next,
+					r->kernel, i))
+				goto nomem;
+
+			if (status_tail[r->status] < 0)
+				st->by_status[r->status] = i;
+			else
+				st->status_next[status_tail[r->status]] = i;
+			status_tail[r->status] = i;
+			st->status_next[i] = -1;
+			break;
+		}
+
+		off += hdr->size;
+	}
+
+	return 0;
+nomem:
+	snprintf(rs_error, RSELEN, "%s: out of memory", path);
+err:
+	rs_free(st);
+	return -1;
+}
+
+void rs_free(struct rs_store *st)
+{
+	if (st->base)
+		munmap(st->base, st->size);
+
+	map_free(st->strings);
+	map_free(st->run_ids);
+	map_free(st->by_run);
+	map_free(st->by_tag);
+	map_free(st->by_kernel);
+	free(st->runs);
+	free(st->res);
+	free(st->run_next);
+	free(st->tag_next);
+	free(st->kernel_next);
+	free(st->status_next);
+	memset(st, 0, sizeof(*st));
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2016 Linux Test Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Binary results store written by ltp-pan -R and read by ltp-results.
+ *
+ * The store is a sequence of 8 byte aligned records, each starting with
+ * struct rs_hdr. Writers only ever append whole records under flock(), so
+ * several ltp-pan instances may share one store and a crash can at worst
+ * leave a truncated last record, which readers ignore. Strings (tags,
+ * kernel releases, host names) are written once per run and referenced by
+ * their 64-bit hash. Records of unknown type are skipped, and stores of
+ * several machines can be merged with cat(1).
+ *
+ * The records are in host byte order; a store from a machine of the other
+ * endianness is rejected rather than converted.
+ */
+
+#define RS_MAGIC	0x53455250544cULL	/* "LTPRES" on little endian */
+#define RS_VERSION	2
+
+enum rs_type {
+	RS_HEADER = 1,
+	RS_STRING,
+	RS_RUN,
+	RS_RESULT,
+};
+
+enum rs_status {
+	RS_PASS,
+	RS_CONF,
+	RS_FAIL,
+	RS_BROK,
+	RS_NSTATUS,
+};
+
+struct rs_hdr {
+	uint32_t type;
+	uint32_t size;		/* whole record including this header */
+};
+
+struct rs_header {
+	struct rs_hdr hdr;
+	uint64_t magic;
+	uint32_t version;
+	uint32_t pad;
+};
+
+struct rs_string {
+	struct rs_hdr hdr;
+	uint64_t hash;
+	char str[];		/* NUL terminated, padded to 8 bytes */
+};
+
+struct rs_run {
+	struct rs_hdr hdr;
+	uint64_t run;		/* unique id of this ltp-pan invocation */
+	uint64_t name;		/* ltp-pan -n tag */
+	uint64_t host;
+	uint64_t kernel;	/* uname release */
+	int64_t start;
+	uint64_t build;		/* uname version, changes with every build */
+};
+
+struct rs_result {
+	struct rs_hdr hdr;
+	uint64_t run;
+	uint64_t tag;
+	uint64_t kernel;
+	int64_t stime;
+	uint32_t dur;		/* seconds */
+	uint32_t status;	/* enum rs_status */
+	int32_t exit;		/* exit status or signal number */
+	uint32_t signaled;
+	uint32_t ucpu;		/* milliseconds */
+	uint32_t scpu;
+	uint32_t maxrss;	/* kilobytes */
+	uint32_t pad;
+};
+
+uint64_t rs_hash(const char *str);
+
+const char *rs_status_name(unsigned int status);
+
+/* rs_classify(): map a test's termination to a status */
+enum rs_status rs_classify(int signaled, int exit_code);
+
+/*
+ * Writer side, used by ltp-pan. rs_open() creates the store if needed and
+ * writes the run record, rs_append() adds one result.
+ *	both return 0 on success, -1 on error with rs_error set
+ */
+#define RSELEN 512
+extern char rs_error[RSELEN];
+
+struct rs_writer {
+	int fd;
+	uint64_t run;
+	uint64_t kernel;
+	uint64_t *tags;		/* tag hashes already written in this run */
+	unsigned int ntags;
+	unsigned int tags_size;
+};
+
+int rs_open(struct rs_writer *w, const char *path, const char *panname);
+int rs_append(struct rs_writer *w, const char *tag, struct rs_result *res);
+void rs_close(struct rs_writer *w);
+
+/*
+ * Reader side. rs_load() maps the store and builds in memory indexes by
+ * run, tag, kernel and status in a single pass over the records. Each
+ * index is a list of result numbers linked through the *_next arrays in
+ * store order; -1 terminates a list.
+ */
+struct rs_map;
+
+struct rs_store {
+	void *base;
+	size_t size;
+
+	struct rs_run *runs;	/* copies, in store order */
+	unsigned int nruns;
+
+	struct rs_result **res;
+	unsigned int nres;
+
+	struct rs_map *strings;
+	struct rs_map *run_ids;
+	struct rs_map *by_run;
+	struct rs_map *by_tag;
+	struct rs_map *by_kernel;
+	int by_status[RS_NSTATUS];
+
+	int *run_next;
+	int *tag_next;
+	int *kernel_next;
+	int *status_next;
+};
+
+int rs_load(struct rs_store *st, const char *path);
+void rs_free(struct rs_store *st);
+
+/* Returns the string for a hash or "?" when the store lacks it */
+const char *rs_str(struct rs_store *st, uint64_t hash);
+
+/* Heads of the index lists, -1 if there is no such key */
+int rs_first_by_run(struct rs_store *st, uint64_t run);
+int rs_first_by_tag(struct rs_store *st, uint64_t tag);
+int rs_first_by_kernel(struct rs_store *st, uint64_t kernel);
+
+/* Returns the run with the given id or NULL */
+struct rs_run *rs_find_run(struct rs_store *st, uint64_t run);
+
+/*
+ * Summary of the last RS_HISTORY results of a tag on host, used by
+ * ltp-pan -F to schedule failing and flaky tags first and by -U to skip
+ * stable ones. host, release and build are the hashes of the uname
+ * nodename, release and version.
+ */
+#define RS_HISTORY 10
+
+struct rs_history {
+	unsigned int results;	/* results in the window */
+	unsigned int fails;	/* FAIL or BROK results in the window */
+	unsigned int flips;	/* changes between passing and failing */
+	int last;		/* status of the last result, -1 if none */
+	unsigned int dur;	/* mean duration in the window, seconds */
+	int64_t last_ok;	/* stime of the last PASS or CONF on release */
+	int ok_build;		/* passed on this very build */
+	unsigned int ok_builds;	/* builds of release passed in the window */
+	unsigned int builds_since_ok; /* other builds of release run since */
+};
+
+void rs_history(struct rs_store *st, const char *tag, uint64_t host,
+		uint64_t release, uint64_t build, struct rs_history *h);
+
+#endif /* RESULTS_H */
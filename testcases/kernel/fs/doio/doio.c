@@ -105,6 +105,13 @@
 #define	MEMF_FILE	01000	/* regular file -- unlink on close      */
 #define	MEMF_MPIN	010000	/* use mpin(2) to lock pages in memory */
 
+/*
+ * MEM_DATA space is handed out from one buffer per power of two size
+ * class, MEM_MINCLASS << 0 up to MEM_MINCLASS << (MEM_NCLASS - 1) bytes.
+ */
+#define	MEM_MINCLASS	4096
+#define	MEM_NCLASS	19
+
 struct memalloc {
 	int memtype;
 	int flags;
@@ -113,18 +120,24 @@ struct memalloc {
 	void *space;		/* memory address of allocated space */
 	int fd;			/* FD open for mmaping */
 	int size;
+	void *classes[MEM_NCLASS];	/* MEM_DATA buffer pool */
+	void *big;		/* MEM_DATA space above the largest class */
+	int bigsize;
 } Memalloc[NMEMALLOC];
 
 /*
  * Structure for maintaining open file test descriptors.  Used by
- * alloc_fd().
+ * alloc_fd().  Entries are hashed by (c_file, c_oflags) and kept on a
+ * list in least recently used order.
  */
 
 struct fd_cache {
 	char c_file[MAX_FNAME_LENGTH + 1];
 	int c_oflags;
 	int c_fd;
-	long c_rtc;
+	struct fd_cache *c_hnext;	/* next in hash chain */
+	struct fd_cache *c_newer;	/* LRU list neighbours */
+	struct fd_cache *c_older;
 #ifdef sgi
 	int c_memalign;		/* from F_DIOINFO */
 	int c_miniosz;
@@ -225,7 +238,7 @@ struct syscall_info {
  * getopt() string of supported cmdline arguments.
  */
 
-#define OPTS	"aC:d:ehm:n:kr:w:vU:V:M:N:"
+#define OPTS	"aC:d:ehm:n:kr:w:W:vU:V:M:N:"
 
 #define DEF_RELEASE_INTERVAL	0
 
@@ -243,6 +256,7 @@ int m_opt = 0;			/* generate periodic messages       */
 int n_opt = 0;			/* nprocs                           */
 int r_opt = 0;			/* resource release interval        */
 int w_opt = 0;			/* file write log file              */
+int W_opt = 0;			/* group commit write log records   */
 int v_opt = 0;			/* verify writes if set             */
 int U_opt = 0;			/* upanic() on varios conditions    */
 int V_opt = 0;			/* over-ride default validation fd type */
@@ -258,6 +272,7 @@ int Upanic_Conditions;		/* set by args to -U                        */
 int Release_Interval;		/* arg to -r                                */
 int Nprocs;			/* arg to -n                                */
 char *Write_Log;		/* arg to -w                                */
+int Wlog_Batch;			/* arg to -W                                */
 char *Infile;			/* input file (defaults to stdin)           */
 int *Children;			/* pids of child procs                      */
 int Nchildren = 0;
@@ -292,6 +307,17 @@ int Wfd_Random;			/* for overlaying write-log entries     */
 
 #define FD_ALLOC_INCR	32	/* allocate this many fd_map structs    */
 				/* at a time */
+#define FD_HASH_SIZE	256	/* fd cache hash buckets, power of 2    */
+
+/*
+ * fd cache and MEM_DATA buffer pool counters, reported with -m
+ */
+
+unsigned long Fdc_Hits;
+unsigned long Fdc_Misses;
+unsigned long Fdc_Evictions;
+unsigned long Mem_Hits;
+unsigned long Mem_Misses;
 
 /*
  * Globals for tracking Sds and Core usage
@@ -798,6 +824,11 @@ void doio(void)
 				     Write_Log);
 			exit(E_SETUP);
 		}
+
+		if (W_opt && wlog_set_batch(&Wlog, Wlog_Batch) == -1) {
+			doio_fprintf(stderr, "%s", Wlog_Error_String);
+			exit(E_SETUP);
+		}
 	}
 
 	/*
@@ -1061,8 +1092,10 @@ void doio(void)
 
 		if (Message_Interval && Reqno % Message_Interval == 0) {
 			doio_fprintf(stderr,
-				     "Info:  %d requests done (%d skipped) by this process\n",
-				     Reqno, Reqskipcnt);
+				     "Info:  %d requests done (%d skipped) by this process\n"
+				     "Info:  fd cache %lu hits %lu misses %lu evictions, buffer pool %lu hits %lu misses\n",
+				     Reqno, Reqskipcnt, Fdc_Hits, Fdc_Misses,
+				     Fdc_Evictions, Mem_Hits, Mem_Misses);
 		}
 
 		Reqno++;
@@ -3862,9 +3895,8 @@ int doio_fprintf(FILE * stream, char *format, ...)
 #ifndef CRAY
 int alloc_mem(int nbytes)
 {
-	char *cp;
 	void *addr;
-	int me = 0, flags, key, shmid;
+	int me = 0, flags, key, shmid, c;
 	static int mturn = 0;	/* which memory type to use */
 	struct memalloc *M;
 	char filename[255];
@@ -3885,12 +3917,26 @@ int alloc_mem(int nbytes)
 
 			switch (Memalloc[me].memtype) {
 			case MEM_DATA:
+				for (c = 0; c < MEM_NCLASS; c++) {
+					if (Memalloc[me].classes[c] == NULL)
+						continue;
 #ifdef sgi
-				if (Memalloc[me].flags & MEMF_MPIN)
-					munpin(Memalloc[me].space,
-					       Memalloc[me].size);
+					if (Memalloc[me].flags & MEMF_MPIN)
+						munpin(Memalloc[me].classes[c],
+						       MEM_MINCLASS << c);
 #endif
-				free(Memalloc[me].space);
+					free(Memalloc[me].classes[c]);
+					Memalloc[me].classes[c] = NULL;
+				}
+#ifdef sgi
+				if (Memalloc[me].big != NULL &&
+				    (Memalloc[me].flags & MEMF_MPIN))
+					munpin(Memalloc[me].big,
+					       Memalloc[me].bigsize);
+#endif
+				free(Memalloc[me].big);
+				Memalloc[me].big = NULL;
+				Memalloc[me].bigsize = 0;
 				Memalloc[me].space = NULL;
 				Memptr = NULL;
 				Memsize = 0;
@@ -3943,37 +3989,74 @@ int alloc_mem(int nbytes)
 
 	switch (M->memtype) {
 	case MEM_DATA:
-		if (nbytes > M->size) {
-			if (M->space != NULL) {
+		/*
+		 * Requests are served from the smallest size class that
+		 * fits, so varying request sizes reuse buffers instead of
+		 * reallocating.  Buffers are page aligned for O_DIRECT.
+		 */
+		for (c = 0; c < MEM_NCLASS && MEM_MINCLASS << c < nbytes; c++) ;
+
+		/* Larger requests get a plain malloc()ed buffer of their own */
+		if (c == MEM_NCLASS) {
+			if (nbytes > M->bigsize) {
+				if (M->big != NULL) {
 #ifdef sgi
-				if (M->flags & MEMF_MPIN)
-					munpin(M->space, M->size);
+					if (M->flags & MEMF_MPIN)
+						munpin(M->big, M->bigsize);
 #endif
-				free(M->space);
+					free(M->big);
+				}
+				M->bigsize = 0;
+				if ((M->big = malloc(nbytes)) == NULL) {
+					doio_fprintf(stderr,
+						     "malloc(%d) failed:  %s (%d)\n",
+						     nbytes, SYSERR, errno);
+					return -1;
+				}
+#ifdef sgi
+				if (M->flags & MEMF_MPIN) {
+					if (mpin(M->big, nbytes) == -1) {
+						doio_fprintf(stderr,
+							     "mpin(0x%lx, %d) failed:  %s (%d)\n",
+							     M->big, nbytes,
+							     SYSERR, errno);
+					}
+				}
+#endif
+				M->bigsize = nbytes;
 			}
-			M->space = NULL;
-			M->size = 0;
+			M->space = M->big;
+			M->size = M->bigsize;
+			break;
 		}
 
-		if (M->space == NULL) {
-			if ((cp = malloc(nbytes)) == NULL) {
+		if (M->classes[c] == NULL) {
+			Mem_Misses++;
+			errno = posix_memalign(&addr, getpagesize(),
+					       MEM_MINCLASS << c);
+			if (errno != 0) {
 				doio_fprintf(stderr,
-					     "malloc(%d) failed:  %s (%d)\n",
-					     nbytes, SYSERR, errno);
+					     "posix_memalign(%d) failed:  %s (%d)\n",
+					     MEM_MINCLASS << c, SYSERR, errno);
 				return -1;
 			}
 #ifdef sgi
 			if (M->flags & MEMF_MPIN) {
-				if (mpin(cp, nbytes) == -1) {
+				if (mpin(addr, MEM_MINCLASS << c) == -1) {
 					doio_fprintf(stderr,
 						     "mpin(0x%lx, %d) failed:  %s (%d)\n",
-						     cp, nbytes, SYSERR, errno);
+						     addr, MEM_MINCLASS << c,
+						     SYSERR, errno);
 				}
 			}
 #endif
-			M->space = (void *)cp;
-			M->size = nbytes;
+			M->classes[c] = addr;
+		} else {
+			Mem_Hits++;
 		}
+
+		M->space = M->classes[c];
+		M->size = MEM_MINCLASS << c;
 		break;
 
 	case MEM_MMAP:
@@ -4246,10 +4329,10 @@ int alloc_sds(int nbytes)
 /*
  * Function to maintain a file descriptor cache, so that doio does not have
  * to do so many open() and close() calls.  Descriptors are stored in the
- * cache by file name, and open flags.  Each entry also has a _rtc value
- * associated with it which is used in aging.  If doio cannot open a file
- * because it already has too many open (ie. system limit hit) it will close
- * the one in the cache that has the oldest _rtc value.
+ * cache by file name, and open flags, in a hash table.  Entries are also
+ * kept on a list ordered by last use.  If doio cannot open a file because
+ * it already has too many open (ie. system limit hit) it will close the
+ * least recently used one in the cache.
  *
  * If alloc_fd() is called with a file of NULL, it will close all descriptors
  * in the cache, and free the memory in the cache.
@@ -4267,12 +4350,86 @@ int alloc_fd(char *file, int oflags)
 		return (-1);
 }
 
+static struct fd_cache *Fdc_Hash[FD_HASH_SIZE];
+static struct fd_cache *Fdc_Newest;	/* head of the LRU list */
+static struct fd_cache *Fdc_Oldest;	/* tail of the LRU list */
+static struct fd_cache *Fdc_Free;	/* unused entries, via c_hnext */
+static struct fd_cache **Fdc_Chunks;	/* FD_ALLOC_INCR entry blocks */
+static int Fdc_Nchunks;
+
+static unsigned int fdc_hash(char *file, int oflags)
+{
+	unsigned int h = oflags;
+
+	while (*file != '\0')
+		h = h * 31 + (unsigned char)*file++;
+
+	return h & (FD_HASH_SIZE - 1);
+}
+
+static void fdc_lru_unlink(struct fd_cache *cp)
+{
+	if (cp->c_newer != NULL)
+		cp->c_newer->c_older = cp->c_older;
+	else
+		Fdc_Newest = cp->c_older;
+
+	if (cp->c_older != NULL)
+		cp->c_older->c_newer = cp->c_newer;
+	else
+		Fdc_Oldest = cp->c_newer;
+}
+
+static void fdc_lru_push(struct fd_cache *cp)
+{
+	cp->c_newer = NULL;
+	cp->c_older = Fdc_Newest;
+	if (Fdc_Newest != NULL)
+		Fdc_Newest->c_newer = cp;
+	else
+		Fdc_Oldest = cp;
+	Fdc_Newest = cp;
+}
+
+/*
+ * Close the least recently used descriptor and put its entry back on the
+ * free list.  Returns -1 if the cache is empty.
+ */
+
+static int fdc_evict(void)
+{
+	struct fd_cache *cp, **hp;
+
+	if ((cp = Fdc_Oldest) == NULL)
+		return -1;
+
+	fdc_lru_unlink(cp);
+
+	for (hp = &Fdc_Hash[fdc_hash(cp->c_file, cp->c_oflags)];
+	     *hp != cp; hp = &(*hp)->c_hnext) ;
+	*hp = cp->c_hnext;
+
+	close(cp->c_fd);
+	cp->c_fd = -1;
+#ifndef CRAY
+	if (cp->c_memaddr != NULL) {
+		munmap(cp->c_memaddr, cp->c_memlen);
+		cp->c_memaddr = NULL;
+	}
+#endif
+
+	cp->c_hnext = Fdc_Free;
+	Fdc_Free = cp;
+	Fdc_Evictions++;
+
+	return 0;
+}
+
 struct fd_cache *alloc_fdcache(char *file, int oflags)
 {
-	int fd;
-	struct fd_cache *free_slot, *oldest_slot, *cp;
-	static int cache_size = 0;
-	static struct fd_cache *cache = NULL;
+	int fd, i;
+	unsigned int h;
+	struct fd_cache *cp, **chunks;
 #ifdef sgi
 	struct dioattr finfo;
 #endif
@@ -4281,64 +4438,44 @@ struct fd_cache *alloc_fdcache(char *file, int oflags)
 	 * If file is NULL, it means to free up the fd cache.
 	 */
 
-	if (file == NULL && cache != NULL) {
-		for (cp = cache; cp < &cache[cache_size]; cp++) {
-			if (cp->c_fd != -1) {
-				close(cp->c_fd);
-			}
-#ifndef CRAY
-			if (cp->c_memaddr != NULL) {
-				munmap(cp->c_memaddr, cp->c_memlen);
-			}
-#endif
-		}
+	if (file == NULL) {
+		while (fdc_evict() == 0) ;
 
-		free(cache);
-		cache = NULL;
-		cache_size = 0;
+		for (i = 0; i < Fdc_Nchunks; i++)
+			free(Fdc_Chunks[i]);
+		free(Fdc_Chunks);
+		Fdc_Chunks = NULL;
+		Fdc_Nchunks = 0;
+		Fdc_Free = NULL;
 		return 0;
 	}
 
-	free_slot = NULL;
-	oldest_slot = NULL;
-
 	/*
-	 * Look for a fd in the cache.  If one is found, return it directly.
-	 * Otherwise, when this loop exits, oldest_slot will point to the
-	 * oldest fd slot in the cache, and free_slot will point to an
-	 * unoccupied slot if there are any.
+	 * Look for a fd in the cache.  If one is found, make it the most
+	 * recently used one and return it directly.
 	 */
 
-	for (cp = cache; cp != NULL && cp < &cache[cache_size]; cp++) {
-		if (cp->c_fd != -1 &&
-		    cp->c_oflags == oflags && strcmp(cp->c_file, file) == 0) {
-#ifdef CRAY
-			cp->c_rtc = _rtc();
-#else
-			cp->c_rtc = Reqno;
-#endif
-			return cp;
-		}
-
-		if (cp->c_fd == -1) {
-			if (free_slot == NULL) {
-				free_slot = cp;
-			}
-		} else {
-			if (oldest_slot == NULL ||
-			    cp->c_rtc < oldest_slot->c_rtc) {
-				oldest_slot = cp;
+	h = fdc_hash(file, oflags);
+	for (cp = Fdc_Hash[h]; cp != NULL; cp = cp->c_hnext) {
+		if (cp->c_oflags == oflags && strcmp(cp->c_file, file) == 0) {
+			if (cp != Fdc_Newest) {
+				fdc_lru_unlink(cp);
+				fdc_lru_push(cp);
 			}
+			Fdc_Hits++;
+			return cp;
 		}
 	}
+	Fdc_Misses++;
 
 	/*
 	 * No matching file/oflags pair was found in the cache.  Attempt to
-	 * open a new fd.
+	 * open a new fd.  If we have as many open fd's as we can have,
+	 * close the least recently used ones until the open works.
 	 */
 
-	if ((fd = open(file, oflags, 0666)) < 0) {
-		if (errno != EMFILE) {
+	while ((fd = open(file, oflags, 0666)) < 0) {
+		if (errno != EMFILE || fdc_evict() == -1) {
 			doio_fprintf(stderr,
 				     "Could not open file %s with flags %#o (%s): %s (%d)\n",
 				     file, oflags, format_oflags(oflags),
@@ -4346,69 +4483,49 @@ struct fd_cache *alloc_fdcache(char *file, int oflags)
 			alloc_mem(-1);
 			exit(E_SETUP);
 		}
-
-		/*
-		 * If we get here, we have as many open fd's as we can have.
-		 * Close the oldest one in the cache (pointed to by
-		 * oldest_slot), and attempt to re-open.
-		 */
-
-		close(oldest_slot->c_fd);
-		oldest_slot->c_fd = -1;
-		free_slot = oldest_slot;
-
-		if ((fd = open(file, oflags, 0666)) < 0) {
-			doio_fprintf(stderr,
-				     "Could not open file %s with flags %#o (%s):  %s (%d)\n",
-				     file, oflags, format_oflags(oflags),
-				     SYSERR, errno);
-			alloc_mem(-1);
-			exit(E_SETUP);
-		}
 	}
 
 /*printf("alloc_fd: new file %s flags %#o fd %d\n", file, oflags, fd);*/
 
 	/*
-	 * If we get here, fd is our open descriptor.  If free_slot is NULL,
-	 * we need to grow the cache, otherwise free_slot is the slot that
-	 * should hold the fd info.
+	 * If we get here, fd is our open descriptor.  Take an entry off the
+	 * free list, allocating another block of entries if it is empty.
+	 * Blocks are never moved, so entries stay put while in use.
 	 */
 
-	if (free_slot == NULL) {
-		cache =
-		    (struct fd_cache *)realloc(cache,
-					       sizeof(struct fd_cache) *
-					       (FD_ALLOC_INCR + cache_size));
-		if (cache == NULL) {
+	if (Fdc_Free == NULL) {
+		chunks = realloc(Fdc_Chunks,
+				 sizeof(*chunks) * (Fdc_Nchunks + 1));
+		cp = malloc(sizeof(struct fd_cache) * FD_ALLOC_INCR);
+		if (chunks == NULL || cp == NULL) {
 			doio_fprintf(stderr,
 				     "Could not malloc() space for fd chace");
 			alloc_mem(-1);
 			exit(E_SETUP);
 		}
+		Fdc_Chunks = chunks;
+		Fdc_Chunks[Fdc_Nchunks++] = cp;
 
-		cache_size += FD_ALLOC_INCR;
-
-		for (cp = &cache[cache_size - FD_ALLOC_INCR];
-		     cp < &cache[cache_size]; cp++) {
-			cp->c_fd = -1;
+		for (i = 0; i < FD_ALLOC_INCR; i++) {
+			cp[i].c_fd = -1;
+			cp[i].c_hnext = Fdc_Free;
+			Fdc_Free = &cp[i];
 		}
-
-		free_slot = &cache[cache_size - FD_ALLOC_INCR];
 	}
 
+	cp = Fdc_Free;
+	Fdc_Free = cp->c_hnext;
+
 	/*
 	 * finally, fill in the cache slot info
 	 */
 
-	free_slot->c_fd = fd;
-	free_slot->c_oflags = oflags;
-	strcpy(free_slot->c_file, file);
-#ifdef CRAY
-	free_slot->c_rtc = _rtc();
-#else
-	free_slot->c_rtc = Reqno;
-#endif
+	cp->c_fd = fd;
+	cp->c_oflags = oflags;
+	strcpy(cp->c_file, file);
+	cp->c_hnext = Fdc_Hash[h];
+	Fdc_Hash[h] = cp;
+	fdc_lru_push(cp);
 
 #ifdef sgi
 	if (oflags & O_DIRECT) {
@@ -4423,16 +4540,16 @@ struct fd_cache *alloc_fdcache(char *file, int oflags)
 		finfo.d_maxiosz = 1;
 	}
 
-	free_slot->c_memalign = finfo.d_mem;
-	free_slot->c_miniosz = finfo.d_miniosz;
-	free_slot->c_maxiosz = finfo.d_maxiosz;
+	cp->c_memalign = finfo.d_mem;
+	cp->c_miniosz = finfo.d_miniosz;
+	cp->c_maxiosz = finfo.d_maxiosz;
 #endif /* sgi */
 #ifndef CRAY
-	free_slot->c_memaddr = NULL;
-	free_slot->c_memlen = 0;
+	cp->c_memaddr = NULL;
+	cp->c_memlen = 0;
 #endif
 
-	return free_slot;
+	return cp;
 }
 
 /*
@@ -5087,6 +5204,17 @@ int parse_cmdline(int argc, char **argv, char *opts)
 			w_opt++;
 			break;
 
+		case 'W':
+			Wlog_Batch = strtol(optarg, &cp, 10);
+			if (*cp != '\0' || Wlog_Batch < 1) {
+				fprintf(stderr,
+					"%s%s:  Illegal -W arg (%s):  Must be integer > 0\n",
+					Prog, TagName, optarg);
+				exit(E_USAGE);
+			}
+			W_opt++;
+			break;
+
 		case 'v':
 			v_opt++;
 			break;
@@ -5425,7 +5553,7 @@ int usage(FILE * stream)
 	}
 
 	fprintf(stream,
-		"usage%s:  %s [-aekv] [-m message_interval] [-n nprocs] [-r release_interval] [-w write_log] [-V validation_ftype] [-U upanic_cond] [infile]\n",
+		"usage%s:  %s [-aekv] [-m message_interval] [-n nprocs] [-r release_interval] [-w write_log] [-W nrecs] [-V validation_ftype] [-U upanic_cond] [infile]\n",
 		TagName, Prog);
 	return 0;
 }
@@ -5564,6 +5692,10 @@ void help(FILE * stream)
 		"\t                     write_log, and detect if a file is corrupt\n");
 	fprintf(stream,
 		"\t                     after all procs have exited.\n");
+	fprintf(stream,
+		"\t-W nrecs             Write the write_log nrecs records at a time.\n");
+	fprintf(stream,
+		"\t                     Records of a killed process may be lost.\n");
 	fprintf(stream,
 		"\t-U upanic_cond       Comma separated list of conditions that will\n");
 	fprintf(stream,
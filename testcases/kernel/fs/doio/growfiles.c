@@ -82,6 +82,8 @@
 #include <errno.h>
 #include <string.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <sys/uio.h>
 #include "dataascii.h"
 #include "random_range.h"
 #include "databin.h"
@@ -109,13 +111,17 @@ int growfile(int fd, char *file, int grow_incr, char *buf,
 int shrinkfile(int fd, char *filename, int trunc_incr,
 	       int trunc_inter, int just_trunc);
 int check_write(int fd, int cf_inter, char *filename, int mode);
-int check_file(int fd, int cf_inter, char *filename, int no_file_check);
+int check_file(int fd, int cf_inter, char *filename, int no_file_check,
+	       off_t *checked);
 int file_size(int fd);
 int lkfile(int fd, int operation, int lklevel);
 
 #ifndef linux
 int pre_alloc(int fd, long size);
 #endif /* !linux */
+static void pattern_gen(char *buf, int size, int offset);
+static int pattern_chk(char *buf, int size, int offset, char **errmsg);
+static int run_workers(int nworkers, char *reason, int *iter_cnt);
 
 extern int datapidgen(int, char *, int, int);
 extern int datapidchk(int, char *, int, int, char **);
@@ -168,6 +174,7 @@ int open_flags = O_RDWR | O_CREAT;	/* open flags */
 #endif
 
 #define MAX_FC_READ	196608	/* 4096 * 48 - 48 blocks */
+#define MAX_BATCH	1024	/* -j: max grow steps per pwritev, IOV_MAX */
 
 #define PATTERN_ASCII	1	/* repeating alphabet letter pattern */
 				/* allows multiple writers and to be checked */
@@ -232,6 +239,7 @@ int lockfile = 0;		/* if set, do file locking */
 				/* 2 = write lock around all file operations */
 
 off_t Woffset = 0;		/* offset before last write */
+off_t Toffset = -1;		/* size after last truncate, -1 if none */
 int Grow_incr = 4096;		/* sz of last write */
 int Mode = 0;			/* bitmask of write/trunc mode */
 				/* also knows if dealing with fifo */
@@ -240,6 +248,26 @@ int Alignment = 0;		/* if non word multiple, io will not be word aligned */
 int Opid = 0;			/* original pid */
 
 int Sync_with_others = 0;	/* Flag indicating to stop other if we stop before DONE */
+int Full_check_inter = -1;	/* -F: incremental file checks, every Nth full */
+off_t *Checked = NULL;		/* per file: bytes from 0 known to be good */
+int Num_workers = 0;		/* -j: worker threads, 0 means none */
+int Batch = 1;			/* -j: grows submitted per pwritev */
+
+/*
+ * Loop parameters handed from main() to the -j worker threads.
+ */
+struct worker_cfg {
+	int grow_incr;
+	int trunc_incr;
+	int trunc_inter;
+	int unlink_inter;
+	int write_check_inter;
+	int file_check_inter;
+	int no_file_check;
+	int iterations;
+	int time_iterval;
+	time_t start_time;
+} Wcfg;
 int Iter_cnt = 0;		/* contains current iteration count value */
 char TagName[40];		/* name of this growfiles (see Monster)     */
 
@@ -350,6 +378,7 @@ int main(int argc, char **argv)
 	int first_file_ind = 0;
 	int num_auto_files = 0;	/* files created by tool */
 	int seq_auto_files = 0;	/* auto files created by tool created by tool */
+	int workers_iter_cnt = 0;	/* -j: iterations done by the workers */
 	char *auto_dir = DEF_DIR;
 	char *auto_file = DEF_FILE;
 	int grow_incr = 4096;
@@ -409,7 +438,7 @@ int main(int argc, char **argv)
 	 * Process options
 	 */
 	while ((ind = getopt(argc, argv,
-			     "hB:C:c:bd:D:e:Ef:g:H:I:i:lL:n:N:O:o:pP:q:wt:r:R:s:S:T:uU:W:xy"))
+			     "hB:C:c:bd:D:e:EF:f:g:H:I:i:j:lL:n:N:O:o:pP:q:wt:r:R:s:S:T:uU:W:xy"))
 	       != EOF) {
 		switch (ind) {
 
@@ -522,6 +551,17 @@ int main(int argc, char **argv)
 			auto_file = optarg;
 			break;
 
+		case 'F':
+			if (sscanf(optarg, "%i", &Full_check_inter) != 1 ||
+			    Full_check_inter < 0) {
+				fprintf(stderr,
+					"%s%s: --F option arg invalid\n",
+					Progname, TagName);
+				usage();
+				exit(1);
+			}
+			break;
+
 		case 'g':
 			if ((ret = sscanf(optarg, "%i%c", &grow_incr, &chr)) < 1
 			    || grow_incr < 0) {
@@ -591,6 +631,17 @@ int main(int argc, char **argv)
 #endif
 			break;
 
+		case 'j':
+			if (sscanf(optarg, "%i:%i", &Num_workers, &Batch) < 1
+			    || Num_workers < 0 || Batch < 1 || Batch > MAX_BATCH) {
+				fprintf(stderr,
+					"%s%s: --j option arg invalid\n",
+					Progname, TagName);
+				usage();
+				exit(1);
+			}
+			break;
+
 		case 'l':
 			lockfile++;
 			if (lockfile > 2)
@@ -972,6 +1023,14 @@ no whole file checking will be performed!\n", Progname, TagName,
 	if (Mode & MODE_RAND_SIZE)
 		grow_incr = max_size;
 
+	if (Num_workers && (io_type || lockfile || open_flags == RANDOM_OPEN
+			    || Mode & (MODE_RAND_LSEEK | MODE_GROW_BY_LSEEK))) {
+		fprintf(stderr,
+			"%s%s: --j can not be used with -I, -l, -o random, -R or -w\n",
+			Progname, TagName);
+		exit(1);
+	}
+
 	set_sig();
 
 	Opid = getpid();
@@ -1290,6 +1349,14 @@ no whole file checking will be performed!\n", Progname, TagName,
 
 /**** end filename stuff ****/
 
+	if (Full_check_inter >= 0
+	    && (Checked = calloc(num_files, sizeof(off_t))) == NULL) {
+		fprintf(stderr, "%s%s: %d %s/%d: calloc(%d) failed: %s\n",
+			Progname, TagName, Pid, __FILE__, __LINE__,
+			(int)(num_files * sizeof(off_t)), strerror(errno));
+		exit(1);
+	}
+
 	if (time_iterval > 0) {
 		struct timeval ts;
 		gettimeofday(&ts, NULL);
@@ -1360,6 +1427,26 @@ no whole file checking will be performed!\n", Progname, TagName,
 #endif
 	}
 
+	/*
+	 * Worker threads share the files out among themselves and
+	 * replace the iteration loop below.
+	 */
+	if (Num_workers) {
+		Wcfg.grow_incr = grow_incr;
+		Wcfg.trunc_incr = trunc_incr;
+		Wcfg.trunc_inter = trunc_inter;
+		Wcfg.unlink_inter = unlink_inter;
+		Wcfg.write_check_inter = write_check_inter;
+		Wcfg.file_check_inter = file_check_inter;
+		Wcfg.no_file_check = no_file_check;
+		Wcfg.iterations = iterations;
+		Wcfg.time_iterval = time_iterval;
+		Wcfg.start_time = start_time;
+		if (run_workers(Num_workers, reason, &workers_iter_cnt))
+			handle_error();
+		stop = 1;
+	}
+
 	/*
 	 * This is the main iteration loop.
 	 * Each iteration, all files can  be opened, written to,
@@ -1495,6 +1582,10 @@ no whole file checking will be performed!\n", Progname, TagName,
 				continue;
 			}
 
+			/* what was just written has to be checked again */
+			if (Checked && Woffset < Checked[ind])
+				Checked[ind] = Woffset;
+
 			/*
 			 * check if last write is not corrupted
 			 */
@@ -1507,7 +1598,8 @@ no whole file checking will be performed!\n", Progname, TagName,
 			 * Check that whole file is not corrupted.
 			 */
 			if (check_file(fd, file_check_inter, filename,
-				       no_file_check) != 0) {
+				       no_file_check,
+				       Checked ? &Checked[ind] : NULL) != 0) {
 				handle_error();
 			}
 
@@ -1515,12 +1607,18 @@ no whole file checking will be performed!\n", Progname, TagName,
 			 * shrink file by desired amount if it is time
 			 */
 
+			Toffset = -1;
 			if (shrinkfile
 			    (fd, filename, trunc_incr, trunc_inter,
 			     Mode) != 0) {
 				handle_error();
 			}
 
+			/* recheck the block the file now ends in */
+			if (Checked && Toffset >= 0
+			    && Toffset - Toffset % BSIZE < Checked[ind])
+				Checked[ind] = Toffset - Toffset % BSIZE;
+
 			lkfile(fd, LOCK_UN, LKLVL1);	/* release lock */
 
 			if (Debug > 4)
@@ -1542,6 +1640,8 @@ no whole file checking will be performed!\n", Progname, TagName,
 					     Iter_cnt, filename);
 
 				unlink(filename);
+				if (Checked)
+					Checked[ind] = 0;
 			}
 
 			/*
@@ -1584,6 +1684,9 @@ no whole file checking will be performed!\n", Progname, TagName,
 
 	}			/* end iteration for loop */
 
+	if (Num_workers)
+		Iter_cnt = workers_iter_cnt;
+
 	if (Debug) {
 		printf("%s%s: %d %s/%d: DONE %d iterations to %d files. %s\n",
 		       Progname, TagName, Pid, __FILE__, __LINE__, Iter_cnt,
@@ -1799,6 +1902,8 @@ void usage(void)
 		Progname, TagName);
 	fprintf(stderr,
 		"[-d auto_dir][-e maxerrs][-f auto_file][-N num_files][-w][-c chk_inter][-D debug]\n");
+	fprintf(stderr,
+		"[-F full_inter][-j workers[:batch]]\n");
 	fprintf(stderr,
 		"[-s seed][-S seq_auto_files][-p][-P PANIC][-I io_type][-o open_flags][-B maxbytes]\n");
 	fprintf(stderr,
@@ -1827,6 +1932,8 @@ void help(void)
   -D debug_lvl   Specifies the debug level (default 1)\n\
   -E             Print examples and exit\n\
   -e errs        The number errors that will terminate this program (def 100)\n\
+  -F full_inter  File checks only read back data written since the last good\n\
+                 check, every full_inter'th check reads the whole file (0 never)\n\
   -f auto_file   Specifies the base filename files created. (default \"gf\")\n\
   -g grow_incr   Specfied to grow by incr for each num. (default 4096)\n\
                  grow_incr may end in b for blocks\n\
@@ -1835,6 +1942,9 @@ void help(void)
   -I io_type Specifies io type: s - sync, p - polled async, a - async (def s)\n\
 		 l - listio sync, L - listio async, r - random\n\
   -i iteration   Specfied to grow each file num times. 0 means forever (default 1)\n\
+  -j workers[:batch] Split the files among worker threads, each grow is batch\n\
+                 grow_incr writes submitted with one pwritev (def batch 1)\n\
+		 Not allowed with -I, -l, -o random, -R, -w or fifos\n\
   -l             Specfied to do file locking around write/read/trunc\n\
 		 If specified twice, file locking after open to just before close\n\
   -L time        Specfied to exit after time secs, must be used with -i.\n\
@@ -1906,6 +2016,12 @@ void prt_examples(FILE * stream)
 	fprintf(stream, "# run 30 secs: random iosize, random lseek up to eof\n\
 %s -r 1-5000 -R 0--1 -i 0 -L 30 -C 1 g_rand1 g_rand2\n\n", Progname);
 
+	fprintf(stream,
+		"# run 30 secs: 4 threads growing 16 files 8 writes at a time,\n\
+# checking new data every grow and whole files every 100th check\n\
+%s -i 0 -L 30 -g 4096 -c 1 -F 100 -j 4:8 -d dir3 -S 16 -u\n\n",
+		Progname);
+
 	fprintf(stream,
 		"# run 30 secs: grow by lseek then write single byte, trunc every 10 itervals\n\
 %s -g 5000 -wlu -i 0 -L 30 -C 1 -T 10  g_sleek1 g_lseek2\n\n",
@@ -2150,26 +2266,7 @@ int /* BUG:14136 */ growfile(int fd, char *file, int grow_incr, char *buf,
 				       (long)Woffset);
 		}
 
-		if (Pattern == PATTERN_OFFSET)
-			datapidgen(STATIC_NUM, buf, grow_incr, Woffset);
-		else if (Pattern == PATTERN_PID)
-			datapidgen(Pid, buf, grow_incr, Woffset);
-		else if (Pattern == PATTERN_ASCII)
-			dataasciigen(NULL, buf, grow_incr, Woffset);
-		else if (Pattern == PATTERN_RANDOM)
-			databingen('r', buf, grow_incr, Woffset);
-		else if (Pattern == PATTERN_ALT)
-			databingen('a', buf, grow_incr, Woffset);
-		else if (Pattern == PATTERN_CHKER)
-			databingen('c', buf, grow_incr, Woffset);
-		else if (Pattern == PATTERN_CNTING)
-			databingen('C', buf, grow_incr, Woffset);
-		else if (Pattern == PATTERN_ZEROS)
-			databingen('z', buf, grow_incr, Woffset);
-		else if (Pattern == PATTERN_ONES)
-			databingen('o', buf, grow_incr, Woffset);
-		else
-			dataasciigen(NULL, buf, grow_incr, Woffset);
+		pattern_gen(buf, grow_incr, Woffset);
 
 		if (Debug > 2)
 			printf
@@ -2468,6 +2565,7 @@ shrinkfile(int fd, char *filename, int trunc_incr, int trunc_inter,
 	}
 
 	bytes_consumed -= (cur_offset - new_offset);
+	Toffset = new_offset;
 	return 0;
 
 }				/* end of shrinkfile */
@@ -2628,26 +2726,9 @@ int check_write(int fd, int cf_inter, char *filename, int mode)
 		}
 		return 0;	/* all is well */
 
-	} else if (Pattern == PATTERN_OFFSET)
-		ret =
-		    datapidchk(STATIC_NUM, Buffer, Grow_incr, Woffset, &errmsg);
-	else if (Pattern == PATTERN_PID)
-		ret = datapidchk(Pid, Buffer, Grow_incr, Woffset, &errmsg);
-	else if (Pattern == PATTERN_ASCII)
-		ret = dataasciichk(NULL, Buffer, Grow_incr, Woffset, &errmsg);
-	else if (Pattern == PATTERN_RANDOM) ;	/* no check for random */
-	else if (Pattern == PATTERN_ALT)
-		ret = databinchk('a', Buffer, Grow_incr, Woffset, &errmsg);
-	else if (Pattern == PATTERN_CHKER)
-		ret = databinchk('c', Buffer, Grow_incr, Woffset, &errmsg);
-	else if (Pattern == PATTERN_CNTING)
-		ret = databinchk('C', Buffer, Grow_incr, Woffset, &errmsg);
-	else if (Pattern == PATTERN_ZEROS)
-		ret = databinchk('z', Buffer, Grow_incr, Woffset, &errmsg);
-	else if (Pattern == PATTERN_ONES)
-		ret = databinchk('o', Buffer, Grow_incr, Woffset, &errmsg);
-	else
-		ret = dataasciichk(NULL, Buffer, Grow_incr, Woffset, &errmsg);
+	}
+
+	ret = pattern_chk(Buffer, Grow_incr, Woffset, &errmsg);
 
 	if (ret >= 0) {
 		fprintf(stderr, "%s%s: %d %s/%d: %d CW %s in file %s\n",
@@ -2678,7 +2759,8 @@ int check_write(int fd, int cf_inter, char *filename, int mode)
 /***********************************************************************
  *
  ***********************************************************************/
-int check_file(int fd, int cf_inter, char *filename, int no_file_check)
+int check_file(int fd, int cf_inter, char *filename, int no_file_check,
+	       off_t *checked)
 {
 	int fsize;
 	static int cf_count = 0;
@@ -2687,6 +2769,7 @@ int check_file(int fd, int cf_inter, char *filename, int no_file_check)
 	int ret_val = 0;
 	int rd_cnt;
 	int rd_size;
+	int start = 0;
 	char *errmsg;
 
 	cf_count++;
@@ -2733,11 +2816,31 @@ int check_file(int fd, int cf_inter, char *filename, int no_file_check)
 		return 0;
 	}
 
+	/*
+	 * With -F only the part of the file written since the last
+	 * good check is read back, except every Full_check_inter
+	 * checks when the whole file is validated again.
+	 */
+	if (checked != NULL) {
+		if (Full_check_inter == 0 ||
+		    (cf_count / cf_inter) % Full_check_inter != 0)
+			start = *checked < fsize ? *checked : fsize;
+
+		if (start == fsize) {
+			if (Debug > 4)
+				printf
+				    ("%s: %d DEBUG5 %s/%d: No file check, nothing new since last check\n",
+				     Progname, Pid, __FILE__, __LINE__);
+			lkfile(fd, LOCK_UN, LKLVL0);
+			return 0;
+		}
+	}
+
 	if (Debug > 2)
-		printf("%s: %d DEBUG3 %s/%d: about to do file validation\n",
-		       Progname, Pid, __FILE__, __LINE__);
+		printf("%s: %d DEBUG3 %s/%d: about to do file validation from offset %d\n",
+		       Progname, Pid, __FILE__, __LINE__, start);
 
-	if (fsize > MAX_FC_READ) {
+	if (fsize - start > MAX_FC_READ) {
 		/*
 		 * read the file in MAX_FC_READ chuncks.
 		 */
@@ -2750,11 +2853,11 @@ int check_file(int fd, int cf_inter, char *filename, int no_file_check)
 			return -1;
 		}
 
-		lseek(fd, 0, SEEK_SET);
+		lseek(fd, start, SEEK_SET);
 
 		lkfile(fd, LOCK_SH, LKLVL0);	/* get lock on file before getting file size */
 
-		rd_cnt = 0;
+		rd_cnt = start;
 		while (rd_cnt < fsize) {
 			if (fsize - rd_cnt > MAX_FC_READ)
 				rd_size = MAX_FC_READ;
@@ -2781,45 +2884,7 @@ int check_file(int fd, int cf_inter, char *filename, int no_file_check)
 	        read(fd, buf, rd_size);
 ***/
 
-			if (Pattern == PATTERN_OFFSET)
-				ret =
-				    datapidchk(STATIC_NUM, buf, rd_size, rd_cnt,
-					       &errmsg);
-			else if (Pattern == PATTERN_PID)
-				ret =
-				    datapidchk(Pid, buf, rd_size, rd_cnt,
-					       &errmsg);
-			else if (Pattern == PATTERN_ASCII)
-				ret =
-				    dataasciichk(NULL, buf, rd_size, rd_cnt,
-						 &errmsg);
-			else if (Pattern == PATTERN_RANDOM) ;	/* no checks for random */
-			else if (Pattern == PATTERN_ALT)
-				ret =
-				    databinchk('a', buf, rd_size, rd_cnt,
-					       &errmsg);
-			else if (Pattern == PATTERN_CHKER)
-				ret =
-				    databinchk('c', buf, rd_size, rd_cnt,
-					       &errmsg);
-			else if (Pattern == PATTERN_CNTING)
-				ret =
-				    databinchk('C', buf, rd_size, rd_cnt,
-					       &errmsg);
-			else if (Pattern == PATTERN_ZEROS)
-				ret =
-				    databinchk('z', buf, rd_size, rd_cnt,
-					       &errmsg);
-			else if (Pattern == PATTERN_ONES)
-				ret =
-				    databinchk('o', buf, rd_size, rd_cnt,
-					       &errmsg);
-			else
-				ret =
-				    dataasciichk(NULL, buf, rd_size, rd_cnt,
-						 &errmsg);
-
-			if (ret >= 0) {
+			if (pattern_chk(buf, rd_size, rd_cnt, &errmsg) >= 0) {
 				fprintf(stderr,
 					"%s%s: %d %s/%d: %d CFp %s in file %s\n",
 					Progname, TagName, Pid, __FILE__,
@@ -2840,75 +2905,509 @@ int check_file(int fd, int cf_inter, char *filename, int no_file_check)
 		/*
 		 * Read the whole file in a single read
 		 */
-		if ((buf = malloc(fsize)) == NULL) {
+		rd_size = fsize - start;
+		if ((buf = malloc(rd_size)) == NULL) {
 			fprintf(stderr, "%s%s: %s/%d: malloc(%d) failed: %s\n",
-				Progname, TagName, __FILE__, __LINE__, fsize,
+				Progname, TagName, __FILE__, __LINE__, rd_size,
 				strerror(errno));
 			fflush(stderr);
 			return -1;
 		}
 
-		lseek(fd, 0, SEEK_SET);
+		lseek(fd, start, SEEK_SET);
 
 /****
 	    read(fd, buf, fsize);
 ****/
 #if NEWIO
 		ret =
-		    lio_read_buffer(fd, io_type, buf, fsize, SIGUSR1, &errmsg,
+		    lio_read_buffer(fd, io_type, buf, rd_size, SIGUSR1, &errmsg,
 				    0);
 #else
-		ret = read_buffer(fd, io_type, buf, fsize, 0, &errmsg);
+		ret = read_buffer(fd, io_type, buf, rd_size, 0, &errmsg);
 #endif
 
 		/* unlock the file as soon as we can */
 		lkfile(fd, LOCK_UN, LKLVL0);
 
-		if (ret != fsize) {
+		if (ret != rd_size) {
 			fprintf(stderr, "%s%s: %d %s/%d: %d CFw %s\n",
 				Progname, TagName, Pid, __FILE__, __LINE__,
 				Iter_cnt, errmsg);
 			ret_val = 1;
-		} else {
-			if (Pattern == PATTERN_OFFSET)
-				ret =
-				    datapidchk(STATIC_NUM, buf, fsize, 0,
-					       &errmsg);
-			else if (Pattern == PATTERN_PID)
-				ret = datapidchk(Pid, buf, fsize, 0, &errmsg);
-			else if (Pattern == PATTERN_ASCII)
-				ret =
-				    dataasciichk(NULL, buf, fsize, 0, &errmsg);
-			else if (Pattern == PATTERN_RANDOM) ;	/* no check for random */
-			else if (Pattern == PATTERN_ALT)
-				ret = databinchk('a', buf, fsize, 0, &errmsg);
-			else if (Pattern == PATTERN_CHKER)
-				ret = databinchk('c', buf, fsize, 0, &errmsg);
-			else if (Pattern == PATTERN_CNTING)
-				ret = databinchk('C', buf, fsize, 0, &errmsg);
-			else if (Pattern == PATTERN_ZEROS)
-				ret = databinchk('z', buf, fsize, 0, &errmsg);
-			else if (Pattern == PATTERN_ONES)
-				ret = databinchk('o', buf, fsize, 0, &errmsg);
-			else
-				ret =
-				    dataasciichk(NULL, buf, fsize, 0, &errmsg);
+		} else if (pattern_chk(buf, rd_size, start, &errmsg) >= 0) {
+			fprintf(stderr,
+				"%s%s: %d %s/%d: %d CFw %s in file %s\n",
+				Progname, TagName, Pid, __FILE__,
+				__LINE__, Iter_cnt, errmsg, filename);
+			fflush(stderr);
+			ret_val = 1;
+		}
+		free(buf);
+	}
+
+	if (checked != NULL && ret_val == 0)
+		*checked = fsize;
+
+	return ret_val;
+
+}				/* end of check_file */
+
+/***********************************************************************
+ * Fill buf with size bytes of the -P pattern as it appears at offset.
+ ***********************************************************************/
+static void pattern_gen(char *buf, int size, int offset)
+{
+	if (Pattern == PATTERN_OFFSET)
+		datapidgen(STATIC_NUM, buf, size, offset);
+	else if (Pattern == PATTERN_PID)
+		datapidgen(Pid, buf, size, offset);
+	else if (Pattern == PATTERN_ASCII)
+		dataasciigen(NULL, buf, size, offset);
+	else if (Pattern == PATTERN_RANDOM)
+		databingen('r', buf, size, offset);
+	else if (Pattern == PATTERN_ALT)
+		databingen('a', buf, size, offset);
+	else if (Pattern == PATTERN_CHKER)
+		databingen('c', buf, size, offset);
+	else if (Pattern == PATTERN_CNTING)
+		databingen('C', buf, size, offset);
+	else if (Pattern == PATTERN_ZEROS)
+		databingen('z', buf, size, offset);
+	else if (Pattern == PATTERN_ONES)
+		databingen('o', buf, size, offset);
+	else
+		dataasciigen(NULL, buf, size, offset);
+}
 
-			if (ret >= 0) {
+/***********************************************************************
+ * Check size bytes of buf read from offset against the -P pattern.
+ * Returns the index of the first bad byte or -1 if all is well.
+ ***********************************************************************/
+static int pattern_chk(char *buf, int size, int offset, char **errmsg)
+{
+	if (Pattern == PATTERN_OFFSET)
+		return datapidchk(STATIC_NUM, buf, size, offset, errmsg);
+	else if (Pattern == PATTERN_PID)
+		return datapidchk(Pid, buf, size, offset, errmsg);
+	else if (Pattern == PATTERN_ASCII)
+		return dataasciichk(NULL, buf, size, offset, errmsg);
+	else if (Pattern == PATTERN_RANDOM)
+		return -1;	/* no checks for random */
+	else if (Pattern == PATTERN_ALT)
+		return databinchk('a', buf, size, offset, errmsg);
+	else if (Pattern == PATTERN_CHKER)
+		return databinchk('c', buf, size, offset, errmsg);
+	else if (Pattern == PATTERN_CNTING)
+		return databinchk('C', buf, size, offset, errmsg);
+	else if (Pattern == PATTERN_ZEROS)
+		return databinchk('z', buf, size, offset, errmsg);
+	else if (Pattern == PATTERN_ONES)
+		return databinchk('o', buf, size, offset, errmsg);
+	else
+		return dataasciichk(NULL, buf, size, offset, errmsg);
+}
+
+/***********************************************************************
+ * -j worker mode.
+ *
+ * Each worker thread owns the files whose index modulo the number of
+ * workers is its id, so no file is shared and no file locking is
+ * needed.  Every pass grows a file by Batch grow steps that are
+ * submitted with a single pwritev(2), then does the write check, file
+ * check, truncation and unlink that main() would do after one step.
+ * The globals touched by handle_error() and the byte accounting are
+ * serialized with Worker_lock.
+ ***********************************************************************/
+struct worker {
+	pthread_t thread;
+	int id;
+	int nworkers;
+	char *wbuf;		/* Batch * grow_incr bytes of pattern */
+	char *rbuf;		/* MAX_FC_READ bytes for checks */
+	struct iovec *iov;	/* one entry per grow step */
+	int passes;
+	long long file_steps;	/* grow steps summed over the files */
+	long long written;
+	long long verified;
+	long writes;
+};
+
+static pthread_mutex_t Worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int Workers_stop;
+static char *Workers_reason;
+
+static void worker_error(void)
+{
+	pthread_mutex_lock(&Worker_lock);
+	handle_error();
+	pthread_mutex_unlock(&Worker_lock);
+}
+
+static void worker_halt(const char *reason)
+{
+	pthread_mutex_lock(&Worker_lock);
+	if (!Workers_stop) {
+		strcpy(Workers_reason, reason);
+		Workers_stop = 1;
+	}
+	pthread_mutex_unlock(&Worker_lock);
+}
+
+/*
+ * Read back [from, to) of filename and check it against the pattern.
+ * Returns 0 if the data is good, 1 on corruption and -1 on read errors.
+ */
+static int worker_check(struct worker *w, int fd, char *filename,
+			off_t from, off_t to, int iter, const char *tag)
+{
+	char *errmsg;
+	int rd_size;
+	int ret;
+
+	while (from < to) {
+		rd_size = to - from > MAX_FC_READ ? MAX_FC_READ : to - from;
+
+		ret = pread(fd, w->rbuf, rd_size, from);
+		if (ret != rd_size) {
+			fprintf(stderr,
+				"%s%s: %d %s/%d: %d %sr pread(%s, %d, %ld) returned %d: %s\n",
+				Progname, TagName, Pid, __FILE__, __LINE__,
+				iter, tag, filename, rd_size, (long)from, ret,
+				ret < 0 ? strerror(errno) : "short read");
+			return -1;
+		}
+
+		ret = pattern_chk(w->rbuf, rd_size, from, &errmsg);
+		if (ret >= 0) {
+			fprintf(stderr,
+				"%s%s: %d %s/%d: %d %sp %s in file %s\n",
+				Progname, TagName, Pid, __FILE__, __LINE__,
+				iter, tag, errmsg, filename);
+			fflush(stderr);
+			return 1;
+		}
+
+		w->verified += rd_size;
+		from += rd_size;
+	}
+
+	return 0;
+}
+
+/*
+ * One pass over a single file: grow, check, shrink and maybe unlink.
+ * steps is the number of grow steps to batch this time.
+ */
+static void worker_file(struct worker *w, int ind, int iter, int steps)
+{
+	char *filename = (char *)filenames + (ind * PATH_MAX);
+	struct stat stbuf;
+	char *errmsg;
+	off_t fsize, woff, start;
+	int size, total;
+	int fd, i;
+	ssize_t ret;
+
+	if ((fd = open(filename, open_flags, 0777)) == -1) {
+		fprintf(stderr,
+			"%s%s: %d %s/%d: open(%s, %#o, 0777) returned -1, errno:%d %s\n",
+			Progname, TagName, Pid, __FILE__, __LINE__, filename,
+			open_flags, errno, strerror(errno));
+		worker_error();
+		return;
+	}
+
+	if (fstat(fd, &stbuf) == -1) {
+		fprintf(stderr,
+			"%s%s: %d %s/%d: Unable to fstat(%d, &buf), errno:%d %s\n",
+			Progname, TagName, Pid, __FILE__, __LINE__, fd, errno,
+			strerror(errno));
+		worker_error();
+		close(fd);
+		return;
+	}
+
+	if (S_ISFIFO(stbuf.st_mode)) {
+		fprintf(stderr, "%s%s: %d %s/%d: --j does not support fifo %s\n",
+			Progname, TagName, Pid, __FILE__, __LINE__, filename);
+		worker_halt("Hit a fifo in worker mode.");
+		worker_error();
+		close(fd);
+		return;
+	}
+	fsize = stbuf.st_size;
+
+	/* BUG:14136 (don't go past ext2's filesize limit) */
+	if (fsize + (off_t)steps * Wcfg.grow_incr >= 2147483647) {
+		char reason[128];
+
+		sprintf(reason,
+			"Reached %ld filesize which is almost %ld limit.",
+			(long)fsize, 2147483647L);
+		worker_halt(reason);
+		close(fd);
+		return;
+	}
+
+	/*
+	 * The pattern only depends on the file offset, so the whole batch
+	 * is generated in one go and cut into grow step sized iovecs.
+	 */
+	for (i = 0, total = 0; i < steps && Wcfg.grow_incr > 0; i++) {
+		size = Wcfg.grow_incr;
+		if (Mode & MODE_RAND_SIZE) {
+			size = random_range(min_size, max_size, mult_size,
+					    &errmsg);
+			if (errmsg != NULL) {
 				fprintf(stderr,
-					"%s%s: %d %s/%d: %d CFw %s in file %s\n",
+					"%s%s: %d %s/%d: random_range() failed - %s\n",
 					Progname, TagName, Pid, __FILE__,
-					__LINE__, Iter_cnt, errmsg, filename);
-				fflush(stderr);
-				ret_val = 1;
+					__LINE__, errmsg);
+				worker_error();
+				close(fd);
+				return;
 			}
 		}
-		free(buf);
+		w->iov[i].iov_base = w->wbuf + total;
+		w->iov[i].iov_len = size;
+		total += size;
 	}
+	woff = fsize;
 
-	return ret_val;
+	if (total > 0) {
+		pattern_gen(w->wbuf, total, woff);
 
-}				/* end of check_file */
+		ret = pwritev(fd, w->iov, i, woff);
+		if (ret != total) {
+			if (ret < 0 && errno == ENOSPC) {
+				fprintf(stderr,
+					"%s%s: %d %s/%d: %d pwritev(%s, %d) hit ENOSPC\n",
+					Progname, TagName, Pid, __FILE__,
+					__LINE__, iter, filename, total);
+				cleanup();
+				exit(2);
+			}
+			fprintf(stderr,
+				"%s%s: %d %s/%d: %d pwritev(%s, %d iovecs, %d bytes, %ld) returned %ld: %s\n",
+				Progname, TagName, Pid, __FILE__, __LINE__,
+				iter, filename, i, total, (long)woff, (long)ret,
+				ret < 0 ? strerror(errno) : "short write");
+			worker_error();
+			close(fd);
+			return;
+		}
+		fsize += total;
+		w->written += total;
+		w->writes++;
+
+		pthread_mutex_lock(&Worker_lock);
+		bytes_consumed += total;
+		pthread_mutex_unlock(&Worker_lock);
+
+		if (Checked && woff < Checked[ind])
+			Checked[ind] = woff;
+	}
+
+	w->passes++;
+
+	if (total > 0 && Wcfg.write_check_inter &&
+	    w->passes % Wcfg.write_check_inter == 0 &&
+	    worker_check(w, fd, filename, woff, fsize, iter, "CW"))
+		worker_error();
+
+	if (Wcfg.file_check_inter && !Wcfg.no_file_check &&
+	    w->passes % Wcfg.file_check_inter == 0) {
+		start = 0;
+		if (Checked && (Full_check_inter == 0 ||
+				(w->passes / Wcfg.file_check_inter) %
+				Full_check_inter != 0))
+			start = Checked[ind] < fsize ? Checked[ind] : fsize;
+
+		if (worker_check(w, fd, filename, start, fsize, iter, "CF"))
+			worker_error();
+		else if (Checked)
+			Checked[ind] = fsize;
+	}
+
+	if (Wcfg.trunc_inter && w->passes % Wcfg.trunc_inter == 0) {
+		start = fsize - Wcfg.trunc_incr;
+		if (start < 0)
+			start = 0;
+
+		if (ftruncate(fd, start) == -1) {
+			fprintf(stderr,
+				"%s%s: %d %s/%d: ftruncate failed: %s\n",
+				Progname, TagName, Pid, __FILE__, __LINE__,
+				strerror(errno));
+			worker_error();
+		} else {
+			pthread_mutex_lock(&Worker_lock);
+			bytes_consumed -= fsize - start;
+			pthread_mutex_unlock(&Worker_lock);
+
+			/* recheck the block the file now ends in */
+			if (Checked && start - start % BSIZE < Checked[ind])
+				Checked[ind] = start - start % BSIZE;
+		}
+	}
+
+	close(fd);
+
+	if (Wcfg.unlink_inter && iter % Wcfg.unlink_inter == 0) {
+		if (Debug > 4)
+			printf("%s: %d DEBUG5 %s/%d: %d Unlinking file %s\n",
+			       Progname, Pid, __FILE__, __LINE__, iter,
+			       filename);
+		unlink(filename);
+		if (Checked)
+			Checked[ind] = 0;
+	}
+}
+
+static void *worker_main(void *arg)
+{
+	struct worker *w = arg;
+	struct timeval ts;
+	char reason[128];
+	int done = 0;
+	int steps;
+	int iter;
+	int ind;
+
+	for (iter = 1; !Workers_stop; iter++) {
+		/* only this worker is done, the others finish their files */
+		if (Wcfg.iterations && done >= Wcfg.iterations)
+			break;
+
+		gettimeofday(&ts, NULL);
+		if (Wcfg.time_iterval > 0
+		    && Wcfg.start_time + Wcfg.time_iterval < ts.tv_sec) {
+			sprintf(reason, "Hit time value of %d",
+				Wcfg.time_iterval);
+			worker_halt(reason);
+			break;
+		}
+
+		if (bytes_to_consume && bytes_consumed >= bytes_to_consume) {
+			sprintf(reason, "Hit bytes consumed value of %d",
+				bytes_to_consume);
+			worker_halt(reason);
+			break;
+		}
+
+		steps = Batch;
+		if (Wcfg.iterations && Wcfg.iterations - done < steps)
+			steps = Wcfg.iterations - done;
+		done += steps;
+
+		for (ind = w->id; ind < num_files && !Workers_stop;
+		     ind += w->nworkers) {
+			worker_file(w, ind, iter, steps);
+			w->file_steps += steps;
+
+			if (delaytime)
+				usleep(delaytime);
+		}
+	}
+
+	return NULL;
+}
+
+/***********************************************************************
+ * Run the -j worker threads until one of the stop conditions hits.
+ * The reason for stopping is copied to reason, the number of iterations
+ * done, counted as main() does, is stored in iter_cnt.
+ ***********************************************************************/
+static int run_workers(int nworkers, char *reason, int *iter_cnt)
+{
+	struct worker *workers;
+	struct timeval t0, t1;
+	long long written = 0, verified = 0, file_steps = 0;
+	long writes = 0;
+	double secs;
+	int i, ret, alloced;
+
+	if (nworkers > num_files)
+		nworkers = num_files;
+
+	workers = calloc(nworkers, sizeof(*workers));
+	if (workers == NULL) {
+		fprintf(stderr, "%s%s: %d %s/%d: calloc failed: %s\n",
+			Progname, TagName, Pid, __FILE__, __LINE__,
+			strerror(errno));
+		return -1;
+	}
+
+	Workers_reason = reason;
+	alloced = nworkers;
+	gettimeofday(&t0, NULL);
+
+	for (i = 0; i < nworkers; i++) {
+		struct worker *w = &workers[i];
+
+		w->id = i;
+		w->nworkers = nworkers;
+		w->iov = calloc(Batch, sizeof(struct iovec));
+		w->rbuf = malloc(MAX_FC_READ);
+		if (posix_memalign((void **)&w->wbuf, 4096,
+				   (size_t)Batch * (Wcfg.grow_incr > 0 ?
+						    Wcfg.grow_incr : 1))
+		    || w->iov == NULL || w->rbuf == NULL) {
+			fprintf(stderr,
+				"%s%s: %d %s/%d: worker %d buffer allocation failed\n",
+				Progname, TagName, Pid, __FILE__, __LINE__, i);
+			worker_halt("Worker setup failed.");
+			nworkers = i;
+			break;
+		}
+
+		ret = pthread_create(&w->thread, NULL, worker_main, w);
+		if (ret) {
+			fprintf(stderr,
+				"%s%s: %d %s/%d: pthread_create failed: %s\n",
+				Progname, TagName, Pid, __FILE__, __LINE__,
+				strerror(ret));
+			worker_halt("Worker setup failed.");
+			nworkers = i;
+			break;
+		}
+	}
+
+	for (i = 0; i < nworkers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		written += workers[i].written;
+		verified += workers[i].verified;
+		writes += workers[i].writes;
+		file_steps += workers[i].file_steps;
+	}
+
+	if (!Workers_stop)
+		strcpy(reason, "Hit iteration value");
+
+	/* iterations as main() counts them, one grow step to every file */
+	*iter_cnt = file_steps / num_files;
+
+	gettimeofday(&t1, NULL);
+	secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1e6;
+
+	if (Debug) {
+		printf("%s%s: %d %s/%d: %d workers wrote %lld bytes in %ld "
+		       "batched writes and verified %lld bytes, %.1f MB/s\n",
+		       Progname, TagName, Pid, __FILE__, __LINE__, nworkers,
+		       written, writes, verified,
+		       secs > 0 ? (written + verified) / secs / 1048576 : 0.0);
+	}
+
+	for (i = 0; i < alloced; i++) {
+		free(workers[i].wbuf);
+		free(workers[i].rbuf);
+		free(workers[i].iov);
+	}
+	free(workers);
+
+	return 0;
+}
 
 /***********************************************************************
  *
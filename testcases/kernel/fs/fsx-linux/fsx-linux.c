@@ -329,11 +329,60 @@ void report_failure(int status)
 #define short_at(cp) ((unsigned short)((*((unsigned char *)(cp)) << 8) | \
 				        *(((unsigned char *)(cp)) + 1)))
 
+/*
+ * Offset of the first byte that differs between a and b, which are known
+ * to differ somewhere in the first size bytes.  Bisecting with memcmp()
+ * keeps the search on libc's wide compare instead of a byte loop.
+ */
+unsigned first_diff(const char *a, const char *b, unsigned size)
+{
+	unsigned lo = 0, half;
+
+	while (size > sizeof(unsigned long)) {
+		half = size / 2;
+		if (memcmp(a + lo, b + lo, half) == 0) {
+			lo += half;
+			size -= half;
+		} else {
+			size = half;
+		}
+	}
+	while (a[lo] == b[lo])
+		lo++;
+	return lo;
+}
+
+/*
+ * Count the bytes that differ in the size bytes from a and b, a word at
+ * a time while the words are equal.
+ */
+unsigned count_diffs(const char *a, const char *b, unsigned size)
+{
+	unsigned long wa, wb;
+	unsigned i = 0, j, n = 0;
+
+	while (i < size) {
+		if (size - i >= sizeof(unsigned long)) {
+			memcpy(&wa, a + i, sizeof(wa));
+			memcpy(&wb, b + i, sizeof(wb));
+			if (wa == wb) {
+				i += sizeof(unsigned long);
+				continue;
+			}
+			for (j = 0; j < sizeof(unsigned long); j++, i++)
+				n += a[i] != b[i];
+			continue;
+		}
+		n += a[i] != b[i];
+		i++;
+	}
+	return n;
+}
+
 void check_buffers(unsigned offset, unsigned size)
 {
-	unsigned char c, t;
-	unsigned i = 0;
-	unsigned n = 0;
+	unsigned i;
+	unsigned n;
 	unsigned op = 0;
 	unsigned bad = 0;
 
@@ -341,33 +390,25 @@ void check_buffers(unsigned offset, unsigned size)
 		prt("READ BAD DATA: offset = 0x%x, size = 0x%x\n",
 		    offset, size);
 		prt("OFFSET\tGOOD\tBAD\tRANGE\n");
-		while (size > 0) {
-			c = good_buf[offset];
-			t = temp_buf[i];
-			if (c != t) {
-				if (n == 0) {
-					bad = short_at(&temp_buf[i]);
-					prt("%#07x\t%#06x\t%#06x", offset,
-					    short_at(&good_buf[offset]), bad);
-					op = temp_buf[offset & 1 ? i + 1 : i];
-				}
-				n++;
-				badoff = offset;
-			}
-			offset++;
-			i++;
-			size--;
-		}
-		if (n) {
-			prt("\t%#7x\n", n);
-			if (bad)
-				prt("operation# (mod 256) for the bad data"
-				    "may be %u\n", ((unsigned)op & 0xff));
-			else
-				prt("operation# (mod 256) for the bad data"
-				    "unknown, check HOLE and EXTEND ops\n");
-		} else
-			prt("????????????????\n");
+		i = first_diff(good_buf + offset, temp_buf, size);
+		bad = short_at(&temp_buf[i]);
+		prt("%#07x\t%#06x\t%#06x", offset + i,
+		    short_at(&good_buf[offset + i]), bad);
+		op = temp_buf[(offset + i) & 1 ? i + 1 : i];
+
+		n = count_diffs(good_buf + offset + i, temp_buf + i, size - i);
+		i = size;
+		while (good_buf[offset + i - 1] == temp_buf[i - 1])
+			i--;
+		badoff = offset + i - 1;
+
+		prt("\t%#7x\n", n);
+		if (bad)
+			prt("operation# (mod 256) for the bad data"
+			    "may be %u\n", ((unsigned)op & 0xff));
+		else
+			prt("operation# (mod 256) for the bad data"
+			    "unknown, check HOLE and EXTEND ops\n");
 		report_failure(110);
 	}
 }
@@ -707,8 +748,37 @@ void domapread(unsigned offset, unsigned size)
 	check_buffers(offset, size);
 }
 
+/*
+ * Every byte of a write is the op number (mod 256), odd offsets also add
+ * the original_buf byte.  The bulk is done a word at a time: the op number
+ * is broadcast into each byte and the odd bytes of original_buf are added
+ * with bytewise (carry free) arithmetic.
+ */
 void gendata(char *original_buf, char *good_buf, unsigned offset, unsigned size)
 {
+	static const unsigned char odd[8] = { 0, 0xff, 0, 0xff, 0, 0xff, 0, 0xff };
+	unsigned long lo7 = ~0UL / 0xff * 0x7f;
+	unsigned long hi = ~lo7;
+	unsigned long odd_mask, fill, orig, sum;
+
+	memcpy(&odd_mask, odd, sizeof(odd_mask));
+	memset(&fill, testcalls % 256, sizeof(fill));
+
+	while (size && offset % sizeof(unsigned long)) {
+		good_buf[offset] = testcalls % 256;
+		if (offset % 2)
+			good_buf[offset] += original_buf[offset];
+		offset++;
+		size--;
+	}
+	while (size >= sizeof(unsigned long)) {
+		memcpy(&orig, original_buf + offset, sizeof(orig));
+		orig &= odd_mask;
+		sum = ((fill & lo7) + (orig & lo7)) ^ ((fill ^ orig) & hi);
+		memcpy(good_buf + offset, &sum, sizeof(sum));
+		offset += sizeof(unsigned long);
+		size -= sizeof(unsigned long);
+	}
 	while (size--) {
 		good_buf[offset] = testcalls % 256;
 		if (offset % 2)
@@ -37,6 +37,9 @@ static inline void clean_node(unsigned long *array)
 #define KSM			3
 
 long overcommit;
+extern int oom_ramp;
+extern option_t oom_options[];
+void oom_usage(void);
 void oom(int testcase, int lite, int retcode, int allow_sigkill);
 void testoom(int mempolicy, int lite, int retcode, int allow_sigkill);
 
@@ -16,26 +16,92 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "test.h"
 #include "safe_macros.h"
 #include "mem.h"
 #include "numa_helper.h"
+#include "lapi/mmap.h"
+#include "tst_timer.h"
 
 /* OOM */
 
+int oom_ramp;
+
+option_t oom_options[] = {
+	{"r", &oom_ramp, NULL},
+	{NULL, NULL, NULL}
+};
+
+/* pages populated by all the threads of the victim, shared with the parent */
+static unsigned long *oom_pages;
+static int ramp;
+static int populate_write = 1;
+
+struct alloc_arg {
+	int testcase;
+	int node;
+};
+
+/*
+ * Faults in a whole chunk with a single call where the kernel supports
+ * it, which is much faster than touching it page by page. Older kernels
+ * fail MADV_POPULATE_WRITE with EINVAL, the following chunks are then
+ * mapped with MAP_POPULATE and only touched here.
+ *
+ * The victim's exit code is checked against ENOMEM, so a failed populate
+ * is reported as such. Where touching the pages would have raised a
+ * signal instead (EFAULT, EHWPOISON) the chunk is touched so that the
+ * victim ends the same way as without -r.
+ */
+static int populate_mem(char *s, long int length, long pagesz)
+{
+	long i;
+	int ret;
+
+	if (populate_write) {
+		do {
+			ret = madvise(s, length, MADV_POPULATE_WRITE);
+		} while (ret == -1 && errno == EINTR);
+
+		if (!ret)
+			return 0;
+
+		switch (errno) {
+		case ENOMEM:
+		case EAGAIN:
+			return ENOMEM;
+		case EINVAL:
+			populate_write = 0;
+			break;
+		}
+	}
+
+	for (i = 0; i < length; i += pagesz)
+		s[i] = '\a';
+
+	return 0;
+}
+
 static int alloc_mem(long int length, int testcase)
 {
 	char *s;
 	long i, pagesz = getpagesize();
-	int loop = 10;
+	int loop = 10, flags = MAP_ANONYMOUS | MAP_PRIVATE, ret;
+	struct timespec start, end;
+	long long us;
 
 	tst_resm(TINFO, "thread (%lx), allocating %ld bytes.",
 		(unsigned long) pthread_self(), length);
 
-	s = mmap(NULL, length, PROT_READ | PROT_WRITE,
-		 MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	if (ramp && !populate_write && testcase == NORMAL)
+		flags |= MAP_POPULATE;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	s = mmap(NULL, length, PROT_READ | PROT_WRITE, flags, -1, 0);
 	if (s == MAP_FAILED)
 		return errno;
 
@@ -52,41 +118,72 @@ static int alloc_mem(long int length, int testcase)
 	if (testcase == KSM && madvise(s, length, MADV_MERGEABLE) == -1)
 		return errno;
 #endif
-	for (i = 0; i < length; i += pagesz)
-		s[i] = '\a';
+	if (ramp && testcase != MLOCK) {
+		ret = populate_mem(s, length, pagesz);
+		if (ret)
+			return ret;
+	} else {
+		for (i = 0; i < length; i += pagesz)
+			s[i] = '\a';
+	}
+
+	if (ramp) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		us = MAX(1, tst_timespec_diff_us(end, start));
+		__sync_fetch_and_add(oom_pages, length / pagesz);
+		tst_resm(TINFO, "thread (%lx), faulted in %ld pages in %lld us "
+			 "(%lld pages/s).", (unsigned long) pthread_self(),
+			 length / pagesz, us, length / pagesz * 1000000LL / us);
+	}
 
 	return 0;
 }
 
 static void *child_alloc_thread(void *args)
 {
+	struct alloc_arg *arg = args;
 	int ret = 0;
 
+#if HAVE_NUMA_H
+	if (arg->node >= 0 && numa_run_on_node(arg->node) == -1)
+		tst_resm(TINFO | TERRNO, "numa_run_on_node(%d)", arg->node);
+#endif
+
 	/* keep allocating until there's an error */
 	while (!ret)
-		ret = alloc_mem(LENGTH, (long)args);
+		ret = alloc_mem(LENGTH, arg->testcase);
 	exit(ret);
 }
 
 static void child_alloc(int testcase, int lite, int threads)
 {
-	int i;
+	int i, num_nodes = 0, *nodes = NULL;
 	pthread_t *th;
+	struct alloc_arg *args;
 
 	if (lite) {
 		int ret = alloc_mem(TESTMEM + MB, testcase);
 		exit(ret);
 	}
 
+	/* in ramp mode spread the threads over the nodes so that each node
+	 * is filled by local faults in parallel */
+	if (ramp && get_allowed_nodes_arr(NH_MEMS | NH_CPUS, &num_nodes,
+					  &nodes) < 0)
+		num_nodes = 0;
+
 	th = malloc(sizeof(pthread_t) * threads);
-	if (!th) {
+	args = malloc(sizeof(struct alloc_arg) * threads);
+	if (!th || !args) {
 		tst_resm(TINFO | TERRNO, "malloc");
 		goto out;
 	}
 
 	for (i = 0; i < threads; i++) {
+		args[i].testcase = testcase;
+		args[i].node = num_nodes > 1 ? nodes[i % num_nodes] : -1;
 		TEST(pthread_create(&th[i], NULL, child_alloc_thread,
-			(void *)((long)testcase)));
+			&args[i]));
 		if (TEST_RETURN) {
 			tst_resm(TINFO | TRERRNO, "pthread_create");
 			/*
@@ -105,6 +202,12 @@ out:
 	exit(1);
 }
 
+void oom_usage(void)
+{
+	printf("  -r      Fault memory in with MADV_POPULATE_WRITE from threads\n"
+	       "          spread over NUMA nodes to reach OOM faster\n");
+}
+
 /*
  * oom - allocates memory according to specified testcase and checks
  *       desired outcome (e.g. child killed, operation failed with ENOMEM)
@@ -124,6 +227,22 @@ void oom(int testcase, int lite, int retcode, int allow_sigkill)
 {
 	pid_t pid;
 	int status, threads;
+	struct timespec start, end;
+	long long ms;
+
+	ramp = oom_ramp;
+	if (ramp) {
+		if (!oom_pages) {
+			oom_pages = SAFE_MMAP(cleanup, NULL, sizeof(*oom_pages),
+					      PROT_READ | PROT_WRITE,
+					      MAP_ANONYMOUS | MAP_SHARED, -1, 0);
+		}
+		*oom_pages = 0;
+		tst_resm(TINFO, "ramp mode, faulting memory in from parallel "
+			 "threads.");
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
 
 	switch (pid = fork()) {
 	case -1:
@@ -143,6 +262,14 @@ void oom(int testcase, int lite, int retcode, int allow_sigkill)
 	if (waitpid(-1, &status, 0) == -1)
 		tst_brkm(TBROK | TERRNO, cleanup, "waitpid");
 
+	if (ramp) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ms = MAX(1, tst_timespec_diff_ms(end, start));
+		tst_resm(TINFO, "victim ended after %lld ms, having faulted in "
+			 "%lu pages (%lld pages/s).", ms, *oom_pages,
+			 *oom_pages * 1000LL / ms);
+	}
+
 	if (WIFSIGNALED(status)) {
 		if (allow_sigkill && WTERMSIG(status) == SIGKILL) {
 			tst_resm(TPASS, "victim signalled: (%d) %s",
@@ -689,32 +816,16 @@ void ksm_usage(void)
 
 static void gather_node_cpus(char *cpus, long nd)
 {
-	int ncpus = 0;
+	const struct tst_cpu_topology *topo = tst_cpu_topology();
 	int i;
-	long online;
 	char buf[BUFSIZ];
-	char path[BUFSIZ], path1[BUFSIZ];
-
-	while (path_exist(PATH_SYS_SYSTEM "/cpu/cpu%d", ncpus))
-		ncpus++;
 
-	for (i = 0; i < ncpus; i++) {
-		snprintf(path, BUFSIZ,
-			 PATH_SYS_SYSTEM "/node/node%ld/cpu%d", nd, i);
-		if (path_exist(path)) {
-			snprintf(path1, BUFSIZ, "%s/online", path);
-			/*
-			 * if there is no online knob, then the cpu cannot
-			 * be taken offline
-			 */
-			if (path_exist(path1)) {
-				SAFE_FILE_SCANF(cleanup, path1, "%ld", &online);
-				if (online == 0)
-					continue;
-			}
-			sprintf(buf, "%d,", i);
-			strcat(cpus, buf);
-		}
+	/* The topology only has online CPUs */
+	for (i = 0; i < topo->ncpus; i++) {
+		if (topo->cpus[i].node != nd)
+			continue;
+		sprintf(buf, "%d,", topo->cpus[i].cpu);
+		strcat(cpus, buf);
 	}
 	/* Remove the trailing comma. */
 	cpus[strlen(cpus) - 1] = '\0';
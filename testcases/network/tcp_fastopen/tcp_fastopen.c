@@ -19,9 +19,14 @@
  *
  */
 
+#define _GNU_SOURCE
+
 #include <pthread.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -34,6 +39,7 @@
 #include "test.h"
 #include "lapi/posix_clocks.h"
 #include "safe_macros.h"
+#include "tst_hist.h"
 
 char *TCID = "tcp_fastopen";
 
@@ -48,6 +54,14 @@ static const int max_msg_len = 1500;
 #define SO_BUSY_POLL	46
 #endif
 
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT	15
+#endif
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU	49
+#endif
+
 /* TCP client requiers */
 #ifndef MSG_FASTOPEN
 #define MSG_FASTOPEN	0x20000000 /* Send data in TCP SYN */
@@ -106,12 +120,19 @@ static char *rpath		= "./tfo_result";
 static int force_run;
 static int verbose;
 
-static char *narg, *Narg, *qarg, *rarg, *Rarg, *aarg, *Targ, *barg;
+/* server with an epoll loop per CPU instead of a thread per connection */
+static int epoll_mode;
+/* connections pre-allocated for each epoll loop */
+static int pool_size		= 1024;
+
+static char *narg, *Narg, *qarg, *rarg, *Rarg, *aarg, *Targ, *barg, *sarg;
 
 static const option_t options[] = {
 	/* server params */
 	{"R:", NULL, &Rarg},
 	{"q:", NULL, &qarg},
+	{"e", &epoll_mode, NULL},
+	{"s:", NULL, &sarg},
 
 	/* client params */
 	{"H:", NULL, &server_addr},
@@ -159,6 +180,9 @@ static void help(void)
 	printf("\n          Server:\n");
 	printf("  -R x    x - num of requests, after which conn. closed\n");
 	printf("  -q x    x - server's limit on the queue of TFO requests\n");
+	printf("  -e      Run an epoll loop per CPU on SO_REUSEPORT sockets\n");
+	printf("  -s x    x - connections pre-allocated per epoll loop, "
+		"default is %d\n", pool_size);
 }
 
 /* common structure for TCP server and TCP client */
@@ -177,6 +201,63 @@ static struct addrinfo *remote_addrinfo;
 static struct addrinfo *local_addrinfo;
 static const struct linger clo = { 1, 3 };
 
+/* Latency histogram in microseconds, see tst_hist.h */
+#define LAT_HIST_BITS	4
+#define LAT_BUCKETS	TST_HIST_BUCKETS(LAT_HIST_BITS)
+
+struct lat_hist {
+	unsigned long long count;
+	unsigned long long max;
+	unsigned long long buckets[LAT_BUCKETS];
+};
+
+static void lat_record(struct lat_hist *h, const struct timespec *start)
+{
+	struct timespec now;
+	unsigned long long us;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	us = (now.tv_sec - start->tv_sec) * 1000000ULL +
+		(now.tv_nsec - start->tv_nsec) / 1000;
+
+	h->buckets[tst_hist_bucket(LAT_HIST_BITS, us)]++;
+	h->count++;
+	if (us > h->max)
+		h->max = us;
+}
+
+static void lat_merge(struct lat_hist *dst, const struct lat_hist *src)
+{
+	tst_hist_merge(LAT_HIST_BITS, dst->buckets, src->buckets);
+
+	dst->count += src->count;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+static unsigned long long lat_percentile(const struct lat_hist *h,
+					 double percent)
+{
+	return tst_hist_percentile(LAT_HIST_BITS, h->buckets, h->count, h->max,
+				   percent);
+}
+
+static void lat_report(const char *what, const struct lat_hist *h, long ms)
+{
+	if (!h->count)
+		return;
+
+	tst_resm(TINFO, "%s: %llu connections, %.0f conn/s", what, h->count,
+		h->count * 1000.0 / MAX(ms, 1));
+	tst_resm(TINFO, "%s latency (us): p50 %llu, p90 %llu, p99 %llu, "
+		"p99.9 %llu, max %llu", what, lat_percentile(h, 50),
+		lat_percentile(h, 90), lat_percentile(h, 99),
+		lat_percentile(h, 99.9), h->max);
+}
+
+/* per client thread time from connect() until the first reply */
+static struct lat_hist *client_lat;
+
 static void do_cleanup(void)
 {
 	free(client_msg);
@@ -311,13 +392,16 @@ static int client_connect_send(const char *msg, int size)
 	return cfd;
 }
 
-void *client_fn(LTP_ATTRIBUTE_UNUSED void *arg)
+void *client_fn(void *arg)
 {
 	char buf[server_msg_size];
 	int cfd, i;
 	intptr_t err = 0;
+	struct lat_hist *lat = &client_lat[(intptr_t)arg];
+	struct timespec start;
 
 	/* connect & send requests */
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	cfd = client_connect_send(client_msg, client_msg_size);
 	if (cfd == -1) {
 		err = errno;
@@ -328,6 +412,7 @@ void *client_fn(LTP_ATTRIBUTE_UNUSED void *arg)
 		err = errno;
 		goto out;
 	}
+	lat_record(lat, &start);
 
 	for (i = 1; i < client_max_requests; ++i) {
 
@@ -341,6 +426,7 @@ void *client_fn(LTP_ATTRIBUTE_UNUSED void *arg)
 			if (cfd != -1)
 				SAFE_CLOSE(cleanup, cfd);
 
+			clock_gettime(CLOCK_MONOTONIC, &start);
 			cfd = client_connect_send(client_msg, client_msg_size);
 			if (cfd == -1) {
 				err = errno;
@@ -351,6 +437,7 @@ void *client_fn(LTP_ATTRIBUTE_UNUSED void *arg)
 				err = errno;
 				break;
 			}
+			lat_record(lat, &start);
 
 			continue;
 
@@ -424,6 +511,8 @@ static void client_init(void)
 	}
 
 	thread_ids = SAFE_MALLOC(NULL, sizeof(pthread_t) * clients_num);
+	client_lat = SAFE_MALLOC(NULL, sizeof(struct lat_hist) * clients_num);
+	memset(client_lat, 0, sizeof(struct lat_hist) * clients_num);
 
 	client_msg = SAFE_MALLOC(NULL, client_msg_size);
 	memset(client_msg, client_byte, client_msg_size);
@@ -445,7 +534,8 @@ static void client_init(void)
 	clock_gettime(CLOCK_MONOTONIC_RAW, &tv_client_start);
 	int i;
 	for (i = 0; i < clients_num; ++i) {
-		if (pthread_create(&thread_ids[i], 0, client_fn, NULL) != 0) {
+		if (pthread_create(&thread_ids[i], 0, client_fn,
+		    (void *)(intptr_t)i) != 0) {
 			tst_brkm(TBROK | TERRNO, cleanup,
 				"pthread_create failed at %s:%d",
 				__FILE__, __LINE__);
@@ -472,6 +562,12 @@ static void client_run(void)
 
 	tst_resm(TINFO, "total time '%ld' ms", clnt_time);
 
+	struct lat_hist lat;
+	memset(&lat, 0, sizeof(lat));
+	for (i = 0; i < clients_num; ++i)
+		lat_merge(&lat, &client_lat[i]);
+	lat_report("client", &lat, clnt_time);
+
 	/* ask server to terminate */
 	client_msg[0] = start_fin_byte;
 	int cfd = client_connect_send(client_msg, client_msg_size);
@@ -486,6 +582,7 @@ static void client_run(void)
 static void client_cleanup(void)
 {
 	free(thread_ids);
+	free(client_lat);
 
 	if (remote_addrinfo)
 		freeaddrinfo(remote_addrinfo);
@@ -675,6 +772,458 @@ static void server_run(void)
 	}
 }
 
+/*
+ * epoll server: one event loop per CPU, each one accepting on its own
+ * SO_REUSEPORT socket and serving its connections from a pre-allocated
+ * pool, so that no thread is created per connection.
+ */
+struct conn {
+	int fd;
+	int offset;
+	int num_requests;
+	int send_msg_size;
+	/* bytes of the reply already sent, the rest waits for EPOLLOUT */
+	int sent;
+	int wait_out;
+	char *recv_msg;
+	char *send_msg;
+	struct timespec start;
+	struct conn *next;
+};
+
+struct server_loop {
+	pthread_t id;
+	int cpu;
+	int sfd;
+	int efd;
+	/* listening socket is not polled while the pool is used up */
+	int paused;
+	struct conn *pool;
+	struct conn *free_conns;
+	char *bufs;
+	unsigned long long requests;
+	struct lat_hist lat;
+};
+
+static struct server_loop *loops;
+static int loops_num;
+static struct timespec tv_server_start;
+static int server_started;
+
+/*
+ * The loops return once stop_efd is written to, so that only the main
+ * thread, after joining them, runs the cleanup that frees their state.
+ */
+static int stop_efd = -1;
+static volatile int server_stop;
+static volatile int server_failed;
+
+static void server_epoll_init(void)
+{
+	struct addrinfo hints;
+	struct epoll_event ev;
+	const int flag = 1;
+	cpu_set_t cpus;
+	int i, j, cpu;
+
+	memset(&hints, 0, sizeof(struct addrinfo));
+	hints.ai_family = AF_INET6;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if (getaddrinfo(NULL, tcp_port, &hints, &local_addrinfo) != 0)
+		tst_brkm(TBROK | TERRNO, cleanup, "getaddrinfo failed");
+
+	if (!local_addrinfo)
+		tst_brkm(TBROK, cleanup, "failed to get the address");
+
+	/* CPU numbers may have gaps, use the ones we are allowed to run on */
+	if (sched_getaffinity(0, sizeof(cpus), &cpus) == -1)
+		tst_brkm(TBROK | TERRNO, cleanup, "sched_getaffinity failed");
+
+	loops_num = CPU_COUNT(&cpus);
+	loops = SAFE_MALLOC(cleanup, sizeof(struct server_loop) * loops_num);
+	memset(loops, 0, sizeof(struct server_loop) * loops_num);
+
+	stop_efd = eventfd(0, EFD_NONBLOCK);
+	if (stop_efd == -1)
+		tst_brkm(TBROK | TERRNO, cleanup, "eventfd failed");
+
+	for (i = 0, cpu = 0; i < loops_num; ++i, ++cpu) {
+		struct server_loop *l = &loops[i];
+
+		while (!CPU_ISSET(cpu, &cpus))
+			++cpu;
+
+		l->cpu = cpu;
+		l->sfd = SAFE_SOCKET(cleanup, AF_INET6,
+			SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+		setsockopt(l->sfd, SOL_SOCKET, SO_REUSEADDR, &flag,
+			sizeof(flag));
+		if (setsockopt(l->sfd, SOL_SOCKET, SO_REUSEPORT, &flag,
+		    sizeof(flag)) == -1) {
+			tst_brkm(TCONF | TERRNO, cleanup,
+				"SO_REUSEPORT is not supported");
+		}
+		/* prefer connections handled by the CPU of this loop */
+		setsockopt(l->sfd, SOL_SOCKET, SO_INCOMING_CPU, &l->cpu,
+			sizeof(l->cpu));
+
+		SAFE_BIND(cleanup, l->sfd, local_addrinfo->ai_addr,
+			local_addrinfo->ai_addrlen);
+
+		if (fastopen_api == TFO_ENABLED) {
+			if (setsockopt(l->sfd, IPPROTO_TCP, TCP_FASTOPEN,
+			    &tfo_queue_size, sizeof(tfo_queue_size)) == -1) {
+				tst_brkm(TBROK, cleanup,
+					"Can't set TFO sock. options");
+			}
+		}
+
+		SAFE_LISTEN(cleanup, l->sfd, max_queue_len);
+
+		l->efd = epoll_create1(0);
+		if (l->efd == -1)
+			tst_brkm(TBROK | TERRNO, cleanup, "epoll_create1 failed");
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		if (epoll_ctl(l->efd, EPOLL_CTL_ADD, l->sfd, &ev) == -1)
+			tst_brkm(TBROK | TERRNO, cleanup, "epoll_ctl failed");
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = &stop_efd;
+		if (epoll_ctl(l->efd, EPOLL_CTL_ADD, stop_efd, &ev) == -1)
+			tst_brkm(TBROK | TERRNO, cleanup, "epoll_ctl failed");
+
+		l->pool = SAFE_MALLOC(cleanup, sizeof(struct conn) * pool_size);
+		l->bufs = SAFE_MALLOC(cleanup, 2 * max_msg_len * pool_size);
+		for (j = 0; j < pool_size; ++j) {
+			l->pool[j].recv_msg = l->bufs + 2 * j * max_msg_len;
+			l->pool[j].send_msg = l->pool[j].recv_msg + max_msg_len;
+			l->pool[j].next = (j + 1 < pool_size) ?
+				&l->pool[j + 1] : NULL;
+		}
+		l->free_conns = l->pool;
+	}
+
+	freeaddrinfo(local_addrinfo);
+
+	tst_resm(TINFO, "Listen with %d epoll loops on port '%s', "
+		"%d connections per loop", loops_num, tcp_port, pool_size);
+}
+
+static void server_epoll_cleanup(void)
+{
+	int i;
+
+	for (i = 0; i < loops_num; ++i) {
+		if (loops[i].sfd > 0)
+			close(loops[i].sfd);
+		if (loops[i].efd > 0)
+			close(loops[i].efd);
+		free(loops[i].pool);
+		free(loops[i].bufs);
+	}
+	free(loops);
+
+	if (stop_efd != -1)
+		close(stop_efd);
+}
+
+static void server_epoll_report(void)
+{
+	struct timespec now;
+	struct lat_hist lat;
+	unsigned long long requests = 0;
+	long ms;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (now.tv_sec - tv_server_start.tv_sec) * 1000 +
+		(now.tv_nsec - tv_server_start.tv_nsec) / 1000000;
+
+	memset(&lat, 0, sizeof(lat));
+	for (i = 0; i < loops_num; ++i) {
+		lat_merge(&lat, &loops[i].lat);
+		requests += loops[i].requests;
+	}
+
+	tst_resm(TINFO, "server: %llu requests in '%ld' ms", requests, ms);
+	lat_report("server", &lat, ms);
+}
+
+/* Tells all loops to return, failed is set if the test has failed */
+static void server_epoll_stop(int failed)
+{
+	uint64_t one = 1;
+
+	if (failed)
+		server_failed = 1;
+
+	if (__sync_lock_test_and_set(&server_stop, 1))
+		return;
+
+	/* never read, so the eventfd stays readable for every loop */
+	if (write(stop_efd, &one, sizeof(one)) != sizeof(one))
+		tst_brkm(TBROK | TERRNO, NULL, "eventfd write failed");
+}
+
+static int server_conn_ctl(struct server_loop *l, struct conn *c, int events)
+{
+	struct epoll_event ev;
+
+	ev.events = events;
+	ev.data.ptr = c;
+	if (epoll_ctl(l->efd, EPOLL_CTL_MOD, c ? c->fd : l->sfd, &ev) == -1) {
+		tst_resm(TBROK | TERRNO, "epoll_ctl failed");
+		server_epoll_stop(1);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void server_listen_ctl(struct server_loop *l, int events)
+{
+	if (!server_conn_ctl(l, NULL, events))
+		l->paused = !events;
+}
+
+static void server_conn_close(struct server_loop *l, struct conn *c)
+{
+	lat_record(&l->lat, &c->start);
+	if (close(c->fd))
+		tst_resm(TWARN | TERRNO, "close failed, sock '%d'", c->fd);
+
+	c->next = l->free_conns;
+	l->free_conns = c;
+
+	if (l->paused)
+		server_listen_ctl(l, EPOLLIN);
+}
+
+static void server_accept(struct server_loop *l)
+{
+	struct epoll_event ev;
+	struct conn *c;
+	int client_fd;
+
+	while (l->free_conns) {
+		client_fd = accept4(l->sfd, NULL, NULL, SOCK_NONBLOCK);
+		if (client_fd == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			tst_resm(TBROK | TERRNO, "Can't create client socket");
+			server_epoll_stop(1);
+			return;
+		}
+
+		if (!__sync_lock_test_and_set(&server_started, 1))
+			clock_gettime(CLOCK_MONOTONIC, &tv_server_start);
+
+		c = l->free_conns;
+		l->free_conns = c->next;
+
+		c->fd = client_fd;
+		c->offset = 0;
+		c->num_requests = 0;
+		c->send_msg_size = 0;
+		c->sent = 0;
+		c->wait_out = 0;
+		clock_gettime(CLOCK_MONOTONIC, &c->start);
+
+		setsockopt(client_fd, SOL_SOCKET, SO_LINGER, &clo, sizeof(clo));
+		if (busy_poll >= 0) {
+			setsockopt(client_fd, SOL_SOCKET, SO_BUSY_POLL,
+				   &busy_poll, sizeof(busy_poll));
+		}
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = c;
+		if (epoll_ctl(l->efd, EPOLL_CTL_ADD, client_fd, &ev) == -1) {
+			tst_resm(TBROK | TERRNO, "epoll_ctl failed");
+			server_epoll_stop(1);
+			return;
+		}
+	}
+
+	/* the pool is used up, accept again once a connection is closed */
+	server_listen_ctl(l, 0);
+}
+
+/*
+ * Sends the rest of the reply. If the socket buffer is full, the loop
+ * waits for EPOLLOUT and calls this again.
+ */
+static void server_conn_send(struct server_loop *l, struct conn *c)
+{
+	ssize_t len;
+
+	while (c->sent < c->send_msg_size) {
+		len = send(c->fd, c->send_msg + c->sent,
+			c->send_msg_size - c->sent, MSG_NOSIGNAL);
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			if (!c->wait_out && !server_conn_ctl(l, c, EPOLLOUT))
+				c->wait_out = 1;
+			return;
+		}
+		if (len == -1) {
+			tst_resm(TFAIL | TERRNO, "send failed");
+			server_epoll_stop(1);
+			return;
+		}
+		c->sent += len;
+	}
+
+	/* the reply was delayed, wait for the next request again */
+	if (c->wait_out) {
+		if (server_conn_ctl(l, c, EPOLLIN))
+			return;
+		c->wait_out = 0;
+	}
+
+	l->requests++;
+	c->offset = 0;
+
+	if (c->num_requests >= server_max_requests) {
+		/* max reqs, close socket */
+		shutdown(c->fd, SHUT_WR);
+		server_conn_close(l, c);
+	}
+}
+
+static void server_conn_recv(struct server_loop *l, struct conn *c)
+{
+	ssize_t recv_len;
+
+	recv_len = recv(c->fd, c->recv_msg + c->offset,
+		max_msg_len - c->offset, MSG_DONTWAIT);
+
+	if (recv_len == -1 && (errno == EAGAIN || errno == EINTR))
+		return;
+
+	if (recv_len == 0) {
+		server_conn_close(l, c);
+		return;
+	}
+
+	if (recv_len < 0 || (c->offset + recv_len) > max_msg_len ||
+	   (c->recv_msg[0] != start_byte &&
+	    c->recv_msg[0] != start_fin_byte)) {
+		tst_resm(TFAIL, "recv failed, sock '%d'", c->fd);
+		server_epoll_stop(1);
+		return;
+	}
+
+	c->offset += recv_len;
+
+	/* msg is not complete, continue recv */
+	if (c->recv_msg[c->offset - 1] != end_byte)
+		return;
+
+	/* client asks to terminate */
+	if (c->recv_msg[0] == start_fin_byte) {
+		server_epoll_stop(0);
+		return;
+	}
+
+	if (verbose) {
+		tst_resm_hexd(TINFO, c->recv_msg, c->offset,
+			"msg recv from sock %d:", c->fd);
+	}
+
+	/* if we send reply for the first time, construct it here */
+	if (!c->send_msg_size) {
+		c->send_msg_size = parse_client_request(c->recv_msg);
+		if (c->send_msg_size < 0) {
+			tst_resm(TFAIL, "wrong msg size '%d'",
+				c->send_msg_size);
+			server_epoll_stop(1);
+			return;
+		}
+		memset(c->send_msg, server_byte, c->send_msg_size - 1);
+		c->send_msg[c->send_msg_size - 1] = end_byte;
+	}
+
+	/* tell client that server is going to close this connection */
+	c->send_msg[0] = (++c->num_requests >= server_max_requests) ?
+		start_fin_byte : start_byte;
+
+	c->sent = 0;
+	server_conn_send(l, c);
+}
+
+static void *server_loop_fn(void *arg)
+{
+	struct server_loop *l = arg;
+	struct epoll_event events[64];
+	cpu_set_t set;
+	int i, n, err;
+
+	CPU_ZERO(&set);
+	CPU_SET(l->cpu, &set);
+	err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (err) {
+		errno = err;
+		tst_resm(TBROK | TERRNO, "can't pin the loop to CPU %d",
+			l->cpu);
+		server_epoll_stop(1);
+		return NULL;
+	}
+
+	while (!server_stop) {
+		n = epoll_wait(l->efd, events, ARRAY_SIZE(events), -1);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			tst_resm(TBROK | TERRNO, "epoll_wait failed");
+			server_epoll_stop(1);
+			break;
+		}
+
+		for (i = 0; i < n && !server_stop; ++i) {
+			if (events[i].data.ptr == &stop_efd)
+				break;
+			if (!events[i].data.ptr)
+				server_accept(l);
+			else if (events[i].events & EPOLLOUT)
+				server_conn_send(l, events[i].data.ptr);
+			else
+				server_conn_recv(l, events[i].data.ptr);
+		}
+	}
+
+	return NULL;
+}
+
+static void server_epoll_run(void)
+{
+	int i;
+
+	for (i = 0; i < loops_num; ++i) {
+		if (pthread_create(&loops[i].id, NULL, server_loop_fn,
+		    &loops[i])) {
+			tst_resm(TBROK | TERRNO,
+				"pthread_create failed at %s:%d",
+				__FILE__, __LINE__);
+			server_epoll_stop(1);
+			break;
+		}
+	}
+
+	/* main() runs the cleanup once all the loops have returned */
+	while (i--)
+		pthread_join(loops[i].id, NULL);
+
+	if (!server_failed)
+		server_epoll_report();
+}
+
 static void check_opt(const char *name, char *arg, int *val, int lim)
 {
 	if (arg) {
@@ -714,6 +1263,7 @@ static void setup(int argc, char *argv[])
 	check_opt("q", qarg, &tfo_queue_size, 1);
 	check_opt_l("T", Targ, &wait_timeout, 0L);
 	check_opt("b", barg, &busy_poll, 0);
+	check_opt("s", sarg, &pool_size, 1);
 
 	if (!force_run)
 		tst_require_root();
@@ -747,9 +1297,15 @@ static void setup(int argc, char *argv[])
 	case TCP_SERVER:
 		tst_resm(TINFO, "max requests '%d'",
 			server_max_requests);
-		tcp.init	= server_init;
-		tcp.run		= server_run;
-		tcp.cleanup	= server_cleanup;
+		if (epoll_mode) {
+			tcp.init	= server_epoll_init;
+			tcp.run		= server_epoll_run;
+			tcp.cleanup	= server_epoll_cleanup;
+		} else {
+			tcp.init	= server_init;
+			tcp.run		= server_run;
+			tcp.cleanup	= server_cleanup;
+		}
 		tfo_bit_num = 2;
 	break;
 	case TCP_CLIENT:
@@ -25,6 +25,7 @@ use_ssh=0
 clients_num=2
 client_requests=2000000
 max_requests=3
+server_opts=
 
 TST_TOTAL=1
 TCID="tcp_fastopen"
@@ -34,7 +35,7 @@ TCID="tcp_fastopen"
 bind_timeout=5
 tfo_result="${TMPDIR}/tfo_result"
 
-while getopts :hu:sr:p:n:R:6 opt; do
+while getopts :hu:sr:p:n:R:e6 opt; do
 	case "$opt" in
 	h)
 		echo "Usage:"
@@ -44,6 +45,7 @@ while getopts :hu:sr:p:n:R:6 opt; do
 		echo "n x      num of clients running in parallel"
 		echo "r x      the number of client requests"
 		echo "R x      num of requests, after which conn. closed"
+		echo "e        server runs an epoll loop per CPU"
 		echo "6        run over IPv6"
 		exit 0
 	;;
@@ -52,6 +54,7 @@ while getopts :hu:sr:p:n:R:6 opt; do
 	n) clients_num=$OPTARG ;;
 	r) client_requests=$OPTARG ;;
 	R) max_requests=$OPTARG ;;
+	e) server_opts="-e" ;;
 	6) # skip, test_net library already processed it
 	;;
 	*) tst_brkm TBROK "unknown option: $opt" ;;
@@ -90,7 +93,7 @@ run_client_server()
 	[ $? -ne 0 ] && tst_brkm TBROK "failed to get unused port"
 
 	# run tcp server on remote machine
-	tst_rhost_run -s -b -c "tcp_fastopen -R $max_requests $1 -g $port"
+	tst_rhost_run -s -b -c "tcp_fastopen -R $max_requests $server_opts $1 -g $port"
 	sleep $bind_timeout
 
 	# run local tcp client
@@ -0,0 +1,758 @@
+/*
+ * Copyright (c) 2026 Linux Test Project
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Parallel replacement for bin/run-tests.sh.
+ * The syntax is:
+ * $ ./run-parallel [-j jobs] [-t timeout] [-l logfile] [-c cachefile] dir...
+ *
+ * Every directory is walked recursively and each built test found there
+ * (<dirname>_<testname>.run-test or <dirname>_<testname>.sh) is run from
+ * its own directory with the arguments from the matching .args file, just
+ * like run-tests.sh does. Up to 'jobs' tests (default: number of online
+ * CPUs) run at the same time; a test still running after 'timeout'
+ * seconds (default: $TIMEOUT_VAL or 300) has its process group killed
+ * and is reported as HUNG, as t0 would.
+ *
+ * Results are appended to the logfile (default: $LOGFILE or ./logfile) in
+ * discovery order and in the format written by run-tests.sh, and the
+ * per-directory PASS/FAIL/TOTAL summaries are printed on stdout so that
+ * scripts/print-pass-fail-summary.awk keeps working.
+ *
+ * With -c, passing tests are recorded in 'cachefile' keyed by a hash of
+ * the test binary, its .args file and the running kernel; on the next run
+ * tests whose key is unchanged are reported as passed without executing
+ * them.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Same return codes as t0 and include/posixtest.h. */
+#define TIMEOUT_RET	(SIGALRM + 128)
+#define PTS_PASS	0
+#define PTS_FAIL	1
+#define PTS_UNRESOLVED	2
+#define PTS_UNSUPPORTED	4
+#define PTS_UNTESTED	5
+
+#define MAX_ARGS	64
+
+struct test {
+	char *dir;		/* directory the test is run from */
+	char *file;		/* file name of the test */
+	char *name;		/* name used in the logfile */
+	int group;		/* index into groups[] */
+	uint64_t hash;
+	pid_t pid;
+	time_t deadline;
+	int out_fd;
+	int status;
+	int done;
+	int cached;
+};
+
+struct group {
+	char *dir;
+	int pass;
+	int fail;
+};
+
+static struct test *tests;
+static int ntests, tests_size;
+
+static struct group *groups;
+static int ngroups, groups_size;
+
+struct cache_entry {
+	char *name;
+	uint64_t hash;
+	int seen;
+};
+
+static struct cache_entry *cache;
+static int ncache;
+
+static const char *tmpdir;
+/* Signal mask of the runner before SIGCHLD was blocked, given to tests. */
+static sigset_t orig_mask;
+
+static void *xrealloc(void *ptr, size_t size)
+{
+	ptr = realloc(ptr, size);
+	if (ptr == NULL) {
+		perror("realloc");
+		exit(1);
+	}
+	return ptr;
+}
+
+static char *xstrdup(const char *s)
+{
+	char *p = strdup(s);
+
+	if (p == NULL) {
+		perror("strdup");
+		exit(1);
+	}
+	return p;
+}
+
+static time_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static uint64_t fnv1a(uint64_t hash, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static uint64_t hash_file(uint64_t hash, const char *path)
+{
+	char buf[65536];
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return hash;
+
+	while ((ret = read(fd, buf, sizeof(buf))) > 0)
+		hash = fnv1a(hash, buf, ret);
+
+	close(fd);
+	return hash;
+}
+
+/*
+ * Mirrors run-tests.sh, which drops the first dot-separated suffix of the
+ * test file name to build the name of its .args file.
+ */
+static char *args_path(const struct test *t)
+{
+	const char *rest;
+	char *path;
+	size_t len = strcspn(t->file, ".");
+
+	rest = t->file + len;
+	if (*rest == '.')
+		rest += 1 + strcspn(rest + 1, ".");
+
+	if (asprintf(&path, "%s/%.*s%s.args", t->dir, (int)len, t->file,
+		     rest) == -1) {
+		perror("asprintf");
+		exit(1);
+	}
+	return path;
+}
+
+static uint64_t test_hash(const struct test *t, const struct utsname *uts)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	char *path;
+
+	if (asprintf(&path, "%s/%s", t->dir, t->file) == -1) {
+		perror("asprintf");
+		exit(1);
+	}
+	hash = hash_file(hash, path);
+	free(path);
+
+	path = args_path(t);
+	hash = hash_file(hash, path);
+	free(path);
+
+	hash = fnv1a(hash, uts->release, strlen(uts->release));
+	hash = fnv1a(hash, uts->version, strlen(uts->version));
+	hash = fnv1a(hash, uts->machine, strlen(uts->machine));
+
+	return hash;
+}
+
+static int cache_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct cache_entry *)a)->name,
+		      ((const struct cache_entry *)b)->name);
+}
+
+static void load_cache(const char *path)
+{
+	char line[4096], name[4096];
+	unsigned long long hash;
+	int size = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL)
+		return;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%llx %4095s", &hash, name) != 2)
+			continue;
+		if (ncache == size) {
+			size = size ? 2 * size : 1024;
+			cache = xrealloc(cache, size * sizeof(*cache));
+		}
+		cache[ncache].name = xstrdup(name);
+		cache[ncache].hash = hash;
+		cache[ncache].seen = 0;
+		ncache++;
+	}
+
+	fclose(f);
+	qsort(cache, ncache, sizeof(*cache), cache_cmp);
+}
+
+static struct cache_entry *cache_find(const char *name)
+{
+	struct cache_entry key = { .name = (char *)name };
+
+	if (ncache == 0)
+		return NULL;
+
+	return bsearch(&key, cache, ncache, sizeof(*cache), cache_cmp);
+}
+
+/*
+ * Writes the new cache: every test of this run that passed, plus the
+ * entries of tests that were not part of this run at all.
+ */
+static void save_cache(const char *path)
+{
+	struct cache_entry *e;
+	char *tmp;
+	FILE *f;
+	int i;
+
+	if (asprintf(&tmp, "%s.XXXXXX", path) == -1) {
+		perror("asprintf");
+		return;
+	}
+
+	i = mkstemp(tmp);
+	if (i == -1 || (f = fdopen(i, "w")) == NULL) {
+		perror("mkstemp");
+		free(tmp);
+		return;
+	}
+
+	for (i = 0; i < ntests; i++) {
+		e = cache_find(tests[i].name);
+		if (e != NULL)
+			e->seen = 1;
+		if (tests[i].status == PTS_PASS)
+			fprintf(f, "%016llx %s\n",
+				(unsigned long long)tests[i].hash,
+				tests[i].name);
+	}
+
+	for (i = 0; i < ncache; i++) {
+		if (!cache[i].seen)
+			fprintf(f, "%016llx %s\n",
+				(unsigned long long)cache[i].hash,
+				cache[i].name);
+	}
+
+	if (fclose(f) == EOF || rename(tmp, path) == -1) {
+		perror(path);
+		unlink(tmp);
+	}
+	free(tmp);
+}
+
+static int is_test(const char *file, const char *prefix)
+{
+	size_t plen = strlen(prefix);
+	const char *suffix;
+
+	if (strncmp(file, prefix, plen) || file[plen] != '_')
+		return 0;
+
+	suffix = strrchr(file, '.');
+	if (suffix == NULL)
+		return 0;
+
+	return !strcmp(suffix, ".run-test") || !strcmp(suffix, ".sh");
+}
+
+static void add_test(const char *dir, const char *file)
+{
+	struct group *g = &groups[ngroups - 1];
+	struct test *t;
+	const char *name = dir;
+
+	if (ntests == tests_size) {
+		tests_size = tests_size ? 2 * tests_size : 1024;
+		tests = xrealloc(tests, tests_size * sizeof(*tests));
+	}
+
+	t = &tests[ntests++];
+	memset(t, 0, sizeof(*t));
+	t->dir = g->dir;
+	t->file = xstrdup(file);
+	t->group = ngroups - 1;
+	t->out_fd = -1;
+
+	while (!strncmp(name, "./", 2))
+		name += 2;
+
+	if (asprintf(&t->name, "%s/%.*s", name,
+		     (int)(strrchr(file, '.') - file), file) == -1) {
+		perror("asprintf");
+		exit(1);
+	}
+}
+
+static int is_executable(const char *dir, const char *file)
+{
+	struct stat st;
+	char *path;
+	int ret;
+
+	if (asprintf(&path, "%s/%s", dir, file) == -1)
+		return 0;
+
+	ret = !stat(path, &st) && S_ISREG(st.st_mode) &&
+	      (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH));
+
+	free(path);
+	return ret;
+}
+
+/*
+ * Tests are named after their directory, except for the speculative
+ * subdirectories which use <parent>_speculative, the same way
+ * scripts/generate-makefiles.sh names them.
+ */
+static char *test_prefix(const char *dir)
+{
+	const char *base, *parent;
+	char *copy, *prefix;
+	size_t len = strlen(dir);
+
+	copy = xstrdup(dir);
+	while (len > 1 && copy[len - 1] == '/')
+		copy[--len] = '\0';
+
+	base = strrchr(copy, '/');
+	base = base ? base + 1 : copy;
+
+	if (strcmp(base, "speculative") || base == copy) {
+		prefix = xstrdup(base);
+	} else {
+		copy[base - copy - 1] = '\0';
+		parent = strrchr(copy, '/');
+		parent = parent ? parent + 1 : copy;
+		if (asprintf(&prefix, "%s_speculative", parent) == -1)
+			prefix = xstrdup(base);
+	}
+
+	free(copy);
+	return prefix;
+}
+
+static void discover(const char *dir)
+{
+	struct dirent **ents;
+	char *prefix, *path;
+	int i, n, first = 1;
+
+	n = scandir(dir, &ents, NULL, alphasort);
+	if (n == -1) {
+		fprintf(stderr, "scandir(%s): %s\n", dir, strerror(errno));
+		return;
+	}
+
+	prefix = test_prefix(dir);
+
+	for (i = 0; i < n; i++) {
+		const char *file = ents[i]->d_name;
+
+		if (!is_test(file, prefix) || !is_executable(dir, file))
+			continue;
+
+		if (first) {
+			if (ngroups == groups_size) {
+				groups_size = groups_size ? 2 * groups_size : 64;
+				groups = xrealloc(groups,
+						  groups_size * sizeof(*groups));
+			}
+			groups[ngroups].dir = xstrdup(dir);
+			groups[ngroups].pass = groups[ngroups].fail = 0;
+			ngroups++;
+			first = 0;
+		}
+
+		add_test(dir, file);
+	}
+
+	for (i = 0; i < n; i++) {
+		const char *file = ents[i]->d_name;
+		struct stat st;
+
+		if (file[0] != '.' &&
+		    asprintf(&path, "%s/%s", dir, file) != -1) {
+			if (!lstat(path, &st) && S_ISDIR(st.st_mode))
+				discover(path);
+			free(path);
+		}
+		free(ents[i]);
+	}
+
+	free(ents);
+	free(prefix);
+}
+
+static int read_args(const struct test *t, char *buf, size_t size,
+		     char *argv[])
+{
+	char *path, *tok, *save;
+	int fd, argc = 0;
+	ssize_t len = 0;
+
+	argv[argc++] = NULL;
+
+	path = args_path(t);
+	fd = open(path, O_RDONLY);
+	free(path);
+
+	if (fd != -1) {
+		len = read(fd, buf, size - 1);
+		close(fd);
+	}
+	buf[len > 0 ? len : 0] = '\0';
+
+	for (tok = strtok_r(buf, " \t\n", &save);
+	     tok != NULL && argc < MAX_ARGS;
+	     tok = strtok_r(NULL, " \t\n", &save))
+		argv[argc++] = tok;
+
+	argv[argc] = NULL;
+	return argc;
+}
+
+static void start_test(struct test *t, int timeout)
+{
+	char path[] = "/tmp/run-parallel.XXXXXX";
+	char *tmpl, *argv[MAX_ARGS + 1], args[4096], *exe;
+
+	if (asprintf(&tmpl, "%s/run-parallel.XXXXXX", tmpdir) == -1)
+		tmpl = path;
+
+	t->out_fd = mkstemp(tmpl);
+	if (t->out_fd == -1) {
+		perror("mkstemp");
+		exit(1);
+	}
+	unlink(tmpl);
+	if (tmpl != path)
+		free(tmpl);
+
+	if (asprintf(&exe, "./%s", t->file) == -1) {
+		perror("asprintf");
+		exit(1);
+	}
+
+	read_args(t, args, sizeof(args), argv);
+	argv[0] = exe;
+
+	t->pid = fork();
+	switch (t->pid) {
+	case -1:
+		perror("fork");
+		exit(1);
+	case 0:
+		/* Tests must start with the signal state run-tests.sh gives them. */
+		signal(SIGCHLD, SIG_DFL);
+		sigprocmask(SIG_SETMASK, &orig_mask, NULL);
+		setpgid(0, 0);
+		dup2(t->out_fd, STDOUT_FILENO);
+		dup2(t->out_fd, STDERR_FILENO);
+		close(t->out_fd);
+		if (chdir(t->dir) == -1) {
+			perror("chdir");
+			_exit(127);
+		}
+		execvp(exe, argv);
+		perror("execvp");
+		_exit(127);
+	}
+
+	/* Avoid racing with the child when killing the group on timeout. */
+	setpgid(t->pid, t->pid);
+	t->deadline = now() + timeout;
+	free(exe);
+}
+
+static const char *result_msg(int status)
+{
+	switch (status) {
+	case PTS_FAIL:
+		return "FAILED";
+	case PTS_UNRESOLVED:
+		return "UNRESOLVED";
+	case PTS_UNSUPPORTED:
+		return "UNSUPPORTED";
+	case PTS_UNTESTED:
+		return "UNTESTED";
+	case TIMEOUT_RET:
+		return "HUNG";
+	}
+
+	if (status > 128)
+		return "SIGNALED";
+
+	return "EXITED ABNORMALLY";
+}
+
+static void log_test(FILE *log, struct test *t)
+{
+	struct group *g = &groups[t->group];
+	char buf[4096];
+	ssize_t len;
+
+	if (t->status == PTS_PASS) {
+		fprintf(log, "%s: execution: PASS\n", t->name);
+		g->pass++;
+	} else {
+		printf("%s: execution: %s \n", t->name, result_msg(t->status));
+		fprintf(log, "%s: execution: %s: Output: \n", t->name,
+			result_msg(t->status));
+
+		lseek(t->out_fd, 0, SEEK_SET);
+		while ((len = read(t->out_fd, buf, sizeof(buf))) > 0)
+			fwrite(buf, 1, len, log);
+		g->fail++;
+	}
+
+	if (t->out_fd != -1) {
+		close(t->out_fd);
+		t->out_fd = -1;
+	}
+}
+
+static void print_summary(const struct group *g)
+{
+	const char *base = strrchr(g->dir, '/');
+
+	printf("*******************\n");
+	printf("Testing %s\n", base ? base + 1 : g->dir);
+	printf("*******************\n");
+	printf("PASS\t\t%3d\n", g->pass);
+	printf("FAIL\t\t%3d\n", g->fail);
+	printf("*******************\n");
+	printf("TOTAL\t\t%3d\n", g->pass + g->fail);
+	printf("*******************\n");
+}
+
+static void sigchld_handler(int sig)
+{
+	(void)sig;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-j jobs] [-t timeout] [-l logfile] "
+		"[-c cachefile] dir...\n", name);
+	exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *logfile, *cachefile = NULL;
+	int jobs, timeout = 300, running = 0, cached = 0;
+	int next_start = 0, next_log = 0, next_group = 0, failed = 0;
+	struct sigaction sa;
+	struct utsname uts;
+	sigset_t sigchld;
+	FILE *log;
+	int i, c;
+
+	jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs < 1)
+		jobs = 1;
+
+	if (getenv("TIMEOUT_VAL"))
+		timeout = atoi(getenv("TIMEOUT_VAL"));
+
+	logfile = getenv("LOGFILE");
+	if (logfile == NULL || logfile[0] == '\0')
+		logfile = "logfile";
+
+	tmpdir = getenv("TMPDIR");
+	if (tmpdir == NULL || tmpdir[0] == '\0')
+		tmpdir = "/tmp";
+
+	while ((c = getopt(argc, argv, "c:hj:l:t:")) != -1) {
+		switch (c) {
+		case 'c':
+			cachefile = optarg;
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		case 'l':
+			logfile = optarg;
+			break;
+		case 't':
+			timeout = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind == argc || jobs < 1 || timeout < 1)
+		usage(argv[0]);
+
+	for (i = optind; i < argc; i++)
+		discover(argv[i]);
+
+	if (ntests == 0) {
+		fprintf(stderr, "No tests found\n");
+		return 1;
+	}
+
+	log = fopen(logfile, "a");
+	if (log == NULL) {
+		perror(logfile);
+		return 1;
+	}
+
+	if (cachefile != NULL) {
+		load_cache(cachefile);
+		uname(&uts);
+		for (i = 0; i < ntests; i++)
+			tests[i].hash = test_hash(&tests[i], &uts);
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sigchld_handler;
+	sigaction(SIGCHLD, &sa, NULL);
+
+	sigemptyset(&sigchld);
+	sigaddset(&sigchld, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &sigchld, &orig_mask);
+
+	while (next_log < ntests) {
+		struct timespec ts = { .tv_sec = 1 };
+		time_t t_now;
+		pid_t pid;
+		int status;
+
+		while (running < jobs && next_start < ntests) {
+			struct test *t = &tests[next_start++];
+			struct cache_entry *e;
+
+			e = cachefile ? cache_find(t->name) : NULL;
+			if (e != NULL && e->hash == t->hash) {
+				t->status = PTS_PASS;
+				t->done = t->cached = 1;
+				cached++;
+				continue;
+			}
+
+			start_test(t, timeout);
+			running++;
+		}
+
+		/* Write the results of the finished tests in order. */
+		while (next_log < ntests && tests[next_log].done) {
+			log_test(log, &tests[next_log]);
+			if (next_log + 1 == ntests ||
+			    tests[next_log + 1].group != tests[next_log].group) {
+				print_summary(&groups[next_group++]);
+				fflush(log);
+				fflush(stdout);
+			}
+			next_log++;
+		}
+
+		if (running == 0)
+			continue;
+
+		t_now = now();
+		for (i = next_log; i < next_start; i++) {
+			if (tests[i].done || tests[i].pid <= 0)
+				continue;
+			if (tests[i].deadline <= t_now) {
+				kill(-tests[i].pid, SIGKILL);
+				tests[i].status = TIMEOUT_RET;
+			} else if (tests[i].deadline - t_now < ts.tv_sec) {
+				ts.tv_sec = tests[i].deadline - t_now;
+			}
+		}
+
+		sigtimedwait(&sigchld, NULL, &ts);
+
+		while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+			for (i = next_log; i < next_start; i++)
+				if (tests[i].pid == pid && !tests[i].done)
+					break;
+			if (i == next_start)
+				continue;
+
+			/* Kill whatever the test left behind. */
+			kill(-pid, SIGKILL);
+
+			if (tests[i].status == TIMEOUT_RET)
+				;
+			else if (WIFEXITED(status))
+				tests[i].status = WEXITSTATUS(status);
+			else
+				tests[i].status = 128 + WTERMSIG(status);
+
+			tests[i].done = 1;
+			running--;
+		}
+	}
+
+	fclose(log);
+
+	if (cachefile != NULL) {
+		save_cache(cachefile);
+		fprintf(stderr, "%d of %d tests skipped as cached passes\n",
+			cached, ntests);
+	}
+
+	/* Like run-tests.sh, exit with the number of failed tests. */
+	for (i = 0; i < ngroups; i++)
+		failed += groups[i].fail;
+
+	return failed > 255 ? 255 : failed;
+}
@@ -228,14 +228,13 @@ int main(int argc, char *argv[])
 {
 	int i, j, k, err;
 	unsigned long long delta;
-	unsigned long long max, min;
 	struct sched_param param;
 	stats_container_t dat;
 	stats_container_t hist;
 	stats_quantiles_t quantiles;
+	stats_stream_t stream;
 	stats_record_t rec;
-	struct timespec *start_data;
-	struct timespec *stop_data;
+	struct timespec start, stop;
 
 	if (stats_cmdline(argc, argv) < 0) {
 		printf("usage: %s help\n", argv[0]);
@@ -248,27 +247,22 @@ int main(int argc, char *argv[])
 		       iterations);
 	}
 
-	stats_container_init(&dat, iterations);
+	/*
+	 * The statistics are collected in constant memory, the samples are
+	 * only kept around when they are going to be saved for plotting.
+	 */
+	stats_stream_init(&stream);
+	if (save_stats && stats_container_init(&dat, iterations)) {
+		printf("Memory allocation Failed (too many Iteration: %d)\n",
+		       iterations);
+		exit(1);
+	}
 	stats_container_init(&hist, HIST_BUCKETS);
 	stats_quantiles_init(&quantiles, (int)log10(iterations));
 	setup();
 
 	mlockall(MCL_CURRENT | MCL_FUTURE);
 
-	start_data = calloc(iterations, sizeof(struct timespec));
-	if (start_data == NULL) {
-		printf("Memory allocation Failed (too many Iteration: %d)\n",
-		       iterations);
-		exit(1);
-	}
-	stop_data = calloc(iterations, sizeof(struct timespec));
-	if (stop_data == NULL) {
-		printf("Memory allocation Failed (too many Iteration: %d)\n",
-		       iterations);
-		free(start_data);
-		exit(1);
-	}
-
 	/* switch to SCHED_FIFO 99 */
 	param.sched_priority = sched_get_priority_max(SCHED_FIFO);
 	err = sched_setscheduler(0, SCHED_FIFO, &param);
@@ -294,7 +288,7 @@ int main(int argc, char *argv[])
 	printf("Iterations: %d\n\n", iterations);
 
 	/* collect iterations pairs of gtod calls */
-	max = min = 0;
+	k = 0;
 	if (latency_threshold) {
 		latency_trace_enable();
 		latency_trace_start();
@@ -304,52 +298,55 @@ int main(int argc, char *argv[])
 	for (i = 0; i < (iterations / 10000); i++) {
 		for (j = 0; j < 10000; j++) {
 			k = (i * 10000) + j;
-			clock_gettime(CLOCK_MONOTONIC, &start_data[k]);
-			clock_gettime(CLOCK_MONOTONIC, &stop_data[k]);
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			clock_gettime(CLOCK_MONOTONIC, &stop);
+
+			delta = timespec_subtract(&start, &stop);
+			stats_stream_record(&stream, delta);
+			if (save_stats) {
+				rec.x = k;
+				rec.y = delta;
+				stats_container_append(&dat, rec);
+			}
+			if (latency_threshold && delta > latency_threshold)
+				goto out;
 		}
 		usleep(1000);
 	}
-	for (i = 0; i < iterations; i++) {
-		delta = timespec_subtract(&start_data[i], &stop_data[i]);
-		rec.x = i;
-		rec.y = delta;
-		stats_container_append(&dat, rec);
-		if (i == 0 || delta < min)
-			min = delta;
-		if (delta > max)
-			max = delta;
-		if (latency_threshold && delta > latency_threshold)
-			break;
-	}
+	k = iterations;
+out:
 	if (latency_threshold) {
 		latency_trace_stop();
-		if (i != iterations) {
+		if (k != iterations) {
 			printf
 			    ("Latency threshold (%lluus) exceeded at iteration %d\n",
-			     latency_threshold, i);
+			     latency_threshold, k);
 			latency_trace_print();
-			stats_container_resize(&dat, i + 1);
 		}
 	}
 
-	stats_hist(&hist, &dat);
-	stats_container_save(filenames[SCATTER_FILENAME], titles[SCATTER_TITLE],
-			     labels[SCATTER_LABELX], labels[SCATTER_LABELY],
-			     &dat, "points");
+	stats_stream_hist(&hist, &stream);
+	if (save_stats) {
+		stats_container_save(filenames[SCATTER_FILENAME],
+				     titles[SCATTER_TITLE],
+				     labels[SCATTER_LABELX],
+				     labels[SCATTER_LABELY], &dat, "points");
+	}
 	stats_container_save(filenames[HIST_FILENAME], titles[HIST_TITLE],
 			     labels[HIST_LABELX], labels[HIST_LABELY], &hist,
 			     "steps");
 
 	/* report on deltas */
-	printf("Min: %llu ns\n", min);
-	printf("Max: %llu ns\n", max);
-	printf("Avg: %.4f ns\n", stats_avg(&dat));
-	printf("StdDev: %.4f ns\n", stats_stddev(&dat));
+	printf("Min: %ld ns\n", stats_stream_min(&stream));
+	printf("Max: %ld ns\n", stats_stream_max(&stream));
+	printf("Avg: %.4f ns\n", stats_stream_avg(&stream));
+	printf("StdDev: %.4f ns\n", stats_stream_stddev(&stream));
 	printf("Quantiles:\n");
-	stats_quantiles_calc(&dat, &quantiles);
+	stats_stream_quantiles_calc(&stream, &quantiles);
 	stats_quantiles_print(&quantiles);
 
-	stats_container_free(&dat);
+	if (save_stats)
+		stats_container_free(&dat);
 	stats_container_free(&hist);
 	stats_quantiles_free(&quantiles);
 
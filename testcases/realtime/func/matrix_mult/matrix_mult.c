@@ -33,11 +33,13 @@
  * HISTORY
  *      2007-Mar-09:  Initial version by Darren Hart <dvhltc@us.ibm.com>
  *      2008-Feb-26:  Closely emulate jvm Dinakar Guniguntala <dino@in.ibm.com>
+ *      2026-Oct-18:  Selectable cache-blocked, SIMD and L1-resident kernels
  *
  *****************************************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <librttest.h>
 #include <libstats.h>
@@ -45,6 +47,8 @@
 #define MAX_CPUS	8192
 #define PRIO		43
 #define MATRIX_SIZE	100
+#define BLOCK_SIZE	20	/* tile of the cache-blocked kernel */
+#define L1_MATRIX_SIZE	16	/* three of these fit in any L1 data cache */
 #define DEF_OPS		8	/* the higher the number, the more CPU intensive */
 					/* (and therefore SMP performance goes up) */
 #define PASS_CRITERIA	0.75	/* Avg concurrent time * pass criteria < avg seq time - */
@@ -65,6 +69,30 @@ static int *tids;
 static int online_cpu_id = -1;
 static int iterations = ITERATIONS;
 static int iterations_percpu;
+static nsec_t *thread_start, *thread_end;
+static int *thread_cpu;
+
+/* keeps the compiler from optimizing the unused results away */
+static volatile double matrix_sink;
+
+typedef double vec_t __attribute__ ((vector_size(4 * sizeof(double))));
+#define VEC_LEN		(int)(sizeof(vec_t) / sizeof(double))
+
+void matrix_mult(int m_size);
+void matrix_mult_blocked(int m_size);
+void matrix_mult_simd(int m_size);
+void matrix_mult_compute(int m_size);
+
+static struct {
+	const char *name;
+	void (*fn)(int m_size);
+} kernels[] = {
+	{"naive", matrix_mult},
+	{"blocked", matrix_mult_blocked},
+	{"simd", matrix_mult_simd},
+	{"compute", matrix_mult_compute},
+};
+static int kernel;
 
 stats_container_t sdat, cdat, *curdat;
 stats_container_t shist, chist;
@@ -78,6 +106,8 @@ void usage(void)
 	printf
 	    ("  -l#	   #: number of multiplications per iteration (load)\n");
 	printf("  -i#	   #: number of iterations\n");
+	printf("  -kNAME   multiplication kernel: naive (default), blocked,\n"
+	       "	   simd or compute (L1 resident working set)\n");
 }
 
 int parse_args(int c, char *v)
@@ -90,6 +120,17 @@ int parse_args(int c, char *v)
 	case 'l':
 		ops = atoi(v);
 		break;
+	case 'k':
+		for (kernel = 0; kernel < (int)(sizeof(kernels) / sizeof(kernels[0])); kernel++) {
+			if (!strcmp(v, kernels[kernel].name))
+				break;
+		}
+		if (kernel == (int)(sizeof(kernels) / sizeof(kernels[0]))) {
+			fprintf(stderr, "Unknown kernel: %s\n", v);
+			usage();
+			exit(1);
+		}
+		break;
 	case 'h':
 		usage();
 		exit(0);
@@ -121,7 +162,7 @@ void matrix_mult(int m_size)
 
 	matrix_init(A, B);
 	for (i = 0; i < m_size; i++) {
-		int i_m = m_size - i;
+		int i_m = m_size - 1 - i;
 		for (j = 0; j < m_size; j++) {
 			double sum = A[i_m][j] * B[j][i];
 			for (k = 0; k < m_size; k++)
@@ -129,6 +170,98 @@ void matrix_mult(int m_size)
 			C[i][j] = sum;
 		}
 	}
+	matrix_sink = C[m_size - 1][m_size - 1];
+}
+
+/* Same amount of work as matrix_mult(), but tiled to stay in the cache */
+void matrix_mult_blocked(int m_size)
+{
+	double A[m_size][m_size];
+	double B[m_size][m_size];
+	double C[m_size][m_size];
+	int i, j, k, ii, jj, kk;
+
+	matrix_init(A, B);
+	memset(C, 0, sizeof(C));
+	for (ii = 0; ii < m_size; ii += BLOCK_SIZE) {
+		int i_end = MIN(ii + BLOCK_SIZE, m_size);
+		for (kk = 0; kk < m_size; kk += BLOCK_SIZE) {
+			int k_end = MIN(kk + BLOCK_SIZE, m_size);
+			for (jj = 0; jj < m_size; jj += BLOCK_SIZE) {
+				int j_end = MIN(jj + BLOCK_SIZE, m_size);
+				for (i = ii; i < i_end; i++) {
+					for (k = kk; k < k_end; k++) {
+						double a = A[i][k];
+						for (j = jj; j < j_end; j++)
+							C[i][j] += a * B[k][j];
+					}
+				}
+			}
+		}
+	}
+	matrix_sink = C[m_size - 1][m_size - 1];
+}
+
+/* Computes VEC_LEN columns of the result at a time in vector registers */
+void matrix_mult_simd(int m_size)
+{
+	double A[m_size][m_size];
+	double B[m_size][m_size];
+	double C[m_size][m_size];
+	int i, j, k;
+
+	matrix_init(A, B);
+	for (i = 0; i < m_size; i++) {
+		for (j = 0; j + VEC_LEN <= m_size; j += VEC_LEN) {
+			vec_t sum = { 0 };
+			for (k = 0; k < m_size; k++) {
+				vec_t b;
+				memcpy(&b, &B[k][j], sizeof(b));
+				sum += A[i][k] * b;
+			}
+			memcpy(&C[i][j], &sum, sizeof(sum));
+		}
+		for (; j < m_size; j++) {
+			double sum = 0;
+			for (k = 0; k < m_size; k++)
+				sum += A[i][k] * B[k][j];
+			C[i][j] = sum;
+		}
+	}
+	matrix_sink = C[m_size - 1][m_size - 1];
+}
+
+/*
+ * Does as many multiply-adds as matrix_mult() on matrices small enough to
+ * stay in the L1 cache, so that the runtime is bound by the CPU only.
+ */
+void matrix_mult_compute(int m_size)
+{
+	double A[L1_MATRIX_SIZE][L1_MATRIX_SIZE];
+	double B[L1_MATRIX_SIZE][L1_MATRIX_SIZE];
+	double C[L1_MATRIX_SIZE][L1_MATRIX_SIZE];
+	int reps = MAX(1, m_size * m_size * m_size /
+		       (L1_MATRIX_SIZE * L1_MATRIX_SIZE * L1_MATRIX_SIZE));
+	int i, j, k, r;
+
+	for (i = 0; i < L1_MATRIX_SIZE; i++) {
+		for (j = 0; j < L1_MATRIX_SIZE; j++) {
+			A[i][j] = (double)(i * j);
+			B[i][j] = (double)((i * j) % 10);
+			C[i][j] = 0;
+		}
+	}
+
+	for (r = 0; r < reps; r++) {
+		for (i = 0; i < L1_MATRIX_SIZE; i++) {
+			for (k = 0; k < L1_MATRIX_SIZE; k++) {
+				double a = A[i][k];
+				for (j = 0; j < L1_MATRIX_SIZE; j++)
+					C[i][j] += a * B[k][j];
+			}
+		}
+	}
+	matrix_sink = C[L1_MATRIX_SIZE - 1][L1_MATRIX_SIZE - 1];
 }
 
 void matrix_mult_record(int m_size, int index)
@@ -138,7 +271,7 @@ void matrix_mult_record(int m_size, int index)
 
 	start = rt_gettime();
 	for (i = 0; i < ops; i++)
-		matrix_mult(MATRIX_SIZE);
+		kernels[kernel].fn(MATRIX_SIZE);
 	end = rt_gettime();
 	delta = (long)((end - start) / NS_PER_US);
 	curdat->records[index].x = index;
@@ -182,8 +315,11 @@ void *concurrent_thread(void *thread)
 
 	index = iterations_percpu * thread_id;	/* To avoid stats overlapping */
 	pthread_barrier_wait(&mult_start);
+	thread_start[thread_id] = rt_gettime();
 	for (i = 0; i < iterations_percpu; i++)
 		matrix_mult_record(MATRIX_SIZE, index++);
+	thread_end[thread_id] = rt_gettime();
+	thread_cpu[thread_id] = cpuid;
 
 	return NULL;
 }
@@ -212,6 +348,14 @@ void main_thread(void)
 	}
 	memset(tids, 0, numcpus);
 
+	thread_start = calloc(numcpus, sizeof(nsec_t));
+	thread_end = calloc(numcpus, sizeof(nsec_t));
+	thread_cpu = calloc(numcpus, sizeof(int));
+	if (!thread_start || !thread_end || !thread_cpu) {
+		perror("calloc");
+		exit(1);
+	}
+
 	cpuid = set_affinity();
 	if (cpuid == -1) {
 		fprintf(stderr, "Main thread: Can't set affinity.\n");
@@ -267,9 +411,18 @@ void main_thread(void)
 	/* run matrix mult operation concurrently */
 	printf("\nRunning concurrent operations\n");
 	pthread_barrier_wait(&mult_start);
-	start = rt_gettime();
 	join_threads();
-	end = rt_gettime();
+
+	/*
+	 * The main thread shares its CPU with the first thread, so it may
+	 * only run again once that one is done, use the threads' own times.
+	 */
+	start = thread_start[0];
+	end = thread_end[0];
+	for (j = 1; j < numcpus; j++) {
+		start = MIN(start, thread_start[j]);
+		end = MAX(end, thread_end[j]);
+	}
 
 	delta = (long)((end - start) / NS_PER_US);
 
@@ -295,10 +448,26 @@ void main_thread(void)
 			"Warning: could not save concurrent mults stats\n");
 	}
 
+	/*
+	 * Sequential over per-thread time of one iteration, below 1 when the
+	 * concurrent threads slow each other down. It is not a speedup, that
+	 * is the sequential over the concurrent average below.
+	 */
+	printf("\nPer-thread runtimes:\n");
+	for (j = 0; j < numcpus; j++) {
+		nsec_t runtime = thread_end[j] - thread_start[j];
+		float tavg = (float)runtime / NS_PER_US / iterations_percpu;
+		printf("Thread %d (CPU %d): %lld us, Avg: %.4f us, "
+		       "Seq/thread ratio: %.4f\n", j, thread_cpu[j],
+		       (long long)(runtime / NS_PER_US), tavg, savg / tavg);
+	}
+
 	printf("\nConcurrent Multipliers:\n");
 	printf("Min: %.4f\n", (float)smin / cmin);
 	printf("Max: %.4f\n", (float)smax / cmax);
 	printf("Avg: %.4f\n", (float)savg / cavg);
+	printf("Measured speedup: %.4f on %d CPUs\n", (float)savg / cavg,
+	       numcpus);
 
 	ret = 1;
 	if (savg > (cavg * criteria))
@@ -315,7 +484,7 @@ int main(int argc, char *argv[])
 {
 	setup();
 	pass_criteria = PASS_CRITERIA;
-	rt_init("l:i:h", parse_args, argc, argv);
+	rt_init("l:i:k:h", parse_args, argc, argv);
 	numcpus = sysconf(_SC_NPROCESSORS_ONLN);
 	/* the minimum avg concurrent multiplier to pass */
 	criteria = pass_criteria * numcpus;
@@ -345,6 +514,7 @@ int main(int argc, char *argv[])
 	printf("Running %d iterations\n", iterations);
 	printf("Matrix Dimensions: %dx%d\n", MATRIX_SIZE, MATRIX_SIZE);
 	printf("Calculations per iteration: %d\n", ops);
+	printf("Kernel: %s\n", kernels[kernel].name);
 	printf("Number of CPUs: %u\n", numcpus);
 
 	set_priority(PRIO);
@@ -75,7 +75,9 @@ static int num_busy = -1;
 
 nsec_t low_unlock, max_pi_delay;
 
-stats_container_t low_dat, cpu_delay_dat;
+/* the samples are only kept when they are going to be saved for plotting */
+stats_stream_t cpu_delay_stream;
+stats_container_t cpu_delay_dat;
 stats_container_t cpu_delay_hist;
 stats_quantiles_t cpu_delay_quantiles;
 stats_record_t rec;
@@ -132,11 +134,8 @@ void *busy_thread(void *arg)
 
 void *low_prio_thread(void *arg)
 {
-	nsec_t low_start, low_hold;
 	unsigned int i;
 
-	stats_container_init(&low_dat, iterations);
-
 	printf("Low prio thread started\n");
 
 	for (i = 0; i < iterations; i++) {
@@ -147,17 +146,11 @@ void *low_prio_thread(void *arg)
 		 */
 		pthread_barrier_wait(&bar1);
 
-		low_start = rt_gettime();
 		busy_work_ms(low_work_time);
 		low_unlock = rt_gettime();
-		low_hold = low_unlock - low_start;
 
 		pthread_mutex_unlock(&lock);
 
-		rec.x = i;
-		rec.y = low_hold / NS_PER_US;
-		stats_container_append(&low_dat, rec);
-
 		if (i == iterations - 1)
 			end = 1;
 
@@ -173,7 +166,12 @@ void *high_prio_thread(void *arg)
 	nsec_t high_start, high_end, high_get_lock;
 	unsigned int i;
 
-	stats_container_init(&cpu_delay_dat, iterations);
+	stats_stream_init(&cpu_delay_stream);
+	if (save_stats && stats_container_init(&cpu_delay_dat, iterations)) {
+		printf("Memory allocation Failed (too many Iteration: %u)\n",
+		       iterations);
+		exit(1);
+	}
 	stats_container_init(&cpu_delay_hist, HIST_BUCKETS);
 	stats_quantiles_init(&cpu_delay_quantiles, (int)log10(iterations));
 
@@ -193,33 +191,40 @@ void *high_prio_thread(void *arg)
 		busy_work_ms(high_work_time);
 		pthread_mutex_unlock(&lock);
 
-		rec.x = i;
-		rec.y = high_get_lock / NS_PER_US;
-		stats_container_append(&cpu_delay_dat, rec);
+		stats_stream_record(&cpu_delay_stream, high_get_lock / NS_PER_US);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = high_get_lock / NS_PER_US;
+			stats_container_append(&cpu_delay_dat, rec);
+		}
 
 		/* Wait for all threads to finish this iteration */
 		pthread_barrier_wait(&bar2);
 	}
 
-	stats_hist(&cpu_delay_hist, &cpu_delay_dat);
-	stats_container_save("samples", "pi_perf Latency Scatter Plot",
-			     "Iteration", "Latency (us)", &cpu_delay_dat,
-			     "points");
+	stats_stream_hist(&cpu_delay_hist, &cpu_delay_stream);
+	if (save_stats) {
+		stats_container_save("samples", "pi_perf Latency Scatter Plot",
+				     "Iteration", "Latency (us)",
+				     &cpu_delay_dat, "points");
+	}
 	stats_container_save("hist", "pi_perf Latency Histogram",
 			     "Latency (us)", "Samples", &cpu_delay_hist,
 			     "steps");
 
 	printf
 	    ("Time taken for high prio thread to get the lock once released by low prio thread\n");
-	printf("Min delay = %ld us\n", stats_min(&cpu_delay_dat));
-	printf("Max delay = %ld us\n", stats_max(&cpu_delay_dat));
-	printf("Average delay = %4.2f us\n", stats_avg(&cpu_delay_dat));
-	printf("Standard Deviation = %4.2f us\n", stats_stddev(&cpu_delay_dat));
+	printf("Min delay = %ld us\n", stats_stream_min(&cpu_delay_stream));
+	printf("Max delay = %ld us\n", stats_stream_max(&cpu_delay_stream));
+	printf("Average delay = %4.2f us\n",
+	       stats_stream_avg(&cpu_delay_stream));
+	printf("Standard Deviation = %4.2f us\n",
+	       stats_stream_stddev(&cpu_delay_stream));
 	printf("Quantiles:\n");
-	stats_quantiles_calc(&cpu_delay_dat, &cpu_delay_quantiles);
+	stats_stream_quantiles_calc(&cpu_delay_stream, &cpu_delay_quantiles);
 	stats_quantiles_print(&cpu_delay_quantiles);
 
-	max_pi_delay = stats_max(&cpu_delay_dat);
+	max_pi_delay = stats_stream_max(&cpu_delay_stream);
 
 	return NULL;
 }
@@ -65,10 +65,12 @@
 #include <linux/unistd.h>
 #include <sys/syscall.h>
 #include <errno.h>
+#include <stdint.h>
 #include <sched.h>
 #include <pthread.h>
 #include <librttest.h>
 #include <libstats.h>
+#include <libtsc.h>
 
 #define gettid() syscall(__NR_gettid)
 
@@ -124,6 +126,191 @@ static void ftrace_write(const char *fmt, ...)
 	}
 }
 
+/*
+ * In-memory trace buffer (-f file). Every thread owns one buffer and is its
+ * only writer, so recording an event is a timestamp read and a few stores:
+ * no locking, no formatting and no syscalls in the timed path. The buffers
+ * are formatted once the threads have been joined, using the trace_marker
+ * line layout and CLOCK_MONOTONIC timestamps, so the dump can be sorted
+ * together with a trace taken with trace_clock=mono.
+ */
+enum trace_type {
+	TRACE_LOOP_START,
+	TRACE_ALL_RUNNING,
+	TRACE_LOOP_END,
+	TRACE_THREAD_START,
+};
+
+struct trace_event {
+	unsigned long long ts;
+	unsigned long long a;
+	unsigned long long b;
+	int type;
+	int cpu;
+	int loop;
+};
+
+struct trace_buf {
+	struct trace_event *events;
+	int nr;
+	int size;
+	long tid;
+	unsigned long dropped;
+} __attribute__ ((aligned(64)));
+
+static char *trace_file;
+static struct trace_buf *trace_bufs;
+static unsigned long long trace_ts_start, trace_ns_start;
+
+static inline unsigned long long trace_clock(void)
+{
+#ifdef TSC_UNSUPPORTED
+	return rt_gettime();
+#else
+	unsigned long long tsc;
+
+	rdtscll(tsc);
+	return tsc;
+#endif
+}
+
+/* Sample the trace clock and CLOCK_MONOTONIC at (about) the same instant */
+static void trace_calibrate(unsigned long long *ts, unsigned long long *ns)
+{
+	unsigned long long t1, t2;
+
+	t1 = trace_clock();
+	*ns = rt_gettime();
+	t2 = trace_clock();
+	*ts = t1 + (t2 - t1) / 2;
+}
+
+static void trace_init(int nr_bufs, int nr_events)
+{
+	int i;
+
+	if (posix_memalign((void **)&trace_bufs, 64,
+			   sizeof(*trace_bufs) * nr_bufs))
+		debug(DBG_ERR, "posix_memalign failed\n");
+	memset(trace_bufs, 0, sizeof(*trace_bufs) * nr_bufs);
+
+	for (i = 0; i < nr_bufs; i++) {
+		trace_bufs[i].size = nr_events;
+		trace_bufs[i].events = calloc(nr_events,
+					      sizeof(struct trace_event));
+		if (!trace_bufs[i].events)
+			debug(DBG_ERR, "calloc trace events failed\n");
+	}
+
+	trace_calibrate(&trace_ts_start, &trace_ns_start);
+}
+
+static inline void trace_event(int id, int type, int loop,
+			       unsigned long long a, unsigned long long b)
+{
+	struct trace_buf *tb = &trace_bufs[id];
+	struct trace_event *ev;
+
+	if (tb->nr >= tb->size) {
+		tb->dropped++;
+		return;
+	}
+
+	ev = &tb->events[tb->nr++];
+	ev->ts = trace_clock();
+	ev->cpu = sched_getcpu();
+	ev->type = type;
+	ev->loop = loop;
+	ev->a = a;
+	ev->b = b;
+}
+
+static int trace_format(char *str, size_t size, struct trace_event *ev,
+			long tid)
+{
+	switch (ev->type) {
+	case TRACE_LOOP_START:
+		return snprintf(str, size, "Loop %d now=%lld", ev->loop, ev->a);
+	case TRACE_ALL_RUNNING:
+		return snprintf(str, size, "All running!!!");
+	case TRACE_LOOP_END:
+		return snprintf(str, size, "Loop %d end now=%lld diff=%lld",
+				ev->loop, ev->a, ev->b);
+	case TRACE_THREAD_START:
+		return snprintf(str, size, "Thread %ld: started %lld diff %lld",
+				tid, ev->a, ev->b);
+	}
+	return snprintf(str, size, "unknown event %d", ev->type);
+}
+
+/*
+ * Write all buffers out merged in timestamp order. Each buffer is already
+ * sorted, so this only has to pick the oldest head on every step.
+ */
+static void trace_dump(int nr_bufs)
+{
+	unsigned long long ts_end, ns_end, ns;
+	long double scale;
+	unsigned long dropped = 0;
+	char msg[128];
+	int pos[nr_bufs];
+	FILE *f;
+	int i;
+
+	trace_calibrate(&ts_end, &ns_end);
+	if (ts_end == trace_ts_start)
+		scale = 1;
+	else
+		scale = (long double)(ns_end - trace_ns_start) /
+			(ts_end - trace_ts_start);
+
+	if (!strcmp(trace_file, "-"))
+		f = stdout;
+	else if (!(f = fopen(trace_file, "w"))) {
+		debug(DBG_WARN, "can't open %s: %s\n", trace_file,
+		      strerror(errno));
+		return;
+	}
+
+	memset(pos, 0, sizeof(pos));
+
+	for (;;) {
+		struct trace_event *ev = NULL;
+		int min = -1;
+
+		for (i = 0; i < nr_bufs; i++) {
+			struct trace_buf *tb = &trace_bufs[i];
+
+			if (pos[i] >= tb->nr)
+				continue;
+			if (!ev || tb->events[pos[i]].ts < ev->ts) {
+				ev = &tb->events[pos[i]];
+				min = i;
+			}
+		}
+		if (!ev)
+			break;
+		pos[min]++;
+
+		ns = trace_ns_start + (unsigned long long)
+			((long double)(ev->ts - trace_ts_start) * scale);
+		trace_format(msg, sizeof(msg), ev, trace_bufs[min].tid);
+		fprintf(f, "%16s-%-5ld [%03d] %5llu.%06llu: "
+			"tracing_mark_write: %s\n", "rt-migrate",
+			trace_bufs[min].tid, ev->cpu, ns / NS_PER_SEC,
+			(ns % NS_PER_SEC) / NS_PER_US, msg);
+	}
+
+	for (i = 0; i < nr_bufs; i++)
+		dropped += trace_bufs[i].dropped;
+	if (dropped)
+		fprintf(f, "# %lu events dropped, trace buffers full\n",
+			dropped);
+
+	if (f != stdout)
+		fclose(f);
+}
+
 #define INTERVAL 100ULL * NS_PER_MS
 #define RUN_INTERVAL 20ULL * NS_PER_MS
 #define NR_RUNS 50
@@ -186,7 +373,10 @@ static void usage()
 	       "-r time     Run time (ms) to busy loop the threads (20)\n"
 	       "-t time     Sleep time (ms) between intervals (100)\n"
 	       "-e time     Max allowed error (microsecs)\n"
-	       "-l loops    Number of iterations to run (50)\n");
+	       "-l loops    Number of iterations to run (50)\n"
+	       "-f file     Record events in memory instead of writing them\n"
+	       "            to trace_marker and dump them to file (- for\n"
+	       "            stdout) after the run\n");
 }
 
 /*
@@ -212,6 +402,9 @@ static int parse_args(int c, char *v)
 	case 'e':
 		max_err = atoi(v) * NS_PER_US;
 		break;
+	case 'f':
+		trace_file = v;
+		break;
 	case '?':
 	case 'h':
 		usage();
@@ -314,6 +507,8 @@ void *start_task(void *data)
 	struct thread *thr = (struct thread *)data;
 	long id = (long)thr->arg;
 	thread_pids[id] = gettid();
+	if (trace_bufs)
+		trace_bufs[id].tid = thread_pids[id];
 	unsigned long long start_time;
 	int ret;
 	int high = 0;
@@ -345,8 +540,12 @@ void *start_task(void *data)
 		}
 		pthread_barrier_wait(&start_barrier);
 		start_time = rt_gettime();
-		ftrace_write("Thread %d: started %lld diff %lld\n",
-			     pid, start_time, start_time - now);
+		if (trace_bufs)
+			trace_event(id, TRACE_THREAD_START, 0, start_time,
+				    start_time - now);
+		else
+			ftrace_write("Thread %d: started %lld diff %lld\n",
+				     pid, start_time, start_time - now);
 		l = busy_loop(start_time);
 		record_time(id, start_time / NS_PER_US, l);
 		pthread_barrier_wait(&end_barrier);
@@ -400,7 +599,7 @@ int main(int argc, char **argv)
 	struct timespec intv;
 	struct sched_param param;
 
-	rt_init("a:r:t:e:l:h:", parse_args, argc, argv);
+	rt_init("a:r:t:e:l:f:h:", parse_args, argc, argv);
 	signal(SIGINT, stop_log);
 
 	if (argc >= (optind + 1))
@@ -446,6 +645,15 @@ int main(int argc, char **argv)
 	if (!thread_pids)
 		debug(DBG_ERR, "malloc thread_pids failed\n");
 
+	/*
+	 * One buffer per task plus one for the main thread. The tasks log one
+	 * event per loop (and one for the final wakeup), main logs three.
+	 */
+	if (trace_file) {
+		trace_init(nr_tasks + 1, 3 * nr_runs + 1);
+		trace_bufs[nr_tasks].tid = gettid();
+	}
+
 	for (i = 0; i < nr_tasks; i++) {
 		threads[i] = create_fifo_thread(start_task, (void *)i,
 						prio_start + i);
@@ -476,18 +684,28 @@ int main(int argc, char **argv)
 
 		now = rt_gettime() / NS_PER_US;
 
-		ftrace_write("Loop %d now=%lld\n", loop, now);
+		if (trace_bufs)
+			trace_event(nr_tasks, TRACE_LOOP_START, loop, now, 0);
+		else
+			ftrace_write("Loop %d now=%lld\n", loop, now);
 
 		pthread_barrier_wait(&start_barrier);
 
-		ftrace_write("All running!!!\n");
+		if (trace_bufs)
+			trace_event(nr_tasks, TRACE_ALL_RUNNING, loop, 0, 0);
+		else
+			ftrace_write("All running!!!\n");
 
 		rt_nanosleep(intv.tv_nsec);
 		print_progress_bar((loop * 100) / nr_runs);
 
 		end = rt_gettime() / NS_PER_US;
-		ftrace_write("Loop %d end now=%lld diff=%lld\n",
-			     loop, end, end - now);
+		if (trace_bufs)
+			trace_event(nr_tasks, TRACE_LOOP_END, loop, end,
+				    end - now);
+		else
+			ftrace_write("Loop %d end now=%lld diff=%lld\n",
+				     loop, end, end - now);
 		ret = pthread_barrier_wait(&end_barrier);
 
 		if (stop || (check && check_times(loop))) {
@@ -503,6 +721,8 @@ int main(int argc, char **argv)
 	pthread_barrier_wait(&end_barrier);
 
 	join_threads();
+	if (trace_bufs)
+		trace_dump(nr_tasks + 1);
 	print_results();
 
 	if (stop) {
@@ -117,12 +117,15 @@ void *thread_worker(void *arg)
 	struct timespec start, stop;
 	int i;
 	unsigned long long delta;
-	unsigned long long min = -1, max = 0;
 
+	stats_stream_t stream;
 	stats_container_t dat;
 	stats_record_t rec;
 
-	stats_container_init(&dat, NUMRUNS);
+	/* the samples are only kept when they are going to be saved */
+	stats_stream_init(&stream);
+	if (save_stats)
+		stats_container_init(&dat, NUMRUNS);
 
 	for (i = 0; i < NUMRUNS; i++) {
 
@@ -133,24 +136,25 @@ void *thread_worker(void *arg)
 		do_work(NUMLOOPS);
 		clock_gettime(CLOCK_MONOTONIC, &stop);
 
-		/* calc delta, min and max */
 		delta = ts_sub(stop, start);
-		if (delta < min)
-			min = delta;
-		if (delta > max)
-			max = delta;
-		rec.x = i;
-		rec.y = delta;
-		stats_container_append(&dat, rec);
+		stats_stream_record(&stream, delta);
+		if (save_stats) {
+			rec.x = i;
+			rec.y = delta;
+			stats_container_append(&dat, rec);
+		}
 
 		printf("delta: %llu ns\n", delta);
 		usleep(1);	/* let other things happen */
 	}
 
 	printf("max jitter: ");
-	print_unit(max - min);
-	stats_container_save("samples", "Scheduling Jitter Scatter Plot",
-			     "Iteration", "Delay (ns)", &dat, "points");
+	print_unit(stats_stream_max(&stream) - stats_stream_min(&stream));
+	if (save_stats) {
+		stats_container_save("samples", "Scheduling Jitter Scatter Plot",
+				     "Iteration", "Delay (ns)", &dat, "points");
+		stats_container_free(&dat);
+	}
 	return NULL;
 }
 
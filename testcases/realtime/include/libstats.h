@@ -45,6 +45,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <math.h>
+#include "tst_hist.h"
 
 #define MIN(A,B) ((A)<(B)?(A):(B))
 #define MAX(A,B) ((A)>(B)?(A):(B))
@@ -72,6 +73,22 @@ typedef struct stats_quantiles {
 	long *quantiles;
 } stats_quantiles_t;
 
+/*
+ * Log-linear histogram buckets of the streaming statistics, see tst_hist.h,
+ * the relative error of the reported values is below 1/64.
+ */
+#define STATS_STREAM_SUB_BITS	7
+#define STATS_STREAM_BUCKETS	TST_HIST_BUCKETS(STATS_STREAM_SUB_BITS)
+
+typedef struct stats_stream {
+	long count;
+	long min;
+	long max;
+	double mean;
+	double m2;
+	unsigned long long buckets[STATS_STREAM_BUCKETS];
+} stats_stream_t;
+
 extern int save_stats;
 
 /* function prototypes */
@@ -170,4 +187,56 @@ int stats_container_save(char *filename, char *title, char *labelx, char *labely
  * Returns the index of the appended record on success and -1 on error
  */
 int stats_container_append(stats_container_t *data, stats_record_t rec);
+
+/* stats_stream_init - reset streaming statistics, unlike stats_container_t
+ * the memory used does not depend on the number of samples
+ * s: stats_stream_t to initialize
+ */
+void stats_stream_init(stats_stream_t *s);
+
+/* stats_stream_record - account one sample, O(1)
+ * s: stats_stream_t to record the sample into
+ * y: the sample value
+ */
+void stats_stream_record(stats_stream_t *s, long y);
+
+/* stats_stream_merge - add all samples recorded in src to dst
+ * dst: stats_stream_t to merge into
+ * src: stats_stream_t to merge from
+ */
+void stats_stream_merge(stats_stream_t *dst, stats_stream_t *src);
+
+/* stats_stream_min - return the exact minimum of the recorded samples */
+long stats_stream_min(stats_stream_t *s);
+
+/* stats_stream_max - return the exact maximum of the recorded samples */
+long stats_stream_max(stats_stream_t *s);
+
+/* stats_stream_avg - return the average (mean) of the recorded samples */
+float stats_stream_avg(stats_stream_t *s);
+
+/* stats_stream_stddev - return the standard deviation of the recorded samples */
+float stats_stream_stddev(stats_stream_t *s);
+
+/* stats_stream_quantiles_calc - calculate the quantiles of the recorded
+ * samples, the values are rounded up to the histogram bucket boundaries
+ * s: stats_stream_t with the recorded samples
+ * quantiles: stats_quantiles_t structure for storing the results
+ */
+int stats_stream_quantiles_calc(stats_stream_t *s, stats_quantiles_t *quantiles);
+
+/* stats_stream_percentile - return the value below which the given
+ * percentage of the recorded samples falls, rounded up to the histogram
+ * bucket boundary
+ * s: stats_stream_t with the recorded samples
+ * percent: the percentile to compute, 0 to 100
+ */
+long stats_stream_percentile(stats_stream_t *s, double percent);
+
+/* stats_stream_hist - calculate a histogram with hist->size divisions from
+ * the recorded samples, compatible with stats_hist_print()
+ * hist: the destination of the histogram data
+ * s: stats_stream_t with the recorded samples
+ */
+int stats_stream_hist(stats_container_t *hist, stats_stream_t *s);
 #endif /* LIBSTAT_H */
@@ -32,6 +32,7 @@
  * HISTORY
  *	  2006-Oct-17: Initial version by Darren Hart
  *	  2009-Jul-22: Addition of stats_container_append function by Kiran Prakash
+ *	  2026-Oct-18: Addition of the constant memory stats_stream functions
  *
  * TODO: the save routine for gnuplot plotting should be more modular...
  *
@@ -310,6 +311,137 @@ void stats_hist_print(stats_container_t * hist)
 	}
 }
 
+void stats_stream_init(stats_stream_t * s)
+{
+	memset(s, 0, sizeof(*s));
+}
+
+void stats_stream_record(stats_stream_t * s, long y)
+{
+	double delta;
+
+	if (!s->count || y < s->min)
+		s->min = y;
+	if (!s->count || y > s->max)
+		s->max = y;
+
+	/* Welford's running mean and sum of squared differences */
+	s->count++;
+	delta = y - s->mean;
+	s->mean += delta / s->count;
+	s->m2 += delta * (y - s->mean);
+
+	s->buckets[tst_hist_bucket(STATS_STREAM_SUB_BITS, y < 0 ? 0 : y)]++;
+}
+
+void stats_stream_merge(stats_stream_t * dst, stats_stream_t * src)
+{
+	long n;
+	double delta;
+
+	if (!src->count)
+		return;
+
+	if (!dst->count) {
+		memcpy(dst, src, sizeof(*dst));
+		return;
+	}
+
+	n = dst->count + src->count;
+	delta = src->mean - dst->mean;
+	dst->m2 += src->m2 + delta * delta * dst->count * src->count / n;
+	dst->mean += delta * src->count / n;
+	dst->count = n;
+	dst->min = MIN(dst->min, src->min);
+	dst->max = MAX(dst->max, src->max);
+
+	tst_hist_merge(STATS_STREAM_SUB_BITS, dst->buckets, src->buckets);
+}
+
+long stats_stream_min(stats_stream_t * s)
+{
+	return s->min;
+}
+
+long stats_stream_max(stats_stream_t * s)
+{
+	return s->max;
+}
+
+float stats_stream_avg(stats_stream_t * s)
+{
+	return s->mean;
+}
+
+float stats_stream_stddev(stats_stream_t * s)
+{
+	if (!s->count)
+		return 0.0;
+
+	return sqrt(s->m2 / s->count);
+}
+
+int stats_stream_quantiles_calc(stats_stream_t * s,
+				stats_quantiles_t * quantiles)
+{
+	int i;
+	long rank, y;
+
+	// check for sufficient data size of accurate calculation
+	if (!s->count || s->count < (long)exp10(quantiles->nines))
+		return -1;
+
+	/* same ranks as stats_quantiles_calc() picks from the sorted data */
+	for (i = 2; i <= quantiles->nines; i++) {
+		rank = s->count - s->count / exp10(i) + 1;
+		y = tst_hist_rank(STATS_STREAM_SUB_BITS, s->buckets, rank,
+				  MAX(s->max, 0));
+		quantiles->quantiles[i - 2] = MIN(y, s->max);
+	}
+	return 0;
+}
+
+long stats_stream_percentile(stats_stream_t * s, double percent)
+{
+	long y;
+
+	if (!s->count)
+		return 0;
+
+	/* clamped to max >= 0, negative samples all fall into bucket 0 */
+	y = tst_hist_percentile(STATS_STREAM_SUB_BITS, s->buckets, s->count,
+				MAX(s->max, 0), percent);
+
+	return MAX(MIN(y, s->max), s->min);
+}
+
+int stats_stream_hist(stats_container_t * hist, stats_stream_t * s)
+{
+	long i, b, y, width;
+
+	if (hist->size <= 0 || !s->count)
+		return -1;
+
+	/* define the bucket ranges */
+	width = MAX((s->max - s->min) / hist->size, 1);
+	for (i = 0; i < hist->size; i++) {
+		hist->records[i].x = s->min + i * width;
+		hist->records[i].y = 0;
+	}
+
+	/* fill in the counts, each log bucket is accounted at its top */
+	for (i = 0; i < STATS_STREAM_BUCKETS; i++) {
+		if (!s->buckets[i])
+			continue;
+		y = tst_hist_bucket_max(STATS_STREAM_SUB_BITS, i);
+		y = MAX(MIN(y, s->max), s->min);
+		b = MIN((y - s->min) / width, hist->size - 1);
+		hist->records[b].y += s->buckets[i];
+	}
+
+	return 0;
+}
+
 int stats_container_save(char *filename, char *title, char *xlabel,
 			 char *ylabel, stats_container_t * data, char *mode)
 {
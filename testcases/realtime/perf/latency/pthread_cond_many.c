@@ -22,6 +22,12 @@
  * DESCRIPTION
  *      Measure pthread_cond_t latencies , but in presence of many processes.
  *
+ *      With --wakeup, --placement or --sweep it becomes a wakeup scalability
+ *      benchmark instead: all the threads block on a condvar, futex, eventfd
+ *      or pipe, the main thread wakes them either one by one or with a single
+ *      broadcast and the latency from the wakeup call to each thread running
+ *      is reported as percentiles per thread count and CPU placement.
+ *
  * USAGE:
  *      Use run_auto.sh script in current directory to build and run test.
  *
@@ -30,6 +36,7 @@
  *
  * HISTORY
  *      librttest parsing, threading, and mutex initialization - Darren Hart
+ *      wakeup scalability benchmark mode
  *
  *
  *      This line has to be added to avoid a stupid CVS problem
@@ -43,10 +50,15 @@
 #include <string.h>
 #include <sys/poll.h>
 #include <sys/types.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
 #include <unistd.h>
 #include <librttest.h>
 #include <libstats.h>
 #define PASS_US 100
+#define SETTLE_US 100
 pthread_mutex_t child_mutex;
 volatile int *child_waiting = NULL;
 double endtime;
@@ -57,6 +69,49 @@ int realtime = 0;
 int broadcast_flag = 0;
 unsigned long latency = 0;
 int fail = 0;
+
+enum wake_mech { WAKE_COND, WAKE_FUTEX, WAKE_EVENTFD, WAKE_PIPE, WAKE_MECHS };
+enum placement { PLACE_NONE, PLACE_SAME, PLACE_SPREAD, PLACEMENTS };
+
+static const char *mech_names[] = { "cond", "futex", "eventfd", "pipe" };
+static const char *place_names[] = { "none", "same", "spread" };
+
+/* -1 = all of them, set by --wakeup and --placement */
+int bench_mech = -1;
+int bench_place = -1;
+int bench = 0;
+int sweep = 0;
+
+/* Per thread wakeup objects, each on its own cache line */
+struct waiter {
+	pthread_t tid;
+	int cpu;
+	volatile int gen;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int efd;
+	int pipefd[2];
+	nsec_t woken;
+} __attribute__ ((aligned(64)));
+
+struct bench_state {
+	int mech;
+	int nthreads;
+	int rounds;
+	volatile int gen;
+	volatile int armed;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int efd;
+	int pipefd[2];
+	pthread_barrier_t barrier;
+	struct waiter *w;
+	nsec_t *waketime;
+};
+
+static struct bench_state bs;
+static stats_stream_t bench_stats;
+static cpu_set_t allowed_cpus;
 /*
  * Return time as a floating-point number rather than struct timeval.
  */
@@ -99,14 +154,12 @@ void *childfunc(void *arg)
 	pthread_exit(NULL);
 }
 
-pthread_t create_thread_(int itsid)
+void init_thread_attr(pthread_attr_t *attr)
 {
-	pthread_attr_t attr;
-	pthread_t childid;
 	int prio;
 	struct sched_param schparm;
 
-	if (pthread_attr_init(&attr) != 0) {
+	if (pthread_attr_init(attr) != 0) {
 		perror("pthread_attr_init");
 		exit(-1);
 	}
@@ -122,19 +175,27 @@ pthread_t create_thread_(int itsid)
 			exit(-1);
 		}
 
-		if (pthread_attr_setschedpolicy(&attr, SCHED_FIFO) != 0) {
+		if (pthread_attr_setschedpolicy(attr, SCHED_FIFO) != 0) {
 			perror("pthread_attr_setschedpolicy");
 			exit(-1);
 		}
-		if (pthread_attr_setschedparam(&attr, &schparm) != 0) {
+		if (pthread_attr_setschedparam(attr, &schparm) != 0) {
 			perror("pthread_attr_setschedparam");
 			exit(-1);
 		}
 	}
-	if (pthread_attr_setstacksize(&attr, (size_t) (32 * 1024)) != 0) {
+	if (pthread_attr_setstacksize(attr, (size_t) (32 * 1024)) != 0) {
 		perror("pthread_attr_setstacksize");
 		exit(-1);
 	}
+}
+
+pthread_t create_thread_(int itsid)
+{
+	pthread_attr_t attr;
+	pthread_t childid;
+
+	init_thread_attr(&attr);
 	if (pthread_cond_init(&condlist[itsid], NULL) != 0) {
 		perror("pthread_cond_init");
 		exit(-1);
@@ -242,6 +303,335 @@ void test_signal(long iter, long nthreads)
 	printf("Standard Deviation: %f\n", stats_stddev(&dat));
 }
 
+static int futex(volatile int *uaddr, int op, int val)
+{
+	return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+/* Returns the n-th CPU (modulo their count) the test is allowed to run on */
+static int nth_cpu(int n)
+{
+	int cpu, i = 0;
+
+	n %= CPU_COUNT(&allowed_cpus);
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &allowed_cpus) && i++ == n)
+			return cpu;
+	}
+	return 0;
+}
+
+static void pin_to(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0) {
+		set = allowed_cpus;
+	} else {
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+	}
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		perror("sched_setaffinity");
+		exit(-1);
+	}
+}
+
+/*
+ * Blocks the calling thread until round gen is started by bench_wake().
+ * In broadcast mode all threads share one wakeup object, otherwise each
+ * thread has its own, for WAKE_COND including the mutex, so that no waiter
+ * has to wait for the waker to signal the others before it can return.
+ */
+static void bench_block(struct waiter *w, int gen)
+{
+	volatile int *genp = broadcast_flag ? &bs.gen : &w->gen;
+	pthread_mutex_t *mp = broadcast_flag ? &bs.mutex : &w->mutex;
+	pthread_cond_t *cp = broadcast_flag ? &bs.cond : &w->cond;
+	int efd = broadcast_flag ? bs.efd : w->efd;
+	int rfd = broadcast_flag ? bs.pipefd[0] : w->pipefd[0];
+	uint64_t val;
+	char c;
+	int cur;
+
+	switch (bs.mech) {
+	case WAKE_COND:
+		pthread_mutex_lock(mp);
+		__sync_fetch_and_add(&bs.armed, 1);
+		while (*genp < gen) {
+			if (pthread_cond_wait(cp, mp) != 0) {
+				perror("pthread_cond_wait");
+				exit(-1);
+			}
+		}
+		pthread_mutex_unlock(mp);
+		break;
+	case WAKE_FUTEX:
+		__sync_fetch_and_add(&bs.armed, 1);
+		while ((cur = *genp) < gen)
+			futex(genp, FUTEX_WAIT_PRIVATE, cur);
+		break;
+	case WAKE_EVENTFD:
+		__sync_fetch_and_add(&bs.armed, 1);
+		if (read(efd, &val, sizeof(val)) != sizeof(val)) {
+			perror("read eventfd");
+			exit(-1);
+		}
+		break;
+	case WAKE_PIPE:
+		__sync_fetch_and_add(&bs.armed, 1);
+		if (read(rfd, &c, 1) != 1) {
+			perror("read pipe");
+			exit(-1);
+		}
+		break;
+	}
+}
+
+/*
+ * Starts round gen, records the time of each wakeup call in bs.waketime.
+ * The time is taken before gen is published, as a spinning or already
+ * running waiter may see gen and take its own timestamp right away.
+ */
+static void bench_wake(int gen)
+{
+	uint64_t val = broadcast_flag ? bs.nthreads : 1;
+	char buf[bs.nthreads];
+	struct waiter *w;
+	int i, n;
+
+	memset(buf, 0, sizeof(buf));
+
+	if (broadcast_flag) {
+		if (bs.mech == WAKE_COND)
+			pthread_mutex_lock(&bs.mutex);
+		bs.waketime[0] = rt_gettime();
+		for (i = 1; i < bs.nthreads; i++)
+			bs.waketime[i] = bs.waketime[0];
+		bs.gen = gen;
+		switch (bs.mech) {
+		case WAKE_COND:
+			pthread_cond_broadcast(&bs.cond);
+			break;
+		case WAKE_FUTEX:
+			futex(&bs.gen, FUTEX_WAKE_PRIVATE, INT_MAX);
+			break;
+		case WAKE_EVENTFD:
+			n = write(bs.efd, &val, sizeof(val));
+			break;
+		case WAKE_PIPE:
+			n = write(bs.pipefd[1], buf, bs.nthreads);
+			break;
+		}
+		if (bs.mech == WAKE_COND)
+			pthread_mutex_unlock(&bs.mutex);
+	} else {
+		for (i = 0; i < bs.nthreads; i++) {
+			w = &bs.w[i];
+			if (bs.mech == WAKE_COND)
+				pthread_mutex_lock(&w->mutex);
+			bs.waketime[i] = rt_gettime();
+			w->gen = gen;
+			switch (bs.mech) {
+			case WAKE_COND:
+				pthread_cond_signal(&w->cond);
+				pthread_mutex_unlock(&w->mutex);
+				break;
+			case WAKE_FUTEX:
+				futex(&w->gen, FUTEX_WAKE_PRIVATE, 1);
+				break;
+			case WAKE_EVENTFD:
+				n = write(w->efd, &val, sizeof(val));
+				break;
+			case WAKE_PIPE:
+				n = write(w->pipefd[1], buf, 1);
+				break;
+			}
+		}
+	}
+
+	(void)n;
+}
+
+static void *bench_waiter(void *arg)
+{
+	struct waiter *w = arg;
+	int gen;
+
+	if (w->cpu >= 0)
+		pin_to(w->cpu);
+
+	for (gen = 1; gen <= bs.rounds; gen++) {
+		bench_block(w, gen);
+		w->woken = rt_gettime();
+		/* don't let anybody block for the next round until all woke */
+		pthread_barrier_wait(&bs.barrier);
+	}
+
+	return NULL;
+}
+
+static void bench_objects(int create)
+{
+	int i;
+
+	if (!create) {
+		close(bs.efd);
+		close(bs.pipefd[0]);
+		close(bs.pipefd[1]);
+		for (i = 0; i < bs.nthreads; i++) {
+			close(bs.w[i].efd);
+			close(bs.w[i].pipefd[0]);
+			close(bs.w[i].pipefd[1]);
+		}
+		return;
+	}
+
+	bs.efd = eventfd(0, EFD_SEMAPHORE);
+	if (bs.efd < 0 || pipe(bs.pipefd)) {
+		perror("eventfd/pipe");
+		exit(-1);
+	}
+	for (i = 0; i < bs.nthreads; i++) {
+		bs.w[i].efd = eventfd(0, EFD_SEMAPHORE);
+		if (bs.w[i].efd < 0 || pipe(bs.w[i].pipefd)) {
+			perror("eventfd/pipe");
+			exit(-1);
+		}
+	}
+}
+
+/* Runs one configuration and prints its latency percentiles */
+static void bench_run(int mech, int place, int nthreads, int rounds)
+{
+	pthread_attr_t attr;
+	int i, gen;
+
+	memset(&bs, 0, sizeof(bs));
+	bs.mech = mech;
+	bs.nthreads = nthreads;
+	bs.rounds = rounds;
+	bs.w = calloc(nthreads, sizeof(*bs.w));
+	bs.waketime = calloc(nthreads, sizeof(*bs.waketime));
+	if (!bs.w || !bs.waketime) {
+		fprintf(stderr, "Out of memory\n");
+		exit(-1);
+	}
+	init_pi_mutex(&bs.mutex);
+	pthread_cond_init(&bs.cond, NULL);
+	pthread_barrier_init(&bs.barrier, NULL, nthreads + 1);
+	bench_objects(1);
+	stats_stream_init(&bench_stats);
+
+	/* the waker always runs on the first CPU unless unpinned */
+	pin_to(place == PLACE_NONE ? -1 : nth_cpu(0));
+
+	init_thread_attr(&attr);
+	for (i = 0; i < nthreads; i++) {
+		switch (place) {
+		case PLACE_NONE:
+			bs.w[i].cpu = -1;
+			break;
+		case PLACE_SAME:
+			bs.w[i].cpu = nth_cpu(0);
+			break;
+		case PLACE_SPREAD:
+			bs.w[i].cpu = nth_cpu(i + 1);
+			break;
+		}
+		init_pi_mutex(&bs.w[i].mutex);
+		pthread_cond_init(&bs.w[i].cond, NULL);
+		if (pthread_create(&bs.w[i].tid, &attr, bench_waiter,
+				   &bs.w[i]) != 0) {
+			perror("pthread_create");
+			exit(-1);
+		}
+	}
+
+	for (gen = 1; gen <= rounds; gen++) {
+		while (bs.armed < nthreads)
+			sched_yield();
+		/* let the last ones to arm actually block in the kernel */
+		usleep(SETTLE_US);
+		bs.armed = 0;
+
+		bench_wake(gen);
+		pthread_barrier_wait(&bs.barrier);
+
+		for (i = 0; i < nthreads; i++)
+			stats_stream_record(&bench_stats,
+					    bs.w[i].woken - bs.waketime[i]);
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(bs.w[i].tid, NULL);
+		pthread_cond_destroy(&bs.w[i].cond);
+		pthread_mutex_destroy(&bs.w[i].mutex);
+	}
+	pin_to(-1);
+	bench_objects(0);
+	pthread_barrier_destroy(&bs.barrier);
+	pthread_cond_destroy(&bs.cond);
+	free(bs.w);
+	free(bs.waketime);
+
+	printf("%-8s %-9s %7d %8ld %8ld %8ld %8ld %8ld %8ld %8ld\n",
+	       mech_names[mech], place_names[place], nthreads,
+	       bench_stats.count, stats_stream_min(&bench_stats),
+	       stats_stream_percentile(&bench_stats, 50),
+	       stats_stream_percentile(&bench_stats, 90),
+	       stats_stream_percentile(&bench_stats, 99),
+	       stats_stream_percentile(&bench_stats, 99.9),
+	       stats_stream_max(&bench_stats));
+	fflush(stdout);
+}
+
+void test_bench(long iter, long nthreads)
+{
+	int mech, place, n;
+
+	if (sched_getaffinity(0, sizeof(allowed_cpus), &allowed_cpus) != 0) {
+		perror("sched_getaffinity");
+		exit(-1);
+	}
+
+	printf("Wakeup latency (ns) with %s, %ld rounds per configuration\n",
+	       broadcast_flag ? "one broadcast" : "one wakeup per thread",
+	       iter);
+	printf("%-8s %-9s %7s %8s %8s %8s %8s %8s %8s %8s\n", "wakeup",
+	       "placement", "threads", "wakes", "min", "p50", "p90", "p99",
+	       "p99.9", "max");
+
+	for (mech = 0; mech < WAKE_MECHS; mech++) {
+		if (bench_mech >= 0 && mech != bench_mech)
+			continue;
+		for (place = 0; place < PLACEMENTS; place++) {
+			if (bench_place >= 0 && place != bench_place)
+				continue;
+			/* 1, 2, 4, ... nthreads */
+			for (n = sweep ? 1 : nthreads; n < nthreads; n *= 2)
+				bench_run(mech, place, n, iter);
+			bench_run(mech, place, nthreads, iter);
+		}
+	}
+}
+
+static int name_index(const char *names[], int cnt, const char *name)
+{
+	int i;
+
+	if (!strcmp(name, "all"))
+		return -1;
+
+	for (i = 0; i < cnt; i++) {
+		if (!strcmp(names[i], name))
+			return i;
+	}
+
+	fprintf(stderr, "Unknown value '%s'\n", name);
+	exit(1);
+}
+
 void usage(void)
 {
 	rt_help();
@@ -250,6 +640,11 @@ void usage(void)
 	printf("  -b,--broadcast  use cond_broadcast instead of cond_signal\n");
 	printf("  -iITERATIONS    iterations (required)\n");
 	printf("  -nNTHREADS      number of threads (required)\n");
+	printf("  -w,--wakeup=M   benchmark wakeups through M: cond, futex,\n");
+	printf("                  eventfd, pipe or all (default)\n");
+	printf("  -P,--placement=P  benchmark with threads placed P: none,\n");
+	printf("                  same (CPU), spread or all (default)\n");
+	printf("  -S,--sweep      benchmark 1, 2, 4, ... NTHREADS threads\n");
 	printf("deprecated unnamed arguments:\n");
 	printf("  pthread_cond_many [options] iterations nthreads\n");
 }
@@ -273,6 +668,18 @@ int parse_args(int c, char *v)
 	case 'r':
 		realtime = 1;
 		break;
+	case 'w':
+		bench = 1;
+		bench_mech = name_index(mech_names, WAKE_MECHS, v);
+		break;
+	case 'P':
+		bench = 1;
+		bench_place = name_index(place_names, PLACEMENTS, v);
+		break;
+	case 'S':
+		bench = 1;
+		sweep = 1;
+		break;
 	default:
 		handled = 0;
 		break;
@@ -285,12 +692,15 @@ int main(int argc, char *argv[])
 	struct option longopts[] = {
 		{"broadcast", 0, NULL, 'a'},
 		{"realtime", 0, NULL, 'r'},
+		{"wakeup", 1, NULL, 'w'},
+		{"placement", 1, NULL, 'P'},
+		{"sweep", 0, NULL, 'S'},
 		{NULL, 0, NULL, 0},
 	};
 	setup();
 
 	init_pi_mutex(&child_mutex);
-	rt_init_long("ahi:n:r", longopts, parse_args, argc, argv);
+	rt_init_long("ahi:n:rw:P:S", longopts, parse_args, argc, argv);
 
 	/* Legacy command line arguments support, overrides getopt args. */
 	if (optind < argc)
@@ -304,6 +714,11 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
+	if (bench) {
+		test_bench(iterations, nthreads);
+		return 0;
+	}
+
 	child_waiting = malloc(sizeof(*child_waiting) * nthreads);
 	condlist = malloc(sizeof(*condlist) * nthreads);
 	if ((child_waiting == NULL) || (condlist == NULL)) {
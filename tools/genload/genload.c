@@ -17,16 +17,20 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#define _GNU_SOURCE
+
 #include <ctype.h>
 #include <errno.h>
 #include <libgen.h>
 #include <math.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
 
 /* By default, print all messages of severity info and above.  */
@@ -50,6 +54,17 @@ static char *global_progname = PACKAGE;
 /* By default, do not hang after allocating memory.  */
 static int global_vmhang = 0;
 
+/* By default, do not pin workers to CPUs.  */
+static int *global_cpus = NULL;
+static int global_ncpus = 0;
+
+/* By default, work for the whole of each 100ms duty cycle period.  */
+static int global_duty = 100;
+static long long global_period = 100000;
+
+/* By default, do not report the load achieved by each worker.  */
+static int global_report = 0;
+
 /* Implemention of runtime-selectable severity message printing.  */
 #define dbg if (global_debug >= 3) \
             fprintf (stdout, "%s: debug: (%d) ", global_progname, __LINE__), \
@@ -73,17 +88,46 @@ static int global_vmhang = 0;
               exit (1); \
             }
 
+/* Pacing and load accounting state of a single worker.  */
+struct pace {
+	const char *name;	/* name of the hog, for reports */
+	const char *unit;	/* unit of work, for reports */
+	double scale;		/* units per reported unit */
+	double rate;		/* target units per second, 0 for unlimited */
+	long long busy;		/* busy part of each duty cycle period in ns */
+	long long period;	/* duty cycle period in ns */
+	long long report;	/* report interval in ns, 0 for none */
+	long long start;	/* start of the current rate window */
+	long long units;	/* units done in the current rate window */
+	long long period_start;	/* start of the current duty cycle period */
+	long long total;	/* units done since the worker started */
+	long long last;		/* time of the last report */
+	long long last_total;	/* units done at the last report */
+	long long last_cpu;	/* cpu time used at the last report */
+	long long last_faults;	/* page faults taken at the last report */
+	int unpaced;		/* nothing to pace nor to report */
+};
+
 /* Prototypes for utility functions.  */
 int usage(int status);
 int version(int status);
 long long atoll_s(const char *nptr);
 long long atoll_b(const char *nptr);
+int parse_cpus(const char *list);
+
+/* Prototypes for the pacing functions.  */
+void worker_init(struct pace *p, const char *name, const char *unit,
+		 double scale, long long worker, long long rate);
+void pace(struct pace *p, long long units);
+void pace_report(struct pace *p, long long now);
 
 /* Prototypes for the worker functions.  */
 int hogcpu(long long forks);
-int hogio(long long forks);
-int hogvm(long long forks, long long chunks, long long bytes);
-int hoghdd(long long forks, int clean, long long files, long long bytes);
+int hogio(long long forks, long long rate);
+int hogvm(long long forks, long long chunks, long long bytes, long long rate);
+int hoghdd(long long forks, int clean, long long files, long long bytes,
+	   long long rate);
+int hogcache(long long forks, long long bytes, long long rate);
 
 int main(int argc, char **argv)
 {
@@ -95,17 +139,24 @@ int main(int argc, char **argv)
 	int do_timeout = 0;
 	int do_cpu = 0;		/* Default to 1 fork. */
 	long long do_cpu_forks = 1;
-	int do_io = 0;		/* Default to 1 fork. */
+	int do_io = 0;		/* Default to 1 fork, unlimited rate. */
 	long long do_io_forks = 1;
+	long long do_io_rate = 0;
 	int do_vm = 0;		/* Default to 1 fork, 1 chunk of 256MB.  */
 	long long do_vm_forks = 1;
 	long long do_vm_chunks = 1;
 	long long do_vm_bytes = 256 * 1024 * 1024;
+	long long do_vm_rate = 0;
 	int do_hdd = 0;		/* Default to 1 fork, clean, 1 file of 1GB.  */
 	long long do_hdd_forks = 1;
 	int do_hdd_clean = 0;
 	long long do_hdd_files = 1;
 	long long do_hdd_bytes = 1024 * 1024 * 1024;
+	long long do_hdd_rate = 0;
+	int do_cache = 0;	/* Default to 1 fork, working set of 1MB.  */
+	long long do_cache_forks = 1;
+	long long do_cache_bytes = 1024 * 1024;
+	long long do_cache_rate = 0;
 
 	/* Record our start time.  */
 	if ((starttime = time(NULL)) == -1) {
@@ -158,6 +209,36 @@ int main(int argc, char **argv)
 			assert_arg("--timeout");
 			global_timeout = atoll_s(arg);
 			dbg(stdout, "setting timeout to %ds\n", global_timeout);
+		} else if (strcmp(arg, "--cpu-list") == 0) {
+			assert_arg("--cpu-list");
+			global_ncpus = parse_cpus(arg);
+			dbg(stdout, "pinning workers to %i cpus\n",
+			    global_ncpus);
+		} else if (strcmp(arg, "--duty") == 0) {
+			assert_arg("--duty");
+			global_duty = atoll(arg);
+			if (global_duty < 1 || global_duty > 100) {
+				err(stderr, "invalid duty cycle: %i%%\n",
+				    global_duty);
+				exit(1);
+			}
+			dbg(stdout, "setting duty cycle to %i%%\n",
+			    global_duty);
+		} else if (strcmp(arg, "--duty-period") == 0) {
+			assert_arg("--duty-period");
+			global_period = atoll(arg);
+			if (global_period <= 0) {
+				err(stderr, "invalid duty cycle period: %llius\n",
+				    global_period);
+				exit(1);
+			}
+			dbg(stdout, "setting duty cycle period to %llius\n",
+			    global_period);
+		} else if (strcmp(arg, "--report") == 0) {
+			assert_arg("--report");
+			global_report = atoll_s(arg);
+			dbg(stdout, "reporting load every %is\n",
+			    global_report);
 		} else if (strcmp(arg, "--cpu") == 0 || strcmp(arg, "-c") == 0) {
 			do_cpu = 1;
 			assert_arg("--cpu");
@@ -166,6 +247,9 @@ int main(int argc, char **argv)
 			do_io = 1;
 			assert_arg("--io");
 			do_io_forks = atoll_b(arg);
+		} else if (strcmp(arg, "--io-rate") == 0) {
+			assert_arg("--io-rate");
+			do_io_rate = atoll_b(arg);
 		} else if (strcmp(arg, "--vm") == 0 || strcmp(arg, "-m") == 0) {
 			do_vm = 1;
 			assert_arg("--vm");
@@ -178,6 +262,9 @@ int main(int argc, char **argv)
 			do_vm_bytes = atoll_b(arg);
 		} else if (strcmp(arg, "--vm-hang") == 0) {
 			global_vmhang = 1;
+		} else if (strcmp(arg, "--vm-rate") == 0) {
+			assert_arg("--vm-rate");
+			do_vm_rate = atoll_b(arg);
 		} else if (strcmp(arg, "--hdd") == 0 || strcmp(arg, "-d") == 0) {
 			do_hdd = 1;
 			assert_arg("--hdd");
@@ -190,6 +277,19 @@ int main(int argc, char **argv)
 		} else if (strcmp(arg, "--hdd-bytes") == 0) {
 			assert_arg("--hdd-bytes");
 			do_hdd_bytes = atoll_b(arg);
+		} else if (strcmp(arg, "--hdd-rate") == 0) {
+			assert_arg("--hdd-rate");
+			do_hdd_rate = atoll_b(arg);
+		} else if (strcmp(arg, "--cache") == 0) {
+			do_cache = 1;
+			assert_arg("--cache");
+			do_cache_forks = atoll_b(arg);
+		} else if (strcmp(arg, "--cache-bytes") == 0) {
+			assert_arg("--cache-bytes");
+			do_cache_bytes = atoll_b(arg);
+		} else if (strcmp(arg, "--cache-rate") == 0) {
+			assert_arg("--cache-rate");
+			do_cache_rate = atoll_b(arg);
 		} else {
 			err(stderr, "unrecognized option: %s\n", arg);
 			exit(1);
@@ -222,7 +322,7 @@ int main(int argc, char **argv)
 		case 0:	/* child */
 			if (do_dryrun)
 				exit(0);
-			exit(hogio(do_io_forks));
+			exit(hogio(do_io_forks, do_io_rate));
 		case -1:	/* error */
 			err(stderr, "hogio dispatcher fork failed\n");
 			exit(1);
@@ -242,7 +342,8 @@ int main(int argc, char **argv)
 		case 0:	/* child */
 			if (do_dryrun)
 				exit(0);
-			exit(hogvm(do_vm_forks, do_vm_chunks, do_vm_bytes));
+			exit(hogvm(do_vm_forks, do_vm_chunks, do_vm_bytes,
+				   do_vm_rate));
 		case -1:	/* error */
 			err(stderr, "hogvm dispatcher fork failed\n");
 			exit(1);
@@ -263,7 +364,7 @@ int main(int argc, char **argv)
 				exit(0);
 			exit(hoghdd
 			     (do_hdd_forks, do_hdd_clean, do_hdd_files,
-			      do_hdd_bytes));
+			      do_hdd_bytes, do_hdd_rate));
 		case -1:	/* error */
 			err(stderr, "hoghdd dispatcher fork failed\n");
 			exit(1);
@@ -273,6 +374,27 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* Hog cache option.  */
+	if (do_cache) {
+		out(stdout, "dispatching %lli hogcache forks, each streaming "
+		    "over %lli bytes\n", do_cache_forks, do_cache_bytes);
+
+		switch (pid = fork()) {
+		case 0:	/* child */
+			if (do_dryrun)
+				exit(0);
+			exit(hogcache(do_cache_forks, do_cache_bytes,
+				      do_cache_rate));
+		case -1:	/* error */
+			err(stderr, "hogcache dispatcher fork failed\n");
+			exit(1);
+		default:	/* parent */
+			children++;
+			dbg(stdout, "--> hogcache dispatcher forked (%i)\n",
+			    pid);
+		}
+	}
+
 	/* We have no work to do, so bail out.  */
 	if (children == 0)
 		usage(0);
@@ -342,19 +464,29 @@ int usage(int status)
 	    "     --retry-delay n   wait n us before continuing past error\n"
 	    " -t, --timeout n       timeout after n seconds\n"
 	    "     --backoff n       wait for factor of n us before starting work\n"
+	    "     --cpu-list l      pin worker i of each hog to the i-th cpu of l\n"
+	    "     --duty p          work p%% of each duty cycle period, sleep the rest\n"
+	    "     --duty-period n   use a duty cycle period of n us (default is 100ms)\n"
+	    "     --report n        each worker reports its load every n seconds\n"
 	    " -c, --cpu n           spawn n procs spinning on sqrt()\n"
 	    " -i, --io n            spawn n procs spinning on sync()\n"
+	    "     --io-rate r       call sync() at most r times per second\n"
 	    " -m, --vm n            spawn n procs spinning on malloc()\n"
 	    "     --vm-chunks c     malloc c chunks (default is 1)\n"
 	    "     --vm-bytes b      malloc chunks of b bytes (default is 256MB)\n"
 	    "     --vm-hang         hang in a sleep loop after memory allocated\n"
+	    "     --vm-rate r       touch at most r new pages per second\n"
 	    " -d, --hdd n           spawn n procs spinning on write()\n"
 	    "     --hdd-noclean     do not unlink file to which random data written\n"
 	    "     --hdd-files f     write to f files (default is 1)\n"
-	    "     --hdd-bytes b     write b bytes (default is 1GB)\n\n"
+	    "     --hdd-bytes b     write b bytes (default is 1GB)\n"
+	    "     --hdd-rate r      write at most r bytes per second\n"
+	    "     --cache n         spawn n procs streaming over a working set\n"
+	    "     --cache-bytes b   use a working set of b bytes (default is 1MB)\n"
+	    "     --cache-rate r    stream over at most r bytes per second\n\n"
 	    "Infinity is denoted with 0.  For -m, -d: n=0 means infinite redo,\n"
 	    "n<0 means redo abs(n) times. Valid suffixes are m,h,d,y for time;\n"
-	    "k,m,g for size.\n\n";
+	    "k,m,g for size and rates. Rates of 0 mean no limit.\n\n";
 
 	fprintf(stdout, mesg, global_progname, global_progname);
 
@@ -462,11 +594,182 @@ long long atoll_s(const char *nptr)
 	return factor;
 }
 
+/* Parse a comma separated list of cpus and cpu ranges, such as 0-3,6, into
+ * global_cpus.  Returns the number of cpus in the list.
+ */
+int parse_cpus(const char *list)
+{
+	char *copy, *tok, *save;
+	int first, last, n = 0;
+
+	if ((copy = strdup(list)) == NULL) {
+		err(stderr, "strdup failed\n");
+		exit(1);
+	}
+
+	for (tok = strtok_r(copy, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		switch (sscanf(tok, "%d-%d", &first, &last)) {
+		case 1:
+			last = first;
+			break;
+		case 2:
+			break;
+		default:
+			first = -1;
+		}
+
+		if (first < 0 || last < first) {
+			err(stderr, "invalid cpu list: %s\n", list);
+			exit(1);
+		}
+
+		for (; first <= last; first++) {
+			global_cpus = realloc(global_cpus,
+					      (n + 1) * sizeof(*global_cpus));
+			if (global_cpus == NULL) {
+				err(stderr, "realloc failed\n");
+				exit(1);
+			}
+			global_cpus[n++] = first;
+		}
+	}
+
+	free(copy);
+
+	return n;
+}
+
+static long long now_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_until(long long ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000LL;
+	ts.tv_nsec = ns % 1000000000LL;
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) ==
+	       EINTR) ;
+}
+
+static long long page_faults(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	return ru.ru_minflt + ru.ru_majflt;
+}
+
+/* Pin the worker to its cpu, if a cpu list was given, and set up the pacing
+ * of its work.  Must be called by the worker itself.
+ */
+void worker_init(struct pace *p, const char *name, const char *unit,
+		 double scale, long long worker, long long rate)
+{
+	cpu_set_t set;
+	int cpu;
+
+	if (global_ncpus) {
+		cpu = global_cpus[worker % global_ncpus];
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if (sched_setaffinity(0, sizeof(set), &set)) {
+			wrn(stderr, "%s worker failed to pin to cpu %i: %s\n",
+			    name, cpu, strerror(errno));
+		} else {
+			dbg(stdout, "%s worker pinned to cpu %i\n", name, cpu);
+		}
+	}
+
+	memset(p, 0, sizeof(*p));
+	p->name = name;
+	p->unit = unit;
+	p->scale = scale;
+	p->rate = rate;
+	p->period = global_period * 1000;
+	p->busy = p->period * global_duty / 100;
+	p->report = global_report * 1000000000LL;
+	p->unpaced = (rate == 0 && global_duty == 100 && global_report == 0);
+	p->start = p->period_start = p->last = now_ns(CLOCK_MONOTONIC);
+	p->last_cpu = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+	p->last_faults = page_faults();
+}
+
+/* Account for units of work just done, then sleep as long as needed to keep
+ * to the duty cycle and the target rate.  Workers call this often, after
+ * small amounts of work, so that the load they generate stays smooth.
+ */
+void pace(struct pace *p, long long units)
+{
+	long long now, due;
+
+	if (p->unpaced)
+		return;
+
+	p->units += units;
+	p->total += units;
+	now = now_ns(CLOCK_MONOTONIC);
+
+	if (p->busy < p->period && now - p->period_start >= p->busy) {
+		sleep_until(p->period_start + p->period);
+		p->period_start += p->period;
+		now = now_ns(CLOCK_MONOTONIC);
+		/* Do not try to make up for periods that were overrun.  */
+		if (now - p->period_start >= p->period)
+			p->period_start = now;
+	}
+
+	if (p->rate > 0) {
+		due = p->start + (long long)(p->units * 1e9 / p->rate);
+		if (due > now) {
+			sleep_until(due);
+			now = due;
+		} else if (now - due > 1000000000LL) {
+			/* Too far behind to catch up without a burst.  */
+			p->start = now;
+			p->units = 0;
+		}
+	}
+
+	if (p->report && now - p->last >= p->report)
+		pace_report(p, now);
+}
+
+/* Report the load the worker achieved since the previous report.  */
+void pace_report(struct pace *p, long long now)
+{
+	long long cpu = now_ns(CLOCK_PROCESS_CPUTIME_ID);
+	long long faults = page_faults();
+	double secs = (now - p->last) / 1e9;
+
+	out(stdout, "%s worker %i on cpu %i: %.1f %s/s, %.1f%% cpu, "
+	    "%.0f faults/s\n", p->name, getpid(), sched_getcpu(),
+	    (p->total - p->last_total) / p->scale / secs, p->unit,
+	    100.0 * (cpu - p->last_cpu) / (now - p->last),
+	    (faults - p->last_faults) / secs);
+	fflush(stdout);
+
+	p->last = now;
+	p->last_total = p->total;
+	p->last_cpu = cpu;
+	p->last_faults = faults;
+}
+
 int hogcpu(long long forks)
 {
 	long long i;
 	double d;
-	int pid, retval = 0;
+	int k, pid, retval = 0;
+	struct pace p;
 
 	/* Make local copies of global variables.  */
 	int ignore = global_ignore;
@@ -484,8 +787,13 @@ int hogcpu(long long forks)
 			/* Use a backoff sleep to ensure we get good fork throughput.  */
 			usleep(backoff);
 
-			while (1)
-				d = sqrt(rand());
+			worker_init(&p, "hogcpu", "kloops", 1000, i, 0);
+
+			while (1) {
+				for (k = 0; k < 1000; k++)
+					d = sqrt(rand());
+				pace(&p, k);
+			}
 
 			/* This case never falls through; alarm signal can cause exit.  */
 		case -1:	/* error */
@@ -539,10 +847,11 @@ int hogcpu(long long forks)
 	return retval;
 }
 
-int hogio(long long forks)
+int hogio(long long forks, long long rate)
 {
 	long long i;
 	int pid, retval = 0;
+	struct pace p;
 
 	/* Make local copies of global variables.  */
 	int ignore = global_ignore;
@@ -560,8 +869,12 @@ int hogio(long long forks)
 			/* Use a backoff sleep to ensure we get good fork throughput.  */
 			usleep(backoff);
 
-			while (1)
+			worker_init(&p, "hogio", "syncs", 1, i, rate);
+
+			while (1) {
 				sync();
+				pace(&p, 1);
+			}
 
 			/* This case never falls through; alarm signal can cause exit.  */
 		case -1:	/* error */
@@ -614,11 +927,13 @@ int hogio(long long forks)
 	return retval;
 }
 
-int hogvm(long long forks, long long chunks, long long bytes)
+int hogvm(long long forks, long long chunks, long long bytes, long long rate)
 {
 	long long i, j, k;
 	int pid, retval = 0;
 	char **ptr;
+	struct pace p;
+	long long page_mask = sysconf(_SC_PAGESIZE) - 1;
 
 	/* Make local copies of global variables.  */
 	int ignore = global_ignore;
@@ -641,14 +956,19 @@ int hogvm(long long forks, long long chunks, long long bytes)
 			/* Use a backoff sleep to ensure we get good fork throughput.  */
 			usleep(backoff);
 
+			worker_init(&p, "hogvm", "pages", 1, i, rate);
+
 			while (1) {
-				ptr = (char **)malloc(chunks * 2);
+				ptr = (char **)malloc(chunks * sizeof(*ptr));
 				for (j = 0; chunks == 0 || j < chunks; j++) {
 					if ((ptr[j] =
 					     (char *)malloc(bytes *
 							    sizeof(char)))) {
-						for (k = 0; k < bytes; k++)
+						for (k = 0; k < bytes; k++) {
 							ptr[j][k] = 'Z';	/* Ensure that COW happens.  */
+							if ((k & page_mask) == 0)
+								pace(&p, 1);
+						}
 						dbg(stdout,
 						    "hogvm worker malloced %lli bytes\n",
 						    k);
@@ -736,12 +1056,14 @@ int hogvm(long long forks, long long chunks, long long bytes)
 	return retval;
 }
 
-int hoghdd(long long forks, int clean, long long files, long long bytes)
+int hoghdd(long long forks, int clean, long long files, long long bytes,
+	   long long rate)
 {
 	long long i, j;
 	int fd, pid, retval = 0;
 	int chunk = (1024 * 1024) - 1;	/* Minimize slow writing.  */
 	char buff[chunk];
+	struct pace p;
 
 	/* Make local copies of global variables.  */
 	int ignore = global_ignore;
@@ -770,6 +1092,8 @@ int hoghdd(long long forks, int clean, long long files, long long bytes)
 			/* Use a backoff sleep to ensure we get good fork throughput.  */
 			usleep(backoff);
 
+			worker_init(&p, "hoghdd", "MB", 1024 * 1024, i, rate);
+
 			while (1) {
 				for (i = 0; i < files; i++) {
 					char name[] = "./stress.XXXXXX";
@@ -801,6 +1125,7 @@ int hoghdd(long long forks, int clean, long long files, long long bytes)
 							    "write failed\n");
 							exit(1);
 						}
+						pace(&p, chunk);
 					}
 
 					dbg(stdout, "slow writing to %s\n",
@@ -811,6 +1136,7 @@ int hoghdd(long long forks, int clean, long long files, long long bytes)
 							    "write failed\n");
 							exit(1);
 						}
+						pace(&p, 1);
 					}
 					if (write(fd, "\n", 1) != 1) {
 						err(stderr, "write failed\n");
@@ -891,3 +1217,110 @@ int hoghdd(long long forks, int clean, long long files, long long bytes)
 
 	return retval;
 }
+
+int hogcache(long long forks, long long bytes, long long rate)
+{
+	long long i, j, k, end;
+	int pid, retval = 0;
+	volatile char *buf;
+	struct pace p;
+	long line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+	long long chunk = 64 * 1024;	/* Pace every 64KB of the working set.  */
+
+	/* Make local copies of global variables.  */
+	int ignore = global_ignore;
+	int retry = global_retry;
+	int timeout = global_timeout;
+	long backoff = global_backoff * forks;
+
+	if (line <= 0)
+		line = 64;
+
+	if (bytes <= 0) {
+		err(stderr, "invalid hogcache working set size: %lli\n", bytes);
+		return 1;
+	}
+
+	dbg(stdout, "using backoff sleep of %lius for hogcache\n", backoff);
+
+	for (i = 0; forks == 0 || i < forks; i++) {
+		switch (pid = fork()) {
+		case 0:	/* child */
+			alarm(timeout);
+
+			/* Use a backoff sleep to ensure we get good fork throughput.  */
+			usleep(backoff);
+
+			if ((buf = malloc(bytes)) == NULL) {
+				err(stderr, "hogcache malloc failed\n");
+				exit(1);
+			}
+			memset((char *)buf, 'Z', bytes);
+
+			worker_init(&p, "hogcache", "MB", 1024 * 1024, i, rate);
+
+			/* Read and write one word of every cache line of the
+			 * working set; a small working set stays in the cache,
+			 * a large one streams through the memory bus.
+			 */
+			while (1) {
+				for (j = 0; j < bytes; j = end) {
+					end = j + chunk < bytes ? j + chunk : bytes;
+					for (k = j; k < end; k += line)
+						buf[k]++;
+					pace(&p, end - j);
+				}
+			}
+
+			/* This case never falls through; alarm signal can cause exit.  */
+		case -1:	/* error */
+			if (ignore) {
+				++retval;
+				wrn(stderr,
+				    "hogcache worker fork failed, continuing\n");
+				usleep(retry);
+				continue;
+			}
+
+			err(stderr, "hogcache worker fork failed\n");
+			return 1;
+		default:	/* parent */
+			dbg(stdout, "--> hogcache worker forked (%i)\n", pid);
+		}
+	}
+
+	/* Wait for our children to exit.  */
+	while (i) {
+		int status, ret;
+
+		if ((pid = wait(&status)) > 0) {
+			if ((WIFEXITED(status)) != 0) {
+				if ((ret = WEXITSTATUS(status)) != 0) {
+					err(stderr,
+					    "hogcache worker %i exited %i\n",
+					    pid, ret);
+					retval += ret;
+				} else {
+					dbg(stdout,
+					    "<-- hogcache worker exited (%i)\n",
+					    pid);
+				}
+			} else {
+				dbg(stdout,
+				    "<-- hogcache worker signalled (%i)\n",
+				    pid);
+			}
+
+			--i;
+		} else {
+			dbg(stdout, "wait() returned error: %s\n",
+			    strerror(errno));
+			err(stderr,
+			    "detected missing hogcache worker children\n");
+			++retval;
+			break;
+		}
+	}
+
+	return retval;
+}
@@ -12,6 +12,52 @@
 /*     * TCP.h              ---- Include file for TCP calls and data structs */
 /*****************************************************************************/
 #include    "netpipe.h"
+#include    <fcntl.h>
+#include    <poll.h>
+#include    <sys/sendfile.h>
+#include    <sys/uio.h>
+#include    <linux/errqueue.h>
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL                46
+#endif
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY                 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY                0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY       5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED  1
+#endif
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ                1031
+#endif
+
+/* Largest chunk moved through the splice pipe in one go */
+#define SPLICE_PIPESZ               (1024 * 1024)
+
+static const char *mode_names[] = {
+	[TCP_MODE_WRITE] = "write",
+	[TCP_MODE_SENDFILE] = "sendfile",
+	[TCP_MODE_SPLICE] = "splice",
+	[TCP_MODE_ZEROCOPY] = "zerocopy",
+};
+
+int TCPModeByName(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+		if (!strcmp(name, mode_names[i]))
+			return i;
+	}
+
+	return -1;
+}
 
 int Setup(ArgStruct * p)
 {
@@ -31,6 +77,12 @@ int Setup(ArgStruct * p)
 	memset((char *)lsin1, 0x00, sizeof(*lsin1));
 	memset((char *)lsin2, 0x00, sizeof(*lsin2));
 
+	p->prot.filefd = -1;
+	p->prot.filelen = 0;
+	p->prot.pipefd[0] = p->prot.pipefd[1] = -1;
+	p->prot.nullfd = -1;
+	p->prot.zcpending = p->prot.zcdone = p->prot.zccopied = 0;
+
 	if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
 		printf("NetPIPE: can't open stream socket! errno=%d\n", errno);
 		exit(-4);
@@ -132,6 +184,241 @@ static int readFully(int fd, void *obuf, int len)
 	return len;
 }
 
+/*
+   Per connection setup of the busy polling and of the selected data path.
+   Called on the connected socket by both the transmitter and the receiver.
+ */
+static void SetupMode(ArgStruct * p)
+{
+	FILE *f;
+	int one = 1;
+
+	if (p->prot.busypoll > 0 &&
+	    setsockopt(p->commfd, SOL_SOCKET, SO_BUSY_POLL,
+		       &(p->prot.busypoll), sizeof(p->prot.busypoll)) < 0) {
+		printf("NetPIPE: setsockopt: SO_BUSY_POLL failed! errno=%d\n",
+		       errno);
+		exit(557);
+	}
+
+	switch (p->prot.mode) {
+	case TCP_MODE_SENDFILE:
+		if ((f = tmpfile()) == NULL) {
+			printf("NetPIPE: can't create sendfile source! errno=%d\n",
+			       errno);
+			exit(558);
+		}
+		p->prot.filefd = fileno(f);
+		break;
+	case TCP_MODE_SPLICE:
+		if (pipe(p->prot.pipefd) < 0) {
+			printf("NetPIPE: can't create splice pipe! errno=%d\n",
+			       errno);
+			exit(558);
+		}
+		/* Best effort, the default pipe size works too, just slower */
+		fcntl(p->prot.pipefd[1], F_SETPIPE_SZ, SPLICE_PIPESZ);
+		if ((p->prot.nullfd = open("/dev/null", O_WRONLY)) < 0) {
+			printf("NetPIPE: can't open /dev/null! errno=%d\n",
+			       errno);
+			exit(558);
+		}
+		break;
+	case TCP_MODE_ZEROCOPY:
+		if (setsockopt(p->commfd, SOL_SOCKET, SO_ZEROCOPY,
+			       &one, sizeof(one)) < 0) {
+			printf("NetPIPE: setsockopt: SO_ZEROCOPY failed! errno=%d\n",
+			       errno);
+			exit(557);
+		}
+		break;
+	}
+}
+
+/*
+   Makes sure the sendfile source file holds at least bufflen bytes of the
+   transmit buffer, so that sendfile() is served from the page cache.
+ */
+static void FillFile(ArgStruct * p)
+{
+	if (p->prot.filelen >= p->bufflen)
+		return;
+
+	if (pwrite(p->prot.filefd, p->buff, p->bufflen, 0) != p->bufflen) {
+		printf("NetPIPE: sendfile source write failed! errno=%d\n",
+		       errno);
+		exit(402);
+	}
+	p->prot.filelen = p->bufflen;
+}
+
+/*
+   Reaps MSG_ZEROCOPY completion notifications from the socket error queue.
+   With block set waits until all the sends in flight have completed.
+ */
+static void ReapZerocopy(ArgStruct * p, int block)
+{
+	struct pollfd pfd = {.fd = p->commfd,.events = 0 };
+	struct sock_extended_err *serr;
+	struct cmsghdr *cm;
+	struct msghdr msg;
+	char control[128];
+	unsigned long n;
+
+	while (p->prot.zcpending > 0) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(p->commfd, &msg, MSG_ERRQUEUE) < 0) {
+			if (errno != EAGAIN) {
+				printf("NetPIPE: recvmsg: MSG_ERRQUEUE failed! "
+				       "errno=%d\n", errno);
+				exit(403);
+			}
+			if (!block)
+				return;
+			/* POLLERR is always reported, no need to ask for it */
+			poll(&pfd, 1, -1);
+			continue;
+		}
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			serr = (struct sock_extended_err *)CMSG_DATA(cm);
+			if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+			    serr->ee_errno != 0)
+				continue;
+
+			/* [ee_info, ee_data] is the range of completed sends */
+			n = serr->ee_data - serr->ee_info + 1;
+			p->prot.zcpending -= MIN(n, p->prot.zcpending);
+			p->prot.zcdone += n;
+			if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				p->prot.zccopied += n;
+		}
+	}
+}
+
+static void SendFileData(ArgStruct * p)
+{
+	off_t off = 0;
+	ssize_t ret;
+
+	FillFile(p);
+
+	while (off < p->bufflen) {
+		ret = sendfile(p->commfd, p->prot.filefd, &off,
+			       p->bufflen - off);
+		if (ret < 0) {
+			printf("NetPIPE: sendfile: error encountered, errno=%d\n",
+			       errno);
+			exit(401);
+		}
+		/* The file is bufflen long, nothing sent means it shrank */
+		if (ret == 0) {
+			printf("NetPIPE: sendfile: unexpected end of file at "
+			       "offset %ld\n", (long)off);
+			exit(401);
+		}
+	}
+}
+
+static void SendSpliceData(ArgStruct * p)
+{
+	struct iovec iov;
+	ssize_t inpipe, ret;
+	int bytesLeft = p->bufflen;
+	char *q = p->buff;
+
+	while (bytesLeft > 0) {
+		/* Maps the user pages into the pipe, the data is not copied */
+		iov.iov_base = q;
+		iov.iov_len = bytesLeft;
+		inpipe = vmsplice(p->prot.pipefd[1], &iov, 1, 0);
+		if (inpipe < 0) {
+			printf("NetPIPE: vmsplice: error encountered, errno=%d\n",
+			       errno);
+			exit(401);
+		}
+		bytesLeft -= inpipe;
+		q += inpipe;
+
+		while (inpipe > 0) {
+			ret = splice(p->prot.pipefd[0], NULL, p->commfd, NULL,
+				     inpipe, SPLICE_F_MOVE);
+			if (ret <= 0) {
+				printf("NetPIPE: splice: error encountered, "
+				       "errno=%d\n", errno);
+				exit(401);
+			}
+			inpipe -= ret;
+		}
+	}
+}
+
+static void SendZerocopyData(ArgStruct * p)
+{
+	int bytesLeft = p->bufflen;
+	ssize_t ret;
+	char *q = p->buff;
+
+	while (bytesLeft > 0) {
+		ret = send(p->commfd, q, bytesLeft, MSG_ZEROCOPY);
+		if (ret < 0 && errno == ENOBUFS && p->prot.zcpending > 0) {
+			/* Out of optmem for notifications, let them drain */
+			ReapZerocopy(p, 1);
+			continue;
+		}
+		if (ret < 0) {
+			printf("NetPIPE: send: error encountered, errno=%d\n",
+			       errno);
+			exit(401);
+		}
+		p->prot.zcpending++;
+		bytesLeft -= ret;
+		q += ret;
+	}
+
+	ReapZerocopy(p, 0);
+}
+
+/*
+   Receive side of the splice mode, the data is moved from the socket into
+   the pipe and from there to /dev/null without ever reaching userspace.
+ */
+static void RecvSpliceData(ArgStruct * p)
+{
+	ssize_t inpipe, ret;
+	int bytesLeft = p->bufflen;
+
+	while (bytesLeft > 0) {
+		inpipe = splice(p->commfd, NULL, p->prot.pipefd[1], NULL,
+				MIN(bytesLeft, SPLICE_PIPESZ), SPLICE_F_MOVE);
+		if (inpipe == 0) {
+			printf("NetPIPE: \"end of file\" encountered on "
+			       "reading from socket\n");
+			return;
+		}
+		if (inpipe < 0) {
+			printf("NetPIPE: splice: error encountered, errno=%d\n",
+			       errno);
+			exit(401);
+		}
+		bytesLeft -= inpipe;
+
+		while (inpipe > 0) {
+			ret = splice(p->prot.pipefd[0], NULL, p->prot.nullfd,
+				     NULL, inpipe, SPLICE_F_MOVE);
+			if (ret <= 0) {
+				printf("NetPIPE: splice: error encountered, "
+				       "errno=%d\n", errno);
+				exit(401);
+			}
+			inpipe -= ret;
+		}
+	}
+}
+
 void Sync(ArgStruct * p)
 {
 	char s[] = "SyncMe";
@@ -147,6 +434,13 @@ void Sync(ArgStruct * p)
 		fprintf(stderr, "NetPIPE: Synchronization string incorrect!\n");
 		exit(3);
 	}
+
+	/*
+	   Keep filling the sendfile source out of the timed loops, on the
+	   receiver too as it sends the data back unless streaming.
+	 */
+	if (p->prot.mode == TCP_MODE_SENDFILE && p->buff)
+		FillFile(p);
 }
 
 void PrepareToReceive(ArgStruct * p)
@@ -162,6 +456,18 @@ void SendData(ArgStruct * p)
 	int bytesWritten, bytesLeft;
 	char *q;
 
+	switch (p->prot.mode) {
+	case TCP_MODE_SENDFILE:
+		SendFileData(p);
+		return;
+	case TCP_MODE_SPLICE:
+		SendSpliceData(p);
+		return;
+	case TCP_MODE_ZEROCOPY:
+		SendZerocopyData(p);
+		return;
+	}
+
 	bytesLeft = p->bufflen;
 	bytesWritten = 0;
 	q = p->buff;
@@ -182,6 +488,12 @@ void RecvData(ArgStruct * p)
 	int bytesRead;
 	char *q;
 
+	/* sendfile and MSG_ZEROCOPY are send side only, receive with read() */
+	if (p->prot.mode == TCP_MODE_SPLICE) {
+		RecvSpliceData(p);
+		return;
+	}
+
 	bytesLeft = p->bufflen;
 	bytesRead = 0;
 	q = p->buff1;
@@ -337,12 +649,33 @@ int Establish(ArgStruct * p)
 			}
 		}
 	}
+
+	SetupMode(p);
+
 	return (0);
 }
 
 int CleanUp(ArgStruct * p)
 {
-	char *quit = "QUIT";
+	char quit[] = "QUIT";
+
+	if (p->prot.mode == TCP_MODE_ZEROCOPY) {
+		ReapZerocopy(p, 1);
+		if (p->prot.zccopied)
+			fprintf(stderr, "NetPIPE: %lu of %lu MSG_ZEROCOPY sends "
+				"were copied by the kernel\n",
+				p->prot.zccopied, p->prot.zcdone);
+	}
+
+	if (p->prot.filefd >= 0)
+		close(p->prot.filefd);
+	if (p->prot.pipefd[0] >= 0) {
+		close(p->prot.pipefd[0]);
+		close(p->prot.pipefd[1]);
+	}
+	if (p->prot.nullfd >= 0)
+		close(p->prot.nullfd);
+
 	if (p->tr) {
 		write(p->commfd, quit, 5);
 		read(p->commfd, quit, 5);
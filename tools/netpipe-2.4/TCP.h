@@ -8,6 +8,12 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 
+/* Data path used by SendData()/RecvData() */
+#define TCP_MODE_WRITE      0   /* plain write(2)/read(2)                   */
+#define TCP_MODE_SENDFILE   1   /* sendfile(2) from a page cache file       */
+#define TCP_MODE_SPLICE     2   /* vmsplice(2)/splice(2) through a pipe     */
+#define TCP_MODE_ZEROCOPY   3   /* send(2) with MSG_ZEROCOPY                */
+
 typedef struct protocolstruct ProtocolStruct;
 struct protocolstruct
 {
@@ -17,5 +23,16 @@ struct protocolstruct
     struct hostent          *addr;    /* Address of host                */
     int                     sndbufsz, /* Size of TCP send buffer        */
                             rcvbufsz; /* Size of TCP receive buffer     */
+    int                     mode;     /* One of the TCP_MODE_* values    */
+    int                     busypoll; /* SO_BUSY_POLL usecs, 0 = off     */
+    int                     filefd;   /* sendfile source file           */
+    int                     filelen;  /* Bytes valid in filefd          */
+    int                     pipefd[2];/* splice pipe                    */
+    int                     nullfd;   /* splice sink on the receiver    */
+    unsigned long           zcpending,/* MSG_ZEROCOPY sends in flight   */
+                            zcdone,   /* Completed MSG_ZEROCOPY sends   */
+                            zccopied; /* ... that fell back to a copy   */
 };
 
+int TCPModeByName(const char *name);
+
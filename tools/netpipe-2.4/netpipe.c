@@ -19,9 +19,129 @@
 /*     * PVM.h              ---- Include file for PVM calls and data structs */
 /*****************************************************************************/
 #include "netpipe.h"
+#ifdef TCP
+#include <sched.h>
+#include <sys/wait.h>
+#endif
 
 extern char *optarg;
 
+#ifdef TCP
+/*
+   Sums up the results of the streams line by line into out. Each line is
+   for the same block size in all the streams, the aggregate bandwidth is
+   the sum and the time the longest of the streams.
+ */
+static int SumStreams(char *out, int nstreams, int printopt)
+{
+	double t, bps, tmax, bpssum, var;
+	int i, bits, bytes, lines = 0;
+	char name[FILENAME_MAX], line[256];
+	FILE **in, *sum;
+
+	in = calloc(nstreams, sizeof(*in));
+	if (in == NULL)
+		return 1;
+
+	for (i = 0; i < nstreams; i++) {
+		snprintf(name, sizeof(name), "%s.%d", out, i);
+		if ((in[i] = fopen(name, "r")) == NULL) {
+			fprintf(stderr, "Can't open %s for input\n", name);
+			goto out;
+		}
+	}
+
+	if ((sum = fopen(out, "w")) == NULL) {
+		fprintf(stderr, "Can't open %s for output\n", out);
+		goto out;
+	}
+
+	for (;;) {
+		tmax = bpssum = 0;
+		for (i = 0; i < nstreams; i++) {
+			if (fgets(line, sizeof(line), in[i]) == NULL ||
+			    sscanf(line, "%lf %lf %d %d %lf", &t, &bps, &bits,
+				   &bytes, &var) != 5)
+				break;
+			tmax = MAX(tmax, t);
+			bpssum += bps;
+		}
+		if (i < nstreams)
+			break;
+
+		fprintf(sum, "%.7f %.7f %d %d %.7f\n", tmax, bpssum, bits,
+			bytes, 0.0);
+		if (printopt)
+			fprintf(stderr, "%3d: %7d bytes %d streams %6.2f Mbps "
+				"aggregate\n", lines, bytes, nstreams, bpssum);
+		lines++;
+	}
+
+	fclose(sum);
+	fprintf(stderr, "NetPIPE: aggregate of %d streams written to %s\n",
+		nstreams, out);
+
+out:
+	for (i = 0; i < nstreams && in[i]; i++)
+		fclose(in[i]);
+	free(in);
+
+	return lines ? 0 : 1;
+}
+
+/*
+   Forks one process per stream. Each of them runs the whole benchmark on
+   its own connection, the parent waits for them, sums up their results on
+   the transmitter and exits. Returns the stream index in the child
+   processes.
+ */
+static int StartStreams(int nstreams, int trans, char *out, int printopt)
+{
+	int i, status, ret = 0;
+	pid_t pid;
+
+	if (nstreams <= 1)
+		return 0;
+
+	for (i = 0; i < nstreams; i++) {
+		pid = fork();
+		if (pid < 0) {
+			perror("NetPIPE: fork");
+			exit(-13);
+		}
+		if (pid == 0)
+			return i;
+	}
+
+	while (wait(&status) > 0) {
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			ret = 1;
+	}
+
+	if (trans && !ret)
+		ret = SumStreams(out, nstreams, printopt);
+
+	exit(ret);
+}
+
+static void PinToCpu(int cpu)
+{
+	cpu_set_t set;
+	long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+
+	if (cpu < 0)
+		return;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu % ncpus, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		fprintf(stderr, "NetPIPE: can't pin to cpu %ld: %s\n",
+			cpu % ncpus, strerror(errno));
+		exit(-14);
+	}
+}
+#endif
+
 int main(int argc, char *argv[])
 {
 	FILE *out;		/* Output data file                          */
@@ -46,6 +166,11 @@ int main(int argc, char *argv[])
 	    end = MAXINT,	/* Ending value for signature curve          */
 	    streamopt = 0,	/* Streaming mode flag                       */
 	    printopt = 0;	/* Debug print statements flag               */
+#ifdef TCP
+	int nstreams = 1,	/* Number of parallel connections            */
+	 stream,		/* Index of this connection                  */
+	 pincpu = -1;		/* CPU for stream 0, -1 = no pinning         */
+#endif
 
 	ArgStruct args;		/* Argumentsfor all the calls                */
 
@@ -68,6 +193,7 @@ int main(int argc, char *argv[])
 	MPI_Init(&argc, &argv);
 #endif
 
+	memset(&args, 0, sizeof(args));
 	strcpy(s, "NetPIPE.out");
 #ifndef MPI
 	if (argc < 2)
@@ -75,7 +201,7 @@ int main(int argc, char *argv[])
 #endif
 
 	/* Parse the arguments. See Usage for description */
-	while ((c = getopt(argc, argv, "Pstrh:p:o:A:O:l:u:i:b:a")) != -1) {
+	while ((c = getopt(argc, argv, "Pstrh:p:o:A:O:l:u:i:b:am:B:n:c:")) != -1) {
 		switch (c) {
 		case 'o':
 			strcpy(s, optarg);
@@ -149,6 +275,32 @@ int main(int argc, char *argv[])
 			asyncReceive = 1;
 			break;
 
+#ifdef TCP
+		case 'm':
+			args.prot.mode = TCPModeByName(optarg);
+			if (args.prot.mode < 0) {
+				fprintf(stderr, "Unknown mode '%s'\n", optarg);
+				exit(-11);
+			}
+			break;
+
+		case 'B':
+			args.prot.busypoll = atoi(optarg);
+			break;
+
+		case 'n':
+			nstreams = atoi(optarg);
+			if (nstreams < 1) {
+				fprintf(stderr, "Need at least one stream\n");
+				exit(-11);
+			}
+			break;
+
+		case 'c':
+			pincpu = atoi(optarg);
+			break;
+#endif
+
 		default:
 			PrintUsage();
 			exit(-12);
@@ -180,6 +332,17 @@ int main(int argc, char *argv[])
 	} else
 		fprintf(stderr, "Send and Recv Buffers are %d bytes\n",
 			args.prot.sndbufsz);
+
+	/*
+	   Stream i talks over port + i, pinned to CPU pincpu + i, and writes
+	   its results into <output>.i in the usual format. Their sum goes
+	   into <output>.
+	 */
+	stream = StartStreams(nstreams, trans, s, printopt);
+	args.port = port + stream;
+	if (nstreams > 1)
+		sprintf(s + strlen(s), ".%d", stream);
+	PinToCpu(pincpu < 0 ? -1 : pincpu + stream);
 #endif
 
 	Setup(&args);
@@ -502,11 +665,17 @@ void PrintUsage(void)
 	printf("A: specify buffers alignment e.g.: <-A 1024>\n");
 	printf("a: asynchronous receive (a.k.a. preposted receive)\n");
 #if defined(TCP)
+	printf("B: SO_BUSY_POLL time in usecs e.g. <-B 50>\n");
 	printf("b: specify send and receive buffer sizes e.g. <-b 32768>\n");
+	printf("c: pin stream N to cpu <c> + N e.g. <-c 0>\n");
 	printf("h: specify hostname <-h host>\n");
 #endif
 	printf("i: specify increment step size e.g. <-i 64>\n");
 	printf("l: lower bound start value e.g. <-i 1>\n");
+#if defined(TCP)
+	printf("m: data path write|sendfile|splice|zerocopy e.g. <-m splice>\n");
+	printf("n: number of parallel streams on ports port..port+n-1 <-n 4>\n");
+#endif
 	printf("O: specify buffer offset e.g. <-O 127>\n");
 	printf("o: specify output filename <-o fn>\n");
 	printf("P: print on screen\n");
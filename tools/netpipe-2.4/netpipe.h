@@ -11,6 +11,10 @@
 /*     * netpipe.h          ---- General include file                        */
 /*****************************************************************************/
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE         /* splice(2), sched_setaffinity(2) */
+#endif
+
 #include <ctype.h>
 #include <errno.h>
 #include <signal.h>
@@ -26,6 +26,7 @@
 #include <sys/dir.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/resource.h>
 
 #ifdef FLASK_LINUX
 #include <fs_secure.h>
@@ -496,6 +497,271 @@ next_proc:			/* get next PID for consideration */
 
 #undef flags
 
+/* Snapshot sampling.  Unlike readproc, which opens, reads and closes
+ * several files for every task on every call, readsnap keeps the stat and
+ * statm fds of each task open in a SNAPTAB and preads stat only.  When the
+ * stat text is byte for byte the same as in the last frame (which is the
+ * case for every task that did not run or fault) the cached proc_t is
+ * handed out again without any parsing or further reads.
+ */
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+#define SNAP_FILL (PROC_FILLSTAT | PROC_FILLMEM | PROC_FILLSTATUS | \
+		   PROC_FILLUSR | PROC_FILLGRP)
+
+static unsigned snap_slot(const SNAPTAB * ST, pid_t pid)
+{
+	return ((unsigned)pid * 2654435761u) & (ST->size - 1);
+}
+
+static void snap_insert(SNAPTAB * ST, snapent_t * e)
+{
+	unsigned i = snap_slot(ST, e->pid);
+
+	while (ST->hash[i])
+		i = (i + 1) & (ST->size - 1);
+	ST->hash[i] = e;
+}
+
+/* (re)build the hash with `size' slots from the entries left in it */
+static void snap_rehash(SNAPTAB * ST, unsigned size)
+{
+	snapent_t **old = ST->hash;
+	unsigned osize = ST->size;
+	unsigned i;
+
+	ST->hash = xcalloc(NULL, size * sizeof *ST->hash);
+	ST->size = size;
+	for (i = 0; i < osize; i++)
+		if (old[i])
+			snap_insert(ST, old[i]);
+	free(old);
+}
+
+snapent_t *snap_lookup(SNAPTAB * ST, pid_t pid)
+{
+	unsigned i = snap_slot(ST, pid);
+
+	while (ST->hash[i]) {
+		if (ST->hash[i]->pid == pid)
+			return ST->hash[i];
+		i = (i + 1) & (ST->size - 1);
+	}
+	return NULL;
+}
+
+SNAPTAB *opensnap(void)
+{
+	SNAPTAB *ST = xcalloc(NULL, sizeof *ST);
+	struct rlimit rl;
+
+	/* two fds per task add up quickly, take all we are allowed to */
+	if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+	ST->size = 1024;
+	ST->hash = xcalloc(NULL, ST->size * sizeof *ST->hash);
+	return ST;
+}
+
+void beginsnap(SNAPTAB * ST, int flags)
+{
+	ST->flags = flags;
+	ST->gen++;
+	ST->procfs = opendir("/proc");
+}
+
+/* pread a /proc/#/ file through its cached fd, opening it first if needed.
+ * A failing cached fd belongs to a task that is gone, possibly with the pid
+ * reused already, so it is reopened once.  Should we run out of fds the
+ * file is read the old way and not cached. */
+static int snap_read(int *fd, const char *directory, const char *what,
+		     char *ret, int cap)
+{
+	char filename[48];
+	int num_read;
+
+	if (likely(*fd >= 0)) {
+		num_read = pread(*fd, ret, cap - 1, 0);
+		if (likely(num_read > 0))
+			goto out;
+		close(*fd);
+		*fd = -1;
+	}
+
+	snprintf(filename, sizeof filename, "%s/%s", directory, what);
+	*fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (unlikely(*fd == -1)) {
+		if (errno == EMFILE || errno == ENFILE)
+			return file2str(directory, what, ret, cap);
+		return -1;
+	}
+	num_read = pread(*fd, ret, cap - 1, 0);
+	if (unlikely(num_read <= 0))
+		return -1;
+out:
+	ret[num_read] = 0;
+	return num_read;
+}
+
+proc_t *readsnap(SNAPTAB * ST, proc_t * p)
+{
+	static struct direct *ent;	/* dirent handle */
+	static struct stat sb;	/* stat buffer */
+	static char path[32], sbuf[1024];	/* bufs for stat,statm */
+	unsigned long long start_time;
+	snapent_t *e;
+	pid_t pid;
+	int num;
+
+#define flags (ST->flags)
+
+next_proc:
+	if (unlikely(!ST->procfs))
+		return NULL;
+	for (;;) {
+		ent = readdir(ST->procfs);
+		if (unlikely(!ent))
+			return NULL;
+		if (likely(*ent->d_name > '0') && likely(*ent->d_name <= '9'))
+			break;
+	}
+	pid = strtoul(ent->d_name, NULL, 10);
+	memcpy(path, "/proc/", 6);
+	strcpy(path + 6, ent->d_name);
+
+	if (unlikely(!(e = snap_lookup(ST, pid)))) {
+		if (ST->used * 2 >= ST->size)
+			snap_rehash(ST, ST->size * 2);
+		e = xcalloc(NULL, sizeof *e);
+		e->pid = pid;
+		e->fd_stat = e->fd_statm = -1;
+		snap_insert(ST, e);
+		ST->used++;
+	}
+
+	num = snap_read(&e->fd_stat, path, "stat", sbuf, sizeof sbuf);
+	if (unlikely(num == -1))
+		goto next_proc;	/* gone, endsnap will drop it */
+
+	e->gen = ST->gen;
+	e->prev_tics = e->p.utime + e->p.stime;
+	e->prev_min_flt = e->p.min_flt;
+	e->prev_maj_flt = e->p.maj_flt;
+
+	if (num == e->slen && !memcmp(sbuf, e->sbuf, num)
+	    && !(flags & ~e->fill & SNAP_FILL))
+		goto copy;	/* nothing happened since the last frame */
+
+	if (num >= e->ssize) {
+		e->ssize = (num | 63) + 1;
+		e->sbuf = xrealloc(e->sbuf, e->ssize);
+	}
+	memcpy(e->sbuf, sbuf, num);
+	e->slen = num;
+
+	start_time = e->p.start_time;
+	stat2proc(sbuf, &e->p);
+	e->p.pid = pid;
+	if (e->p.start_time != start_time) {	/* new task, or pid reused */
+		e->prev_tics = 0;
+		e->prev_min_flt = e->prev_maj_flt = 0;
+	}
+
+	if (e->fd_stat != -1 ? !fstat(e->fd_stat, &sb) : !stat(path, &sb))
+		e->p.euid = sb.st_uid;
+
+	if (unlikely(flags & PROC_FILLMEM)) {	/* read, parse /proc/#/statm */
+		if (likely(snap_read(&e->fd_statm, path, "statm", sbuf,
+				     sizeof sbuf) != -1))
+			statm2proc(sbuf, &e->p);	/* ignore statm errors here */
+	}
+	if (flags & PROC_FILLSTATUS) {	/* read, parse /proc/#/status */
+		if (likely(file2str(path, "status", sbuf, sizeof sbuf) != -1))
+			status2proc(sbuf, &e->p);
+	}
+
+	if (flags & PROC_FILLUSR) {
+		strncpy(e->p.euser, user_from_uid(e->p.euid),
+			sizeof e->p.euser);
+		if (flags & PROC_FILLSTATUS) {
+			strncpy(e->p.ruser, user_from_uid(e->p.ruid),
+				sizeof e->p.ruser);
+			strncpy(e->p.suser, user_from_uid(e->p.suid),
+				sizeof e->p.suser);
+			strncpy(e->p.fuser, user_from_uid(e->p.fuid),
+				sizeof e->p.fuser);
+		}
+	}
+
+	if (flags & PROC_FILLGRP) {
+		strncpy(e->p.egroup, group_from_gid(e->p.egid),
+			sizeof e->p.egroup);
+		if (flags & PROC_FILLSTATUS) {
+			strncpy(e->p.rgroup, group_from_gid(e->p.rgid),
+				sizeof e->p.rgroup);
+			strncpy(e->p.sgroup, group_from_gid(e->p.sgid),
+				sizeof e->p.sgroup);
+			strncpy(e->p.fgroup, group_from_gid(e->p.fgid),
+				sizeof e->p.fgroup);
+		}
+	}
+
+	e->fill = flags;
+
+copy:
+	if (!p)
+		p = xcalloc(p, sizeof *p);
+	memcpy(p, &e->p, sizeof *p);
+	p->pcpu = p->utime + p->stime - e->prev_tics;
+
+	if ((flags & PROC_FILLCOM) || (flags & PROC_FILLARG))	/* read+parse /proc/#/cmdline */
+		p->cmdline = file2strvec(path, "cmdline");
+
+	if (unlikely(flags & PROC_FILLENV))	/* read+parse /proc/#/environ */
+		p->environ = file2strvec(path, "environ");
+
+	return p;
+}
+
+#undef flags
+
+/* drop the tasks not seen in this frame, closing their fds */
+void endsnap(SNAPTAB * ST)
+{
+	unsigned dropped = 0;
+	unsigned i;
+
+	if (ST->procfs) {
+		closedir(ST->procfs);
+		ST->procfs = NULL;
+	}
+
+	for (i = 0; i < ST->size; i++) {
+		snapent_t *e = ST->hash[i];
+
+		if (!e || e->gen == ST->gen)
+			continue;
+		if (e->fd_stat != -1)
+			close(e->fd_stat);
+		if (e->fd_statm != -1)
+			close(e->fd_statm);
+		free(e->sbuf);
+		free(e);
+		ST->hash[i] = NULL;
+		dropped++;
+	}
+
+	/* linear probing can't live with holes, so rebuild */
+	if (dropped) {
+		ST->used -= dropped;
+		snap_rehash(ST, ST->size);
+	}
+}
+
 /* ps_readproc: return a pointer to a proc_t filled with requested info about the
  * next process available matching the restriction set.  If no more such
  * processes are available, return a null pointer (boolean false).  Use the
@@ -178,6 +178,46 @@ extern void closeproc(PROCTAB* PT);
 extern proc_t* readproc(PROCTAB* PT, proc_t* return_buf);
 extern proc_t* ps_readproc(PROCTAB* PT, proc_t* return_buf);
 
+/* SNAPTAB: sampling state kept from one frame to the next.  Every task
+ * seen gets a snapent_t in a pid keyed hash table which holds its
+ * /proc/#/stat and statm fds open and the stat text of the last change.
+ * Each frame costs one pread() of stat per task; statm, status and the
+ * parsing are only redone for tasks whose stat text changed.
+ */
+typedef struct snapent_t {
+    pid_t	pid;
+    unsigned	gen;		/* frame in which the task was last seen */
+    int		fill;		/* PROC_FILL* flags p was filled with */
+    int		fd_stat;	/* -1 if not open (new task or out of fds) */
+    int		fd_statm;
+    int		slen;		/* length of the text in sbuf */
+    int		ssize;		/* allocated size of sbuf */
+    char*	sbuf;		/* /proc/#/stat text as of the last change */
+    unsigned long long prev_tics;	/* utime + stime in the previous frame */
+    unsigned long prev_min_flt;		/* min_flt in the previous frame */
+    unsigned long prev_maj_flt;		/* maj_flt in the previous frame */
+    proc_t	p;		/* fields parsed at the last change */
+} snapent_t;
+
+typedef struct SNAPTAB {
+    DIR*	procfs;
+    int		flags;
+    unsigned	gen;		/* current frame */
+    unsigned	size;		/* hash slots, a power of 2 */
+    unsigned	used;
+    snapent_t**	hash;
+} SNAPTAB;
+
+/* allocate a SNAPTAB, beginsnap/readsnap/endsnap then sample one frame the
+ * way openproc/readproc/closeproc do.  readsnap sets pcpu to the tics used
+ * since the previous frame.  snap_lookup finds a task of the last frame.
+ */
+extern SNAPTAB* opensnap(void);
+extern void beginsnap(SNAPTAB* ST, int flags);
+extern proc_t* readsnap(SNAPTAB* ST, proc_t* return_buf);
+extern void endsnap(SNAPTAB* ST);
+extern snapent_t* snap_lookup(SNAPTAB* ST, pid_t pid);
+
 // warning: interface may change
 extern int read_cmdline(char *restrict const dst, unsigned sz, unsigned pid);
 
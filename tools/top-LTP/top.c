@@ -59,6 +59,14 @@
 static FILE *outfile;
 static FILE *datafile;
 static int o_flag;
+	/* Persistent /proc sampling state, unless monitoring -p pids */
+static SNAPTAB *Snaptab;
+	/* Per-test timelines: output directory, pan active files, tests */
+static const char *Tl_dir;
+static const char *Tl_zoos[TLZOOMAX];
+static int Tl_zoonum;
+static TL_t *Tl_tests;
+static int Tl_num;
 	/* The original and new terminal attributes */
 static struct termios Savedtty, Rawtty;
 static int Ttychanged = 0;
@@ -232,6 +240,12 @@ static int sort_HST_t(const HST_t * P, const HST_t * Q)
 	return P->pid - Q->pid;
 }
 
+    /* ///////////////////////////////// and one for timeline_find() ! */
+static int sort_TL_t(const TL_t * P, const TL_t * Q)
+{
+	return P->pgid - Q->pgid;
+}
+
 /*######  Tiny useful routine(s)  ########################################*/
 
 	/*
@@ -936,6 +950,10 @@ static void prochlp(proc_t * this)
 		Frame_maxtask = Frame_running = Frame_sleepin = Frame_stopped =
 		    Frame_zombied = 0;
 
+		// the snapshot engine keeps its own history
+		if (Snaptab)
+			return;
+
 		// reuse memory each time around
 		hist_tmp = hist_sav;
 		hist_sav = hist_new;
@@ -961,6 +979,12 @@ static void prochlp(proc_t * this)
 		break;
 	}
 
+	if (Snaptab) {
+		// readsnap already set pcpu to the tics since the last frame
+		Frame_maxtask++;
+		return;
+	}
+
 	if (unlikely(Frame_maxtask + 1 >= hist_siz)) {
 		hist_siz = hist_siz * 5 / 4 + 100;	// grow by at least 25%
 		hist_sav = alloc_r(hist_sav, sizeof(HST_t) * hist_siz);
@@ -1010,6 +1034,16 @@ static void prochlp(proc_t * this)
 	Frame_maxtask++;
 }
 
+	/*
+	 * Read the next task from either the snapshot engine or, when
+	 * monitoring specific pids, the PROCTAB. */
+static proc_t *procs_read(PROCTAB * PT, proc_t * p)
+{
+	if (Snaptab)
+		return readsnap(Snaptab, p);
+	return readproc(PT, p);
+}
+
 	/*
 	 * This guy's modeled on libproc's 'readproctab' function except
 	 * we reuse and extend any prior proc_t's.  He's been customized
@@ -1021,13 +1055,15 @@ static proc_t **procs_refresh(proc_t ** table, int flags)
 	static unsigned savmax = 0;	// first time, Bypass: (i)
 	proc_t *ptsk = (proc_t *) - 1;	// first time, Force: (ii)
 	unsigned curmax = 0;	// every time  (jeeze)
-	PROCTAB *PT;
+	PROCTAB *PT = NULL;
 
+	if (!Monpidsidx && !Snaptab)
+		Snaptab = opensnap();
 	prochlp(NULL);		// prep for a new frame
 	if (Monpidsidx)
 		PT = openproc(PROC_FILLBUG | PROC_PID, Monpids);
 	else
-		PT = openproc(flags);
+		beginsnap(Snaptab, flags);
 
 	// i) Allocated Chunks:  *Existing* table;  refresh + reuse
 	while (curmax < savmax) {
@@ -1035,7 +1071,7 @@ static proc_t **procs_refresh(proc_t ** table, int flags)
 			free(*table[curmax]->cmdline);
 			table[curmax]->cmdline = NULL;
 		}
-		if (unlikely(!(ptsk = readproc(PT, table[curmax]))))
+		if (unlikely(!(ptsk = procs_read(PT, table[curmax]))))
 			break;
 		prochlp(ptsk);	// tally & complete this proc_t
 		++curmax;
@@ -1046,12 +1082,15 @@ static proc_t **procs_refresh(proc_t ** table, int flags)
 		// realloc as we go, keeping 'table' ahead of 'currmax++'
 		table = alloc_r(table, (curmax + 1) * PTRsz);
 		// here, readproc will allocate the underlying proc_t stg
-		if (likely(ptsk = readproc(PT, NULL))) {
+		if (likely(ptsk = procs_read(PT, NULL))) {
 			prochlp(ptsk);	// tally & complete this proc_t
 			table[curmax++] = ptsk;
 		}
 	}
-	closeproc(PT);
+	if (Snaptab)
+		endsnap(Snaptab);
+	else
+		closeproc(PT);
 
 	// iii) Chunkless:  make 'eot' entry, after ensuring proc_t exists
 	if (curmax >= savmax) {
@@ -1068,6 +1107,151 @@ static proc_t **procs_refresh(proc_t ** table, int flags)
 #undef ENTsz
 }
 
+/*######  Per-test resource timelines  ##################################*/
+
+	/*
+	 * pan runs every test as a process group of its own and lists each
+	 * one as "pgid,tag,cmdline" in its active file.  With -L every task
+	 * of a frame is charged to the test it belongs to and one line per
+	 * test is appended to <dir>/<tag>.timeline, all straight from the
+	 * snapshot engine's table.  The active files are small, so they're
+	 * simply reread each frame. */
+static void timeline_zoo(void)
+{
+	char buf[BUFSIZ];
+	TL_t *old = Tl_tests;
+	int onum = Tl_num;
+	int i, j;
+	FILE *fp;
+
+	Tl_tests = NULL;
+	Tl_num = 0;
+	for (i = 0; i < Tl_zoonum; i++) {
+		if (!(fp = fopen(Tl_zoos[i], "r")))
+			continue;
+		while (fgets(buf, sizeof buf, fp)) {
+			char *tag, *end;
+			TL_t *t;
+			long pgid;
+
+			// '#' marks an entry pan has cleared
+			if (buf[0] == '#')
+				continue;
+			pgid = strtol(buf, &tag, 10);
+			if (pgid <= 0 || *tag != ',')
+				continue;
+			tag++;
+			if ((end = strchr(tag, ',')))
+				*end = '\0';
+			else
+				tag[strcspn(tag, " \n")] = '\0';
+
+			Tl_tests = alloc_r(Tl_tests, (Tl_num + 1) * sizeof(TL_t));
+			t = &Tl_tests[Tl_num++];
+			memset(t, 0, sizeof(TL_t));
+			t->pgid = pgid;
+			snprintf(t->tag, sizeof(t->tag), "%s", tag);
+
+			// a test still running keeps its open timeline
+			for (j = 0; j < onum; j++) {
+				if (old[j].fp && old[j].pgid == t->pgid
+				    && !strcmp(old[j].tag, t->tag)) {
+					t->fp = old[j].fp;
+					old[j].fp = NULL;
+					break;
+				}
+			}
+		}
+		fclose(fp);
+	}
+
+	for (j = 0; j < onum; j++)
+		if (old[j].fp)
+			fclose(old[j].fp);
+	free(old);
+
+	qsort(Tl_tests, Tl_num, sizeof(TL_t), (QFP_t) sort_TL_t);
+}
+
+	/*
+	 * Find the test a task belongs to by its process group, or by that
+	 * of its ancestors for tests which start groups of their own. */
+static TL_t *timeline_find(const snapent_t * e)
+{
+	TL_t key, *t;
+	int depth;
+
+	for (depth = 0; e && depth < 16; depth++) {
+		key.pgid = e->p.pgrp;
+		t = bsearch(&key, Tl_tests, Tl_num, sizeof(TL_t),
+			    (QFP_t) sort_TL_t);
+		if (t)
+			return t;
+		if (e->p.ppid <= 1)
+			break;
+		e = snap_lookup(Snaptab, e->p.ppid);
+	}
+	return NULL;
+}
+
+static FILE *timeline_open(const TL_t * t)
+{
+	char path[OURPATHSZ], *p;
+	FILE *fp;
+
+	p = path + snprintf(path, sizeof(path), "%s/", Tl_dir);
+	snprintf(p, sizeof(path) - (p - path), "%s.timeline", t->tag);
+	for (; *p; p++)
+		if (*p == '/')
+			*p = '_';
+
+	if (!(fp = fopen(path, "a")))
+		return NULL;
+	if (!ftell(fp))
+		fprintf(fp, "# time tasks tics(%ldHz) rss(kb) min_flt maj_flt\n",
+			sysconf(_SC_CLK_TCK));
+	fprintf(fp, "# %s pgid %d\n", t->tag, t->pgid);
+	return fp;
+}
+
+static void timeline_write(void)
+{
+	struct timeval tv;
+	unsigned i;
+	int j;
+
+	timeline_zoo();
+	if (!Tl_num)
+		return;
+
+	// endsnap has dropped everything not seen in this frame
+	for (i = 0; i < Snaptab->size; i++) {
+		const snapent_t *e = Snaptab->hash[i];
+		TL_t *t;
+
+		if (!e || !(t = timeline_find(e)))
+			continue;
+		t->tasks++;
+		t->tics += e->p.utime + e->p.stime - e->prev_tics;
+		t->rss += e->p.rss;
+		t->min_flt += e->p.min_flt - e->prev_min_flt;
+		t->maj_flt += e->p.maj_flt - e->prev_maj_flt;
+	}
+
+	gettimeofday(&tv, NULL);
+	for (j = 0; j < Tl_num; j++) {
+		TL_t *t = &Tl_tests[j];
+
+		if (!t->fp && !(t->fp = timeline_open(t)))
+			continue;
+		fprintf(t->fp, "%ld.%03ld %u %llu %lu %lu %lu\n",
+			(long)tv.tv_sec, (long)tv.tv_usec / 1000, t->tasks,
+			t->tics, t->rss * (Page_size / 1024), t->min_flt,
+			t->maj_flt);
+		fflush(t->fp);
+	}
+}
+
 /*######  Field Table/RCfile compatability support  ######################*/
 
 	/* These are the Fieldstab.lflg values used here and in reframewins.
@@ -1822,6 +2006,8 @@ static void parse_args(char **args)
 	/* differences between us and the former top:
 	   -o filename to output data to at each measurement interval
 	   -f filename to read output data from to calculate averages
+	   -L dir to write per-test resource timelines to (the pan log dir)
+	   -a active-file of the pan run(s) those tests belong to, or $ZOO
 	   -C (separate CPU states for SMP) is left to an rcfile
 	   -p (pid monitoring) allows a comma delimited list
 	   -q (zero delay) eliminated as redundant, incomplete and inappropriate
@@ -1831,7 +2017,7 @@ static void parse_args(char **args)
 	   .  bunched args are actually handled properly and none are ignored
 	   .  we tolerate NO whitespace and NO switches -- maybe too tolerant? */
 	static const char usage[] =
-	    " -hv | -bcisS -d delay -n iterations [-u user | -U user] -o filename -p pid [,pid ...] | -f filename";
+	    " -hv | -bcisS -d delay -n iterations [-u user | -U user] -o filename -p pid [,pid ...] | -f filename | -L dir -a active-file";
 	float tmp_delay = MAXFLOAT;
 	char *p;
 	char buff[BUFF_SIZE];
@@ -1862,6 +2048,19 @@ static void parse_args(char **args)
 			case '\0':
 			case '-':
 				break;
+			case 'a':
+				if (cp[1])
+					cp++;
+				else if (*args)
+					cp = *args++;
+				else
+					std_err("-a requires argument");
+				if (Tl_zoonum >= TLZOOMAX)
+					std_err(fmtmk("active file limit (%d) exceeded",
+						      TLZOOMAX));
+				Tl_zoos[Tl_zoonum++] = cp;
+				cp = cp + strlen(cp);
+				break;
 			case 'b':
 				Batch = 1;
 				break;
@@ -1993,6 +2192,16 @@ static void parse_args(char **args)
 				TOGw(Curwin, Show_IDLEPS);
 				Curwin->rc.maxtasks = 0;
 				break;
+			case 'L':
+				if (cp[1])
+					cp++;
+				else if (*args)
+					cp = *args++;
+				else
+					std_err("-L requires argument");
+				Tl_dir = cp;
+				cp = cp + strlen(cp);
+				break;
 			case 'n':
 				if (cp[1])
 					cp++;
@@ -2108,6 +2317,15 @@ static void parse_args(char **args)
 		}		/* end: while (*cp) */
 	}			/* end: while (*args) */
 
+	if (Tl_dir) {
+		if (Monpidsidx)
+			std_err("-L can't be combined with -p");
+		if (!Tl_zoonum && getenv("ZOO"))
+			Tl_zoos[Tl_zoonum++] = getenv("ZOO");
+		if (!Tl_zoonum)
+			std_err("-L requires -a active-file or $ZOO");
+	}
+
 	/* fixup delay time, maybe... */
 	if (MAXFLOAT != tmp_delay) {
 		if (Secure_mode || 0 > tmp_delay)
@@ -3165,6 +3383,8 @@ static proc_t **summary_show(void)
 	} else
 		putp(Batch ? "\n\n" : Cap_home);
 	p_table = procs_refresh(p_table, Frames_libflags);
+	if (Tl_dir)
+		timeline_write();
 
 	/*
 	 ** Display Uptime and Loadavg */
@@ -56,6 +56,9 @@
         /* Specific process id monitoring support (command line only) */
 #define MONPIDMAX  20
 
+        /* Per-test timelines (-L), the most pan active files (-a) */
+#define TLZOOMAX    8
+
         /* Miscellaneous buffer sizes with liberal values
            -- mostly just to pinpoint source code usage/dependancies */
 #define SCREENMAX   512
@@ -197,6 +200,17 @@ typedef struct CPU_t {
    TIC_t u_sav, s_sav, n_sav, i_sav, w_sav;     // in the order of our display
 } CPU_t;
 
+        /* This structure holds one running pan test (an active file
+           entry) and what its tasks used in the current frame. */
+typedef struct TL_t {
+   pid_t              pgid;             // pan runs each test as its own pgrp
+   char               tag[64];          // the test's tag from the active file
+   FILE              *fp;               // its <dir>/<tag>.timeline, or NULL
+   unsigned           tasks;
+   unsigned long long tics;
+   unsigned long      rss, min_flt, maj_flt;
+} TL_t;
+
         /* These 2 types support rcfile compatibility */
 typedef struct RCW_t {  // the 'window' portion of an rcfile
    FLG_t  sortindx;             // sort field, represented as a procflag
@@ -582,7 +596,14 @@ typedef struct WIN_t {
 //atic void        *alloc_r (void *q, unsigned numb) MALLOC;
 //atic CPU_t       *cpus_refresh (CPU_t *cpus);
 //atic void         prochlp (proc_t *this);
+//atic proc_t     *procs_read (PROCTAB *PT, proc_t *p);
 //atic proc_t     **procs_refresh (proc_t **table, int flags);
+/*------  Per-test resource timelines  -----------------------------------*/
+//atic int          sort_TL_t (const TL_t *P, const TL_t *Q);
+//atic void         timeline_zoo (void);
+//atic TL_t        *timeline_find (const snapent_t *e);
+//atic FILE        *timeline_open (const TL_t *t);
+//atic void         timeline_write (void);
 /*------  Field Table/RCfile compatability support  ----------------------*/
 /*atic FLD_t        Fieldstab[] = { ... }                                 */
 //atic int          ft_cvt_char (const int fr, const int to, int c);